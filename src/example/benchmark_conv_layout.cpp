@@ -0,0 +1,94 @@
+//
+// Created by Erik Hyrkas on 1/19/2023.
+// Copyright 2023. Usable under MIT license.
+//
+#include <fstream>
+#include <memory>
+#include "../ml/model.hpp"
+
+using namespace std;
+using namespace happyml;
+using namespace happymldsl;
+
+// Trains and predicts with the mnist convolution example, once with each convolution layout, so we can see what
+// laying the input out channel-last buys us. The example itself only has one channel going in and one filter,
+// which gives a channel-last layout nothing to sum, so this adds a second convolution that reads the 8 channels
+// the first one makes.
+//
+// It uses the first records of ..\data\mnist_test.csv (see README.md) when it's there, and random images when it
+// isn't. The speed of a layout doesn't depend on what the pixels are.
+const size_t benchmarkRecords = 500;
+const size_t benchmarkEpochs = 2;
+
+shared_ptr<InMemoryTrainingDataSet> loadBenchmarkRecords() {
+    const string path = "..\\data\\mnist_test.csv";
+    auto records = make_shared<InMemoryTrainingDataSet>();
+    if (ifstream(path).good()) {
+        map<string, size_t> categories;
+        for (size_t digit = 0; digit < 10; digit++) {
+            categories[asString(digit)] = digit;
+        }
+        cout << "Loading mnist test data..." << endl;
+        auto mnistDataSource = make_shared<InMemoryDelimitedValuesTrainingDataSet>(path, ',',
+                                                                                   true, false, true,
+                                                                                   1, 28 * 28,
+                                                                                   vector<size_t>{1, 10, 1},
+                                                                                   vector<size_t>{28, 28, 1},
+                                                                                   make_shared<TextToCategoryEncoder>(
+                                                                                           categories),
+                                                                                   make_shared<TextToPixelEncoder>());
+        auto nextRecord = mnistDataSource->nextRecord();
+        while (nextRecord && records->recordCount() < benchmarkRecords) {
+            records->addTrainingData(nextRecord->getFirstGiven(), nextRecord->getFirstExpected());
+            nextRecord = mnistDataSource->nextRecord();
+        }
+        return records;
+    }
+    cout << "Couldn't find " << path << ", so we'll use random images." << endl;
+    for (size_t record = 0; record < benchmarkRecords; record++) {
+        vector<vector<vector<float>>> expected{{vector<float>(10, 0.f)}};
+        expected[0][0][record % 10] = 1.f;
+        records->addTrainingData(
+                make_shared<FullTensor>(make_shared<TensorFromRandom>(28, 28, 1, 0.f, 1.f, (uint32_t) record + 1)),
+                tensor(expected));
+    }
+    return records;
+}
+
+void benchmarkLayout(const shared_ptr<InMemoryTrainingDataSet> &records, ConvolutionLayout layout) {
+    auto neuralNetwork = neuralNetworkBuilder()
+            ->setModelName("mnist_conv2d_layout_benchmark")
+            ->setModelRepo("../repo/")
+            ->addInput(records->getGivenShape(), 8, 3, convolution2dValid,
+                       ActivationType::relu)->setUseBias(false)->setConvolutionLayout(layout)
+            ->addNode(8, 3, convolution2dValid, ActivationType::relu)->setUseBias(false)->setConvolutionLayout(layout)
+            ->addNode(100, full, ActivationType::relu)->setUseBias(false)
+            ->addOutput(records->getExpectedShape(), sigmoidApprox)
+            ->build();
+    // the same amount of work for both layouts, however the loss goes.
+    neuralNetwork->setExitStrategy(make_shared<DefaultExitStrategy>(benchmarkEpochs, NINETY_DAYS_MS,
+                                                                    benchmarkEpochs, 0.f, 0.f, benchmarkEpochs));
+    ElapsedTimer timer;
+    const float loss = neuralNetwork->train(records, 4, best, false);
+    const int64_t trainingMilliseconds = timer.getMilliseconds();
+    records->restart();
+    auto nextRecord = records->nextRecord();
+    while (nextRecord) {
+        neuralNetwork->predictOne(nextRecord->getFirstGiven());
+        nextRecord = records->nextRecord();
+    }
+    const int64_t predictingMilliseconds = timer.getMilliseconds();
+    cout << fixed << setprecision(4) << convolutionLayoutToString(layout) << ": trained " << benchmarkEpochs
+         << " epochs of " << records->recordCount() << " records in " << trainingMilliseconds
+         << " ms (loss " << loss << "), predicted them in " << predictingMilliseconds << " ms" << endl;
+}
+
+int main() {
+    try {
+        const auto records = loadBenchmarkRecords();
+        benchmarkLayout(records, channelsFirstLayout);
+        benchmarkLayout(records, channelsLastLayout);
+    } catch (const exception &e) {
+        cout << e.what() << endl;
+    }
+}
@@ -23,7 +23,8 @@ int main() {
         categories["8"] = 8;
         categories["9"] = 9;
         auto expectedEncoder = make_shared<TextToCategoryEncoder>(categories);
-        auto givenEncoder = make_shared<TextToPixelEncoder>();
+        // most pixels are background, so we only keep the rest, and the first layer only multiplies those.
+        auto givenEncoder = make_shared<TextToPixelEncoder>(true);
         // making the shape square (28x28) just to test the auto-flattening capabilities of the network.
         //"..\\data\\mnist_test.csv"
         //"..\\data\\mnist_train.csv"
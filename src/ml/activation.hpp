@@ -10,7 +10,9 @@
 #include "../types/quarter_float.hpp"
 #include "../types/tensor.hpp"
 #include "../types/tensor_views.hpp"
+#include "../types/tensor_reductions.hpp"
 #include "../util/basic_profiler.hpp"
+#include "../util/fast_math.hpp"
 
 // To me, it feels like activation functions are the heart and soul of modern ml.
 // Unfortunately, they can be a little hard to understand without some math background.
@@ -29,6 +31,168 @@
 //   https://en.wikipedia.org/wiki/Activation_function
 namespace happyml {
 
+    // The math of each activation function, and its derivative, for TensorActivationView. Deriving from
+    // ActivationOp gets an op a transform() that loops over operator(). Ops built on exp replace it with one
+    // that works out a whole row at a time (see util/fast_math.hpp.)
+    template<typename Derived>
+    struct ActivationOp {
+        void transform(float *values, size_t count) const {
+            const auto &op = *static_cast<const Derived *>(this);
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = op(values[offset]);
+            }
+        }
+    };
+
+    struct LeakyRelu : public ActivationOp<LeakyRelu> {
+        static constexpr const char *name = "LeakyRelu";
+
+        float operator()(float original) const {
+            // avoid branching in a loop. give negative values a small value.
+            return ((float) (original < 0.0f)) * (0.01f * original) + ((float) (original >= 0.0f)) * original;
+        }
+    };
+
+    struct LeakyReluDerivative : public ActivationOp<LeakyReluDerivative> {
+        static constexpr const char *name = "LeakyReluDerivative";
+
+        float operator()(float original) const {
+            return ((float) (original < 0.0f)) * 0.01f + ((float) (original >= 0.0f)) * 1.0f;
+        }
+    };
+
+    struct Relu : public ActivationOp<Relu> {
+        static constexpr const char *name = "Relu";
+
+        float operator()(float original) const {
+            return std::max(original, 0.0f);
+        }
+    };
+
+    struct ReluDerivative : public ActivationOp<ReluDerivative> {
+        static constexpr const char *name = "ReluDerivative";
+
+        float operator()(float original) const {
+            // derivative original == 0 is undefined.
+            return original > 0.f ? 1.f : 0.f;
+        }
+    };
+
+    // 1 / (1 + e^-x)
+    template<MathAccuracy accuracy>
+    struct SigmoidOf : public ActivationOp<SigmoidOf<accuracy>> {
+        static constexpr const char *name = accuracy == MathAccuracy::full ? "Sigmoid" : "SigmoidFast";
+
+        float operator()(float original) const {
+            return fastSigmoid<accuracy>(original);
+        }
+
+        void transform(float *values, size_t count) const {
+            fastSigmoidValues<accuracy>(values, values, count);
+        }
+    };
+
+    // sigmoid(x) * (1 - sigmoid(x))
+    template<MathAccuracy accuracy>
+    struct SigmoidDerivativeOf : public ActivationOp<SigmoidDerivativeOf<accuracy>> {
+        static constexpr const char *name =
+                accuracy == MathAccuracy::full ? "SigmoidDerivative" : "SigmoidFastDerivative";
+
+        float operator()(float original) const {
+            const float sig = fastSigmoid<accuracy>(original);
+            return sig * (1.f - sig);
+        }
+
+        void transform(float *values, size_t count) const {
+            fastSigmoidValues<accuracy>(values, values, count);
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = values[offset] * (1.f - values[offset]);
+            }
+        }
+    };
+
+    using Sigmoid = SigmoidOf<MathAccuracy::full>;
+    using SigmoidDerivative = SigmoidDerivativeOf<MathAccuracy::full>;
+
+    // There may be faster means of approximating sigmoid. See: https://stackoverflow.com/questions/10732027/fast-sigmoid-algorithm
+    // f(x) = 0.5 * (x / (1 + abs(x)) + 1)
+    // It doesn't need exp at all, so it's already cheap to vectorize.
+    struct SigmoidApprox : public ActivationOp<SigmoidApprox> {
+        static constexpr const char *name = "SigmoidApprox";
+
+        float operator()(float original) const {
+            return 0.5f * ((original / (1.0f + std::abs(original))) + 1);
+        }
+    };
+
+    struct SigmoidApproxDerivative : public ActivationOp<SigmoidApproxDerivative> {
+        static constexpr const char *name = "SigmoidApproxDerivative";
+
+        float operator()(float original) const {
+            // todo: validate math.
+            auto sig = 0.5f * ((original / (1.0f + std::abs(original))) + 1);
+            return sig * (1.f - sig);
+        }
+    };
+
+    template<MathAccuracy accuracy>
+    struct TanhOf : public ActivationOp<TanhOf<accuracy>> {
+        static constexpr const char *name = accuracy == MathAccuracy::full ? "Tanh" : "TanhApprox";
+
+        float operator()(float original) const {
+            return fastTanh<accuracy>(original);
+        }
+
+        void transform(float *values, size_t count) const {
+            fastTanhValues<accuracy>(values, values, count);
+        }
+    };
+
+    // 1 - tanh(x)^2
+    template<MathAccuracy accuracy>
+    struct TanhDerivativeOf : public ActivationOp<TanhDerivativeOf<accuracy>> {
+        static constexpr const char *name = accuracy == MathAccuracy::full ? "TanhDerivative" : "TanhApproxDerivative";
+
+        float operator()(float original) const {
+            const float th = fastTanh<accuracy>(original);
+            return 1 - (th * th);
+        }
+
+        void transform(float *values, size_t count) const {
+            fastTanhValues<accuracy>(values, values, count);
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = 1 - (values[offset] * values[offset]);
+            }
+        }
+    };
+
+    using Tanh = TanhOf<MathAccuracy::full>;
+    using TanhDerivative = TanhDerivativeOf<MathAccuracy::full>;
+    using TanhApprox = TanhOf<MathAccuracy::fast>;
+    using TanhApproxDerivative = TanhDerivativeOf<MathAccuracy::fast>;
+
+    // e^(x - shift) * scale. Softmax shifts by the largest value, so nothing overflows, and scales by one over
+    // the sum of the exponents.
+    struct ScaledExp : public ActivationOp<ScaledExp> {
+        static constexpr const char *name = "ScaledExp";
+        float shift = 0.f;
+        float scale = 1.f;
+
+        float operator()(float original) const {
+            return fastExp(original - shift) * scale;
+        }
+
+        void transform(float *values, size_t count) const {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] -= shift;
+            }
+            fastExpValues(values, values, count);
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] *= scale;
+            }
+        }
+    };
+
     class ActivationFunction {
     public:
         virtual shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) = 0;
@@ -57,19 +221,11 @@ namespace happyml {
     class LeakyReLUActivationFunction : public ActivationFunction {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                // avoid branching in a loop. give negative values a small value.
-                return ((float) (original < 0.0f)) * (0.01f * original) + ((float) (original >= 0.0f)) * original;
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<LeakyRelu>>(input);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                // avoid branching in a loop. give negative values a small value.
-                return ((float) (original < 0.0f)) * 0.01f + ((float) (original >= 0.0f)) * 1.0f;
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<LeakyReluDerivative>>(input);
         }
     };
 
@@ -78,21 +234,11 @@ namespace happyml {
     class ReLUActivationFunction : public ActivationFunction {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                return std::max(original, 0.0f);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<Relu>>(input);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                // derivative original == 0 is undefined.
-                if (original > 0.f) {
-                    return 1.0f;
-                }
-                return 0.f;
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<ReluDerivative>>(input);
         }
     };
 
@@ -102,38 +248,35 @@ namespace happyml {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
             float largestValue = input->max();
-            double sum = 0.0;
+            TensorAxis axis;
             if (input->rowCount() == 1 && input->columnCount() > 0) {
-                for (size_t col = 0; col < input->columnCount(); col++) {
-                    sum += std::exp(input->getValue(0, col, 0) - largestValue);
-                }
+                axis = TensorAxis::columns;
             } else if (input->columnCount() == 1 && input->rowCount() > 0) {
-                for (size_t row = 0; row < input->rowCount(); row++) {
-                    sum += std::exp(input->getValue(row, 0, 0) - largestValue);
-                }
+                axis = TensorAxis::rows;
             } else {
                 throw exception("Softmax supports input with a single row or single column.");
             }
-            vector<double> constants{largestValue, sum};
-            auto transformFunction = [](float original, vector<double> constants) {
-                return ((double) std::expf(original - (float) constants[0])) / constants[1];
-            };
-            return make_shared<TensorValueTransform2View>(input, transformFunction, constants);
+            ScaledExp exponent;
+            exponent.shift = largestValue;
+            const double sum = sumAlongAxis(makeView<TensorActivationView<ScaledExp>>(input, exponent),
+                                            axis)->getValue(0, 0, 0);
+            exponent.scale = (float) (1.0 / sum);
+            return makeView<TensorActivationView<ScaledExp>>(input, exponent);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
             // fixme: broken. producing the wrong shape output. (The output shape is too small.)
             shared_ptr<BaseTensor> softmaxOut = activate(input);
-            auto negative = make_shared<TensorMultiplyByScalarView>(softmaxOut, -1.0f);
-            auto reshape = make_shared<TensorReshapeView>(softmaxOut, softmaxOut->columnCount(),
-                                                          softmaxOut->rowCount());
-            auto dot_product_view = make_shared<TensorDotTensorView>(negative, reshape);
-            auto diag = make_shared<TensorDiagonalView>(softmaxOut);
+            auto negative = makeView<TensorMultiplyByScalarView>(softmaxOut, -1.0f);
+            auto reshape = makeView<TensorReshapeView>(softmaxOut, softmaxOut->columnCount(),
+                                                       softmaxOut->rowCount());
+            auto dot_product_view = makeView<TensorDotTensorView>(negative, reshape);
+            auto diag = makeView<TensorDiagonalView>(softmaxOut);
             cout << "softmax: work in progress... fix me." << endl;
             softmaxOut->print();
             diag->print();
             dot_product_view->print();
-            return make_shared<TensorAddTensorView>(dot_product_view, diag);
+            return makeView<TensorAddTensorView>(dot_product_view, diag);
         }
     };
 
@@ -143,20 +286,12 @@ namespace happyml {
     class SigmoidApproximationActivationFunction : public ActivationFunction {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                return 0.5f * ((original / (1.0f + std::abs(original))) + 1);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<SigmoidApprox>>(input);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
             // result = sigmoid(x) * (1.0 - sigmoid(x))
-            auto transformFunction = [](float original) {
-                // todo: validate math.
-                auto sig = 0.5f * ((original / (1.0f + std::abs(original))) + 1);
-                return sig * (1.f - sig);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<SigmoidApproxDerivative>>(input);
         }
     };
 
@@ -166,19 +301,12 @@ namespace happyml {
     class SigmoidActivationFunction : public ActivationFunction {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                return 1.0f / (1.0f + std::exp(-1.0f * original));
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<Sigmoid>>(input);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
             // result = sigmoid(x) * (1.0 - sigmoid(x))
-            auto transformFunction = [](float original) {
-                auto sig = 1.0f / (1.0f + std::exp(-1.0f * original));
-                return sig * (1.f - sig);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<SigmoidDerivative>>(input);
         }
     };
 
@@ -188,29 +316,14 @@ namespace happyml {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
             PROFILE_BLOCK(profileBlock);
-            auto transformFunction = [](float original) {
-                // tanhActivation(x) = 2 * sigmoid(2x) - 1
-                const float twoX = (2 * original);
-                auto sigmoid = 1.0f / (1.0f + std::exp(-1.0f * twoX));
-//                auto sigmoid = 0.5f * ((original / (1.0f + std::abs(original))) + 1); //super approx
-                return (2 * sigmoid) - 1;
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            // tanh with the faster, less accurate exp.
+            return makeView<TensorActivationView<TanhApprox>>(input);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
             PROFILE_BLOCK(profileBlock);
-            // result = sigmoid(x) * (1.0 - sigmoid(x))
-            auto transformFunction = [](float original) {
-                // todo: validate math.
-                // 1 - tanhActivation^2{x}
-                const float two_x = (2 * original);
-                auto sigmoid = 1.0f / (1.0f + std::exp(-1.0f * two_x));
-//                auto sigmoid = 0.5f * ((original / (1.0f + std::abs(original))) + 1); //super approx
-                const float th = (2 * sigmoid) - 1;
-                return 1 - (th * th);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            // 1 - tanhActivation^2{x}
+            return makeView<TensorActivationView<TanhApproxDerivative>>(input);
         }
     };
 
@@ -219,24 +332,12 @@ namespace happyml {
     class TanhActivationFunction : public ActivationFunction {
     public:
         shared_ptr<BaseTensor> activate(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                // optimization or waste of energy?
-                // tanhActivation(x) = 2 * sigmoid(2x) - 1
-//            const float two_x = (2 * original);
-//            const float sigmoid = 1.0f / (1.0f + std::expf(-1.0f * two_x));
-//            return (2 * sigmoid) - 1;
-                return std::tanh(original);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            return makeView<TensorActivationView<Tanh>>(input);
         }
 
         shared_ptr<BaseTensor> derivative(const shared_ptr<BaseTensor> &input) override {
-            auto transformFunction = [](float original) {
-                // 1 - tanhActivation^2{x}
-                const float th = std::tanh(original);
-                return 1 - (th * th);
-            };
-            return make_shared<TensorValueTransformView>(input, transformFunction);
+            // 1 - tanhActivation^2{x}
+            return makeView<TensorActivationView<TanhDerivative>>(input);
         }
     };
 }
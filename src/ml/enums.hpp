@@ -37,6 +37,15 @@ namespace happyml {
         tanhApprox
     };
 
+    // How a convolution layer lays out what it reads. Channels-last puts every channel of a location together,
+    // which is how a filter reads them, at the cost of converting its input. Automatic picks channels-last
+    // whenever there is more than one channel for a filter (or for the error going back) to sum over.
+    enum ConvolutionLayout {
+        automaticLayout,
+        channelsFirstLayout,
+        channelsLastLayout
+    };
+
     enum TrainingRetentionPolicy {
         best, // accurate
         last  // fast
@@ -107,6 +116,31 @@ namespace happyml {
         throw exception("Unknown Node Type");
     }
 
+    string convolutionLayoutToString(ConvolutionLayout convolutionLayout) {
+        switch (convolutionLayout) {
+            case automaticLayout:
+                return "automatic";
+            case channelsFirstLayout:
+                return "channelsFirst";
+            case channelsLastLayout:
+                return "channelsLast";
+        }
+        throw exception("Unknown Convolution Layout");
+    }
+
+    ConvolutionLayout stringToConvolutionLayout(const string &convolutionLayout) {
+        if (convolutionLayout == "automatic") {
+            return automaticLayout;
+        }
+        if (convolutionLayout == "channelsFirst") {
+            return channelsFirstLayout;
+        }
+        if (convolutionLayout == "channelsLast") {
+            return channelsLastLayout;
+        }
+        throw exception("Unknown Convolution Layout");
+    }
+
     string lossTypeToString(LossType lossType) {
         switch (lossType) {
             case mse:
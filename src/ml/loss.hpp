@@ -17,7 +17,7 @@ namespace happyml {
     class LossFunction {
     public:
         shared_ptr<BaseTensor> calculateError(shared_ptr<BaseTensor> &truth, shared_ptr<BaseTensor> &prediction) {
-            return make_shared<TensorMinusTensorView>(prediction, truth);
+            return makeView<TensorMinusTensorView>(prediction, truth);
         }
 
         shared_ptr<BaseTensor> calculateTotalError(vector<shared_ptr<BaseTensor>> &truths,
@@ -30,7 +30,7 @@ namespace happyml {
             shared_ptr<BaseTensor> total_error = calculateError(truths[0], predictions[0]);
             for (size_t i = 1; i < count; i++) {
                 auto next_error = calculateError(truths[i], predictions[i]);
-                total_error = make_shared<TensorAddTensorView>(total_error, next_error);
+                total_error = makeView<TensorAddTensorView>(total_error, next_error);
             }
             return total_error;
         }
@@ -47,14 +47,14 @@ namespace happyml {
             // for a single prediction: mean of squared error = avg( (prediction - truth)^2 )
             // auto error = make_shared<TensorMinusTensorView>(prediction, truth);
             // for batch, we take the average error: avg( avg(prediction - truth)^2 )
-            auto squared_error = make_shared<TensorPowerView>(total_error, 2.0f);
+            auto squared_error = makeView<TensorPowerView>(total_error, 2.0f);
             return squared_error->arithmeticMean(); // mean of squared error
         }
 
         shared_ptr<BaseTensor> partialDerivative(shared_ptr<BaseTensor> total_error, float batch_size) override {
             // derivative of mean squared error = 2 * (prediction - truth);
             //const auto error = make_shared<TensorMinusTensorView>(prediction, truth);
-            return make_shared<TensorMultiplyByScalarView>(total_error, 2.0f / batch_size);
+            return makeView<TensorMultiplyByScalarView>(total_error, 2.0f / batch_size);
         }
     };
 
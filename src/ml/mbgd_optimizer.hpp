@@ -8,6 +8,10 @@
 
 #include "optimizer.hpp"
 #include "../util/tensor_utils.hpp"
+#include "../types/tensor_reductions.hpp"
+#include "../types/tensor_derived_cache.hpp"
+#include "../types/sparse_tensors.hpp"
+#include "../types/channel_last_tensors.hpp"
 
 using namespace std;
 
@@ -38,6 +42,28 @@ namespace happyml {
         float biasLearningRate;
     };
 
+    // Empties the queue of inputs a function saw during a batch and returns their average.
+    inline shared_ptr<BaseTensor> averageLastInputs(queue<shared_ptr<BaseTensor>> &lastInputs) {
+        vector<shared_ptr<BaseTensor>> inputs;
+        inputs.reserve(lastInputs.size());
+        while (!lastInputs.empty()) {
+            inputs.push_back(lastInputs.front());
+            lastInputs.pop();
+        }
+        if (inputs.size() == 1) {
+            return inputs[0];
+        }
+        // the average of sparse inputs has no more values than all of them put together, so we keep it sparse, and
+        // the weight error (transpose(input) dot error) only works out the rows the inputs have values for.
+        const bool all_sparse = std::all_of(inputs.begin(), inputs.end(), [](const shared_ptr<BaseTensor> &input) {
+            return dynamic_cast<SparseTensor *>(input.get()) != nullptr;
+        });
+        if (all_sparse) {
+            return make_shared<SparseTensor>(averageTensors(inputs));
+        }
+        return averageTensors(inputs);
+    }
+
     // Here's an interesting, related read:
     // https://towardsdatascience.com/convolution-vs-correlation-af868b6b4fb5
     // also:
@@ -46,16 +72,21 @@ namespace happyml {
     public:
         MBGDConvolution2dValidFunction(const string &label,
                                        vector <size_t> inputShape, size_t filters, size_t kernelSize, uint8_t bits,
-                                       const shared_ptr<MBGDLearningState> &learningState) {
+                                       const shared_ptr<MBGDLearningState> &learningState,
+                                       ConvolutionLayout layout = automaticLayout) {
             this->label = label;
             this->inputShape = inputShape;
             this->kernelSize = kernelSize;
             this->outputShape = {inputShape[0] - kernelSize + 1, inputShape[1] - kernelSize + 1, filters};
             this->bits = bits;
+            // going forward, each filter sums over the input channels, and going back, the error sums over filters.
+            this->channelsLast = layout == channelsLastLayout ||
+                                 (layout == automaticLayout && (inputShape[2] > 1 || filters > 1));
             this->weights = {};
             for (size_t next_weight_layer = 0; next_weight_layer < filters; next_weight_layer++) {
-                this->weights.push_back(
-                        make_shared<TensorFromRandom>(kernelSize, kernelSize, inputShape[2], -0.5f, 0.5f, 42));
+                // worked out once, rather than on every read until the first update replaces them.
+                this->weights.push_back(make_shared<FullTensor>(
+                        make_shared<TensorFromRandom>(kernelSize, kernelSize, inputShape[2], -0.5f, 0.5f, 42)));
             }
             this->learningState = learningState;
             if (bits == 32) {
@@ -100,38 +131,35 @@ namespace happyml {
             // filters are the number of output channels we have
             const size_t filters = outputShape[2];
             const size_t inputDepth = inputShape[2];
-            shared_ptr<BaseTensor> result = nullptr;
+            vector<shared_ptr<BaseTensor>> filterOutputs;
+            filterOutputs.reserve(filters);
+            if (channelsLast) {
+                // every filter reads all of the input, so we lay it out once for all of them.
+                const auto channelLastInput = toChannelLayout(lastInput, ChannelLayout::channelsLast);
+                for (size_t outputLayer = 0; outputLayer < filters; outputLayer++) {
+                    filterOutputs.push_back(makeView<TensorChannelSumCrossCorrelation2dView>(
+                            channelLastInput, cachedChannelsLast(weights[outputLayer])));
+                }
+                return makeView<TensorConcatChannelsView>(filterOutputs);
+            }
             for (size_t outputLayer = 0; outputLayer < filters; outputLayer++) {
                 shared_ptr<BaseTensor> outputTensor = nullptr;
                 for (size_t inputLayer = 0; inputLayer < inputDepth; inputLayer++) {
-                    const auto weightForInputLayer = make_shared<TensorChannelToTensorView>(weights[outputLayer],
-                                                                                            inputLayer);
-                    const auto inputChannel = make_shared<TensorChannelToTensorView>(lastInput, inputLayer);
-                    const auto correlation2d = make_shared<TensorValidCrossCorrelation2dView>(inputChannel,
-                                                                                              weightForInputLayer);
+                    const auto weightForInputLayer = makeView<TensorChannelToTensorView>(
+                            cachedDecode(weights[outputLayer]), inputLayer);
+                    const auto inputChannel = makeView<TensorChannelToTensorView>(lastInput, inputLayer);
+                    const auto correlation2d = makeView<TensorValidCrossCorrelation2dView>(inputChannel,
+                                                                                           weightForInputLayer);
                     if (outputTensor) {
-                        outputTensor = make_shared<TensorAddTensorView>(outputTensor, correlation2d);
+                        outputTensor = makeView<TensorAddTensorView>(outputTensor, correlation2d);
                     } else {
                         outputTensor = correlation2d;
                     }
                 }
-                const shared_ptr<BaseTensor> summedCorrelation2d = make_shared<TensorSumToChannelView>(outputTensor,
-                                                                                                       outputLayer,
-                                                                                                       filters);
-                if (!result) {
-                    result = summedCorrelation2d;
-                } else {
-                    // each summed correlation 2d tensor is in its own output channel
-                    result = make_shared<TensorAddTensorView>(result, summedCorrelation2d);
-                }
+                filterOutputs.push_back(outputTensor);
             }
-            // todo: it would be faster to have some sort of CombinedTensor where rather than adding the tensors,
-            //  passed a vector of tensors and we only use 1 layer from each. The tensor add object will
-            //  cause us to add a 0 to each value for each layer. If you have tensors added together, you'll
-            //  have an 256 additional + operations for every value you fetch -- and those operations aren't
-            //  changing the outcome.
-
-            return result;
+            // each filter's summed correlation 2d tensor is its own output channel
+            return makeView<TensorConcatChannelsView>(filterOutputs);
         }
 
         shared_ptr<BaseTensor> backward(const shared_ptr<BaseTensor> &outputError) override {
@@ -139,61 +167,58 @@ namespace happyml {
             if (lastInputsSize < 1) {
                 throw exception("MBGDFullyConnectedNeurons.backward() called without previous inputs.");
             }
-            shared_ptr<BaseTensor> averageLastInputs = lastInputs.front();
-            lastInputs.pop();
-            while (!lastInputs.empty()) {
-                auto nextLastInput = lastInputs.front();
-                lastInputs.pop();
-                averageLastInputs = make_shared<TensorAddTensorView>(averageLastInputs, nextLastInput);
-            }
-            if (lastInputsSize > 1) {
-                averageLastInputs = materializeTensor(
-                        make_shared<TensorMultiplyByScalarView>(averageLastInputs, 1.f / (float) lastInputsSize));
-            }
+            const shared_ptr<BaseTensor> averageInputs = averageLastInputs(lastInputs);
 
             // input error for each input channel is
             // the sum of the fullConvolve2d of the output errors and the weights
             // filters are the number of output channels we have
             const size_t filters = outputShape[2];
             const size_t inputDepth = inputShape[2];
-            shared_ptr<BaseTensor> inputError = nullptr;
+            // the input error of each input channel, summed across the filters
+            vector<shared_ptr<BaseTensor>> inputErrors(inputDepth);
+            vector<shared_ptr<BaseTensor>> adjustedWeights(filters);
             for (size_t outputLayer = 0; outputLayer < filters; outputLayer++) {
-                const auto outputErrorForLayer = make_shared<TensorChannelToTensorView>(outputError, outputLayer);
-                shared_ptr<BaseTensor> weightChanges = nullptr;
+                const auto outputErrorForLayer = makeView<TensorChannelToTensorView>(outputError, outputLayer);
+                vector<shared_ptr<BaseTensor>> weightErrors;
+                weightErrors.reserve(inputDepth);
                 for (size_t inputLayer = 0; inputLayer < inputDepth; inputLayer++) {
-                    const auto weightForInputLayer = make_shared<TensorChannelToTensorView>(weights[outputLayer],
-                                                                                            inputLayer);
-                    const auto nextInputError = make_shared<TensorFullConvolve2dView>(outputErrorForLayer,
-                                                                                      weightForInputLayer);
-                    const auto inputErrorToInputChannel = make_shared<TensorSumToChannelView>(nextInputError,
-                                                                                              inputLayer, inputDepth);
-                    if (inputError) {
-                        inputError = make_shared<TensorAddTensorView>(inputError, inputErrorToInputChannel);
-                    } else {
-                        inputError = inputErrorToInputChannel;
-                    }
-                    const auto inputLayerChannel = make_shared<TensorChannelToTensorView>(averageLastInputs,
-                                                                                          inputLayer);
-                    const auto nextWeightError = make_shared<TensorValidCrossCorrelation2dView>(inputLayerChannel,
-                                                                                                outputErrorForLayer);
-                    const auto nextWeightToInputChannel = make_shared<TensorSumToChannelView>(nextWeightError,
-                                                                                              inputLayer, inputDepth);
-                    if (weightChanges) {
-                        weightChanges = make_shared<TensorAddTensorView>(weightChanges, nextWeightToInputChannel);
-                    } else {
-                        weightChanges = nextWeightToInputChannel;
+                    if (!channelsLast) {
+                        const auto weightForInputLayer = makeView<TensorChannelToTensorView>(
+                                cachedDecode(weights[outputLayer]), inputLayer);
+                        const auto nextInputError = makeView<TensorFullConvolve2dView>(outputErrorForLayer,
+                                                                                       weightForInputLayer);
+                        if (inputErrors[inputLayer]) {
+                            inputErrors[inputLayer] = makeView<TensorAddTensorView>(inputErrors[inputLayer],
+                                                                                    nextInputError);
+                        } else {
+                            inputErrors[inputLayer] = nextInputError;
+                        }
                     }
+                    const auto inputLayerChannel = makeView<TensorChannelToTensorView>(averageInputs, inputLayer);
+                    weightErrors.push_back(makeView<TensorValidCrossCorrelation2dView>(inputLayerChannel,
+                                                                                       outputErrorForLayer));
                 }
-                const auto nextWeightErrorAtLearningRate = make_shared<TensorMultiplyByScalarView>(weightChanges,
-                                                                                                   learningState->learningRate *
-                                                                                                   mixedPrecisionScale);
-                const auto adjustedWeights = make_shared<TensorMinusTensorView>(weights[outputLayer],
-                                                                                nextWeightErrorAtLearningRate);
-                weights[outputLayer] = materializeTensor(adjustedWeights, bits);
+                // each input channel's weight error is its own channel of the filter
+                const auto weightChanges = makeView<TensorConcatChannelsView>(weightErrors);
+                const auto nextWeightErrorAtLearningRate = makeView<TensorMultiplyByScalarView>(weightChanges,
+                                                                                                learningState->learningRate *
+                                                                                                mixedPrecisionScale);
+                adjustedWeights[outputLayer] = makeView<TensorMinusTensorView>(weights[outputLayer],
+                                                                               nextWeightErrorAtLearningRate);
             }
 
-            const auto resultError = make_shared<TensorSumChannelsView>(inputError);
-            return resultError;
+            // the input errors read the weights, so we need them before the weights are updated in place.
+            const auto inputError = channelsLast ? channelLastInputError(outputError)
+                                                 : sumAlongAxis(makeView<TensorConcatChannelsView>(inputErrors),
+                                                                TensorAxis::channels);
+            for (size_t outputLayer = 0; outputLayer < filters; outputLayer++) {
+                weights[outputLayer] = updateTensor(weights[outputLayer], adjustedWeights[outputLayer], bits);
+            }
+            return inputError;
+        }
+
+        [[nodiscard]] bool isChannelsLast() const {
+            return channelsLast;
         }
 
     private:
@@ -204,18 +229,40 @@ namespace happyml {
         vector <size_t> inputShape;
         vector <size_t> outputShape;
         size_t kernelSize;
+        bool channelsLast;
         shared_ptr<MBGDLearningState> learningState;
         string label;
+
+        // The same input error the channel-first path works out, summed across the input channels: the full
+        // convolution of each filter's error with each of its weight channels. Convolving with each channel and
+        // then summing is the same as convolving with the sum of the channels, so each filter's kernel is the sum
+        // of its channels, rotated, and then all the filters are one channel-last correlation over the padded error.
+        shared_ptr<BaseTensor> channelLastInputError(const shared_ptr<BaseTensor> &outputError) {
+            const size_t filters = outputShape[2];
+            // the padding TensorFullCrossCorrelation2dView uses
+            const size_t padding = (kernelSize > 1) * (size_t) std::round(((double) kernelSize) / 2.0);
+            const auto paddedError = make_shared<ChannelLastTensor>(
+                    makeView<TensorZeroPaddedView>(outputError, padding, padding, padding, padding));
+            vector<shared_ptr<BaseTensor>> kernels(filters);
+            for (size_t outputLayer = 0; outputLayer < filters; outputLayer++) {
+                kernels[outputLayer] = makeView<TensorRotate180View>(
+                        makeView<TensorSumChannelsView>(weights[outputLayer]));
+            }
+            const auto kernel = make_shared<ChannelLastTensor>(makeView<TensorConcatChannelsView>(kernels));
+            return make_shared<FullTensor>(makeView<TensorChannelSumCrossCorrelation2dView>(paddedError, kernel));
+        }
     };
 
     class MBGDFullyConnectedNeurons : public NeuralNetworkFunction {
     public:
         MBGDFullyConnectedNeurons(const string &label, size_t inputSize, size_t outputSize, uint8_t bits,
-                                  const shared_ptr<MBGDLearningState> &learningState) {
+                                  bool packedWeights, const shared_ptr<MBGDLearningState> &learningState) {
             this->label = label;
+            this->packedWeights = packedWeights;
             this->inputShapes = vector<vector<size_t >>{{1, inputSize, 1}};
             this->outputShape = vector<size_t>{1, outputSize, 1};
-            this->weights = make_shared<TensorFromRandom>(inputSize, outputSize, 1, -0.5f, 0.5f, 42);
+            this->weights = make_shared<FullTensor>(
+                    make_shared<TensorFromRandom>(inputSize, outputSize, 1, -0.5f, 0.5f, 42));
             this->bits = bits;
             this->learningState = learningState;
             if (bits == 32) {
@@ -243,6 +290,10 @@ namespace happyml {
         void loadKnowledge(const string &fullKnowledgePath) override {
             string path = fullKnowledgePath + "/" + label + ".tensor";
             this->weights = make_shared<FullTensor>(path);
+            if (packedWeights) {
+                // we only keep the packed copy. Saving reads it back out row by row.
+                this->weights = make_shared<PackedGemmTensor>(this->weights);
+            }
         }
 
         // predicting
@@ -257,7 +308,10 @@ namespace happyml {
                 lastInputs.push(lastInput);
             }
 
-            return make_shared<TensorDotTensorView>(lastInput, weights);
+            // 16 and 8-bit weights are decoded (and packed, when we were asked to) once per update, rather than on
+            // every read of every prediction.
+            return makeView<TensorDotTensorView>(lastInput, packedWeights ? cachedPackForGemm(weights)
+                                                                          : cachedDecode(weights));
         }
 
         // learning
@@ -268,34 +322,24 @@ namespace happyml {
             if (lastInputsSize < 1) {
                 throw exception("MBGDFullyConnectedNeurons.backward() called without previous inputs.");
             }
-            shared_ptr<BaseTensor> average_last_inputs = lastInputs.front();
-            lastInputs.pop();
-            while (!lastInputs.empty()) {
-                auto nextLastInput = lastInputs.front();
-                lastInputs.pop();
-                average_last_inputs = make_shared<TensorAddTensorView>(average_last_inputs, nextLastInput);
-            }
-            if (lastInputsSize > 1) {
-                average_last_inputs = materializeTensor(
-                        make_shared<TensorMultiplyByScalarView>(average_last_inputs, 1.f / (float) lastInputsSize));
-            }
+            const shared_ptr<BaseTensor> average_last_inputs = averageLastInputs(lastInputs);
 
             // find the error
-            auto weights_transposed = make_shared<TensorTransposeView>(weights);
+            auto weights_transposed = cachedTranspose(weights);
             // TODO: we greatly improve performance by materializing the tensor into a FullTensor here, but sometimes this will use
             //  considerably more memory than we need. Part of me thinks that all dot product tensors should be materialized,
             //  and part of me thinks that there are situations of simple dot products don't need to be.
             shared_ptr<BaseTensor> input_error = make_shared<FullTensor>(
-                    make_shared<TensorDotTensorView>(output_error, weights_transposed));
+                    simplifyTensor(makeView<TensorDotTensorView>(output_error, weights_transposed)));
 
             // update weights
-            auto input_transposed = make_shared<TensorTransposeView>(average_last_inputs);
-            auto weights_error = make_shared<TensorDotTensorView>(input_transposed, output_error);
-            auto weights_error_at_learning_rate = make_shared<TensorMultiplyByScalarView>(weights_error,
-                                                                                          learningState->learningRate *
-                                                                                          mixedPrecisionScale);
-            auto adjusted_weights = make_shared<TensorMinusTensorView>(weights, weights_error_at_learning_rate);
-            weights = materializeTensor(adjusted_weights, bits);
+            auto input_transposed = makeView<TensorTransposeView>(average_last_inputs);
+            auto weights_error = makeView<TensorDotTensorView>(input_transposed, output_error);
+            auto weights_error_at_learning_rate = makeView<TensorMultiplyByScalarView>(weights_error,
+                                                                                       learningState->learningRate *
+                                                                                       mixedPrecisionScale);
+            auto adjusted_weights = makeView<TensorMinusTensorView>(weights, weights_error_at_learning_rate);
+            weights = updateTensor(weights, adjusted_weights, bits);
 
             return input_error;
         }
@@ -304,6 +348,7 @@ namespace happyml {
         shared_ptr<BaseTensor> weights;
         queue <shared_ptr<BaseTensor>> lastInputs;
         uint8_t bits;
+        bool packedWeights;
         float mixedPrecisionScale;
         vector <vector<size_t>> inputShapes;
         vector <size_t> outputShape;
@@ -397,24 +442,26 @@ namespace happyml {
                 current_batch_size++;
             }
 
-            return make_shared<TensorAddTensorView>(input[0], bias);
+            return makeView<TensorAddTensorView>(input[0], bias);
         }
 
         // learning
         shared_ptr<BaseTensor> backward(const shared_ptr<BaseTensor> &output_error) override {
             PROFILE_BLOCK(profileBlock);
 
-            auto bias_error_at_learning_rate = make_shared<TensorMultiplyByScalarView>(output_error,
-                                                                                       learningState->biasLearningRate *
-                                                                                       mixedPrecisionScale /
-                                                                                       (float) current_batch_size);
-            auto adjusted_bias = make_shared<TensorMinusTensorView>(bias, bias_error_at_learning_rate);
-            bias = materializeTensor(adjusted_bias, bits);
+            // we pass the error along after updating the bias in place, so it can't still be reading the bias.
+            const auto error = output_error->contains(bias) ? materializeTensor(output_error) : output_error;
+            auto bias_error_at_learning_rate = makeView<TensorMultiplyByScalarView>(error,
+                                                                                    learningState->biasLearningRate *
+                                                                                    mixedPrecisionScale /
+                                                                                    (float) current_batch_size);
+            auto adjusted_bias = makeView<TensorMinusTensorView>(bias, bias_error_at_learning_rate);
+            bias = updateTensor(bias, adjusted_bias, bits);
 
             current_batch_size = 0;
             // TODO: partial derivative of bias would always be 1, so we pass along original error. I'm fairly sure this is right.
             // but I notice that the quarter float doesn't handle big shifts in scale very well
-            return output_error;
+            return error;
         }
 
     private:
@@ -444,9 +491,10 @@ namespace happyml {
 
         shared_ptr<NeuralNetworkFunction> createFullyConnectedNeurons(const string &label, size_t input_size,
                                                                       size_t output_size,
-                                                                      uint8_t bits) override {
+                                                                      uint8_t bits,
+                                                                      bool packedWeights) override {
             return make_shared<MBGDFullyConnectedNeurons>(label, input_size,
-                                                          output_size, bits, mbgdLearningState);
+                                                          output_size, bits, packedWeights, mbgdLearningState);
         }
 
         shared_ptr<NeuralNetworkFunction> createBias(const string &label, vector <size_t> input_shape,
@@ -456,9 +504,9 @@ namespace happyml {
 
         shared_ptr<NeuralNetworkFunction> createConvolutional2d(const string &label, vector <size_t> input_shape,
                                                                 size_t filters, size_t kernel_size,
-                                                                uint8_t bits) override {
+                                                                uint8_t bits, ConvolutionLayout layout) override {
             return make_shared<MBGDConvolution2dValidFunction>(label, input_shape, filters, kernel_size, bits,
-                                                               mbgdLearningState);
+                                                               mbgdLearningState, layout);
         }
 
     private:
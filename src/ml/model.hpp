@@ -87,7 +87,8 @@ namespace happymldsl {
             // buildNode will add two types of metadata
             // first it will add a vertex record:
             // "vertex", id, is input, is output, node type, activation type, materialized, uses bias, bits,
-            // input rows, input columns, input channels, output rows, output columns, output channels, filters, kernels
+            // input rows, input columns, input channels, output rows, output columns, output channels, filters, kernels,
+        // packed weights, convolution layout (both missing from models saved before we had them)
 
             // and then it will add any edge records:
             // "edge", from id, to id, to id, to id...
@@ -167,6 +168,21 @@ namespace happymldsl {
                 return shared_from_this();
             }
 
+            // Keep a fully connected layer's weights in the order the matrix multiply kernel reads them, rather than
+            // row by row. Predictions read weights far more often than training changes them, so this mostly helps
+            // models that are used one sample at a time. Saved knowledge is the same either way.
+            shared_ptr<NNVertex> setPackedWeights(bool packed) {
+                this->packed_weights = packed;
+                return shared_from_this();
+            }
+
+            // How a convolutional layer lays out its input and weights (see ConvolutionLayout.) Leave it on
+            // automatic unless you're comparing the two.
+            shared_ptr<NNVertex> setConvolutionLayout(ConvolutionLayout layout) {
+                this->convolution_layout = layout;
+                return shared_from_this();
+            }
+
             // edge aka connection
             struct NNEdge {
                 weak_ptr<NNVertex> from;
@@ -279,7 +295,9 @@ namespace happymldsl {
                                            asString(outputShape[1]),
                                            asString(outputShape[2]),
                                            asString(getFilters()),
-                                           asString(getKernelSize())
+                                           asString(getKernelSize()),
+                                           asString(isPackedWeights()),
+                                           convolutionLayoutToString(getConvolutionLayout())
                                           });
                 shared_ptr<Optimizer> optimizer = nn->getOptimizer();
                 shared_ptr<NeuralNetworkNode> next_node;
@@ -294,12 +312,12 @@ namespace happymldsl {
                             optimizer->createFullyConnectedNeurons(fullNodeLabel,
                                                                    inputShape[0] * inputShape[1] * inputShape[2],
                                                                    outputShape[0] * outputShape[1] * outputShape[2],
-                                                                   bits));
+                                                                   bits, packed_weights));
                 } else if (node_type == NodeType::convolution2dValid) {
                     string c2dvLabel = asString(vertexUniqueId) + "_c2dv";
                     next_node = make_shared<NeuralNetworkNode>(
                             optimizer->createConvolutional2d(c2dvLabel, inputShape, filters,
-                                                             kernel_size, bits));
+                                                             kernel_size, bits, convolution_layout));
                 } else {
                     throw exception("Unimplemented NodeType");
                 }
@@ -406,6 +424,14 @@ namespace happymldsl {
                 return bits;
             }
 
+            bool isPackedWeights() const {
+                return packed_weights;
+            }
+
+            ConvolutionLayout getConvolutionLayout() const {
+                return convolution_layout;
+            }
+
             vector<size_t> getInputShape() {
                 return inputShape;
             }
@@ -432,6 +458,8 @@ namespace happymldsl {
             bool materialized;
             bool use_bias;
             uint8_t bits;
+            bool packed_weights{};
+            ConvolutionLayout convolution_layout{automaticLayout};
             shared_ptr<NeuralNetworkNode> first_node;
             size_t kernel_size{};
             size_t filters{};
@@ -554,6 +582,10 @@ namespace happymldsl {
                                             stoull(vertexMetadata[14])};
         size_t filters = stoull(vertexMetadata[15]);
         size_t kernels = stoull(vertexMetadata[16]);
+        const bool packedWeights = vertexMetadata.size() > 17 && asBool(vertexMetadata[17]);
+        const ConvolutionLayout convolutionLayout = vertexMetadata.size() > 18
+                                                    ? stringToConvolutionLayout(vertexMetadata[18])
+                                                    : automaticLayout;
         if (acceptsInput) {
             if (producesOutput) {
                 if (filters > 0) {
@@ -597,6 +629,8 @@ namespace happymldsl {
         createdVertexes[vertexId]->setMaterialized(isMaterialized);
         createdVertexes[vertexId]->setUseBias(useBias);
         createdVertexes[vertexId]->setBits(bits);
+        createdVertexes[vertexId]->setPackedWeights(packedWeights);
+        createdVertexes[vertexId]->setConvolutionLayout(convolutionLayout);
 
         if (edgeFromTo.count(vertexId) > 0) {
             auto edges = edgeFromTo[vertexId];
@@ -147,16 +147,16 @@ namespace happyml {
                             break;
                         }
                         if (sum == nullptr) {
-                            sum = make_shared<TensorAddTensorView>(priorError, output_conn->priorError);
+                            sum = makeView<TensorAddTensorView>(priorError, output_conn->priorError);
                         } else {
-                            sum = make_shared<TensorAddTensorView>(sum, output_conn->priorError);
+                            sum = makeView<TensorAddTensorView>(sum, output_conn->priorError);
                         }
                     }
                     if (!ready) {
                         continue;
                     }
-                    shared_ptr<BaseTensor> average_error = make_shared<TensorMultiplyByScalarView>(sum, 1.0f /
-                                                                                                        (float) fromConnectionOutputSize);
+                    shared_ptr<BaseTensor> average_error = makeView<TensorMultiplyByScalarView>(sum, 1.0f /
+                                                                                                     (float) fromConnectionOutputSize);
                     from->backward(average_error);
                     for (const auto &output_conn: from->connectionOutputs) {
                         output_conn->priorError = nullptr;
@@ -474,6 +474,7 @@ namespace happyml {
                 throw exception("Batch Size cannot be larger than trainingDataset data set.");
             }
             ElapsedTimer totalTimer;
+            const size_t removedNodesBefore = TensorSimplifier::getCounters().removedNodes;
             const size_t outputSize = outputNodes.size();
             cout << endl;
             size_t lowestLossEpoch = 0;
@@ -516,9 +517,9 @@ namespace happyml {
                             // TODO: materializing the error into a full tensor helps performance at the cost of memory.
                             //  we should be able to determine the best strategy at runtime. Sometimes, memory is too valuable
                             //  to use for performance.
-                            auto totalError = make_shared<FullTensor>(
+                            auto totalError = make_shared<FullTensor>(simplifyTensor(
                                     lossFunction->calculateTotalError(batchTruths[outputIndex],
-                                                                      batchPredictions[outputIndex]));
+                                                                      batchPredictions[outputIndex])));
                             auto totalLoss = lossFunction->compute(totalError);
                             auto batchLoss = totalLoss / (float) batchOffset;
                             totalBatchOutputLoss += batchLoss;
@@ -532,6 +533,9 @@ namespace happyml {
                             batchTruths[outputIndex].clear();
                             batchPredictions[outputIndex].clear();
                         }
+                        // everything this batch built has been released by now, so the arena can drop what it
+                        // no longer needs and keep the rest for the next batch.
+                        TensorArena::instance().endBatch();
                         // for each offset:
                         //   average = average + (val[offset] - average)/(offset+1)
                         // TODO: this loss assumes that all outputs have the same weight, which may not be true:
@@ -568,6 +572,7 @@ namespace happyml {
                 trainingDataset->restart();
                 epoch++;
             } while (!exitStrategy->isDone(epoch, epochTestingLoss, epochTimer.getMilliseconds()));
+            TensorArena::instance().trim();
             int64_t elapsed = totalTimer.getMilliseconds();
             cout << endl << "Finished training in ";
             if (elapsed < 2000) {
@@ -577,6 +582,8 @@ namespace happyml {
             } else {
                 cout << (elapsed / 60000) << " minutes." << endl;
             }
+            cout << "Simplified away " << (TensorSimplifier::getCounters().removedNodes - removedNodesBefore)
+                 << " views." << endl;
             // TODO: this is placeholder code until we actually save and formalize best loss,
             //  but it simulates the future results.
             if (trainingRetentionPolicy == best) {
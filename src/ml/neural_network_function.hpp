@@ -7,6 +7,7 @@
 #define HAPPYML_NEURAL_NETWORK_FUNCTION_HPP
 
 #include "activation.hpp"
+#include "../types/sparse_tensors.hpp"
 #include "../util/tensor_utils.hpp"
 #include "../util/basic_profiler.hpp"
 
@@ -59,20 +60,20 @@ namespace happyml {
             while (!lastInputs.empty()) {
                 auto nextLastInput = activationFunction->derivative(lastInputs.front());
                 lastInputs.pop();
-                averageActivationDerivative = make_shared<TensorAddTensorView>(averageActivationDerivative,
-                                                                               nextLastInput);
+                averageActivationDerivative = makeView<TensorAddTensorView>(averageActivationDerivative,
+                                                                            nextLastInput);
             }
             if (lastInputsSize > 1) {
                 averageActivationDerivative = materializeTensor(
-                        make_shared<TensorMultiplyByScalarView>(averageActivationDerivative,
-                                                                1.f / (float) lastInputsSize));
+                        makeView<TensorMultiplyByScalarView>(averageActivationDerivative,
+                                                             1.f / (float) lastInputsSize));
             }
 
             //auto activation_derivative = activationFunction->derivative(average_last_inputs);
             // this really threw me for a loop. I thought that this was supposed to be dot product, rather than
             // an element-wise-multiplication.
-            const auto baseOutputError = make_shared<TensorMultiplyTensorView>(averageActivationDerivative,
-                                                                               outputError);
+            const auto baseOutputError = makeView<TensorMultiplyTensorView>(averageActivationDerivative,
+                                                                            outputError);
             return baseOutputError;
         }
 
@@ -91,11 +92,16 @@ namespace happyml {
             const auto &nextInput = input[0];
             originalCols = nextInput->columnCount();
             originalRows = nextInput->rowCount();
+            originalChannels = nextInput->channelCount();
             if (originalRows == 1) {
                 // This flatten function was added unnecessarily. We could throw an exception.
                 return nextInput;
             }
-            return make_shared<TensorFlattenToRowView>(nextInput);
+            if (auto sparse = dynamic_cast<SparseTensor *>(nextInput.get())) {
+                // stays sparse, so the dense layer after us can skip the zeros
+                return sparse->flattenToRow();
+            }
+            return makeView<TensorFlattenToRowView>(nextInput);
         }
 
         shared_ptr<BaseTensor> backward(const shared_ptr<BaseTensor> &output_error) override {
@@ -104,12 +110,26 @@ namespace happyml {
                 // This flatten function was added unnecessarily. We could throw an exception.
                 return output_error;
             }
-            return make_shared<TensorReshapeView>(output_error, originalRows, originalCols);
+            if (originalChannels > 1) {
+                // we flattened channel after channel, so each channel is its own stretch of the row.
+                const size_t elementsPerChannel = originalRows * originalCols;
+                vector<shared_ptr<BaseTensor>> channelErrors;
+                channelErrors.reserve(originalChannels);
+                for (size_t channel = 0; channel < originalChannels; channel++) {
+                    const auto channelError = makeView<TensorSliceView>(output_error, 0, 1,
+                                                                        channel * elementsPerChannel,
+                                                                        elementsPerChannel, 0, 1);
+                    channelErrors.push_back(makeView<TensorReshapeView>(channelError, originalRows, originalCols));
+                }
+                return makeView<TensorConcatChannelsView>(channelErrors);
+            }
+            return makeView<TensorReshapeView>(output_error, originalRows, originalCols);
         }
 
     private:
         size_t originalRows{};
         size_t originalCols{};
+        size_t originalChannels{};
     };
 }
 #endif //HAPPYML_NEURAL_NETWORK_FUNCTION_HPP
@@ -7,6 +7,7 @@
 #define HAPPYML_OPTIMIZER_HPP
 
 #include "neural_network_function.hpp"
+#include "enums.hpp"
 
 // Optimizers are the strategy applied to find the optimal results
 // The optimizer takes in:
@@ -33,12 +34,14 @@ namespace happyml {
                                                                         vector<size_t> input_shape,
                                                                         size_t filters,
                                                                         size_t kernel_size,
-                                                                        uint8_t bits) = 0;
+                                                                        uint8_t bits,
+                                                                        ConvolutionLayout layout) = 0;
 
         virtual shared_ptr<NeuralNetworkFunction> createFullyConnectedNeurons(const string &label,
                                                                               size_t input_size,
                                                                               size_t output_size,
-                                                                              uint8_t bits) = 0;
+                                                                              uint8_t bits,
+                                                                              bool packedWeights) = 0;
 
         virtual shared_ptr<NeuralNetworkFunction> createBias(const string &label,
                                                              vector<size_t> input_shape,
@@ -3,7 +3,9 @@
 // Copyright 2022. Usable under MIT license.
 //
 
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include "../ml/model.hpp"
 
 using namespace happymldsl;
@@ -52,12 +54,170 @@ void testTanhApproxDerivative() {
     assertEqual(expected, result);
 }
 
+void assertClose(double expected, double actual, double tolerance, const string &what) {
+    if (!(std::fabs(expected - actual) <= tolerance)) {
+        cout << what << ": expected " << expected << " but got " << actual << endl;
+        throw exception("Values are not close enough.");
+    }
+}
+
+// values from -100 to 100, including ones that are very close to zero, enough of them that the vectorized
+// loops run and there are a few left over at the end.
+vector<float> fastMathInputs() {
+    vector<float> inputs;
+    for (int step = -500; step <= 500; step++) {
+        inputs.push_back((float) step / 5.f);
+    }
+    for (float tiny: {1e-3f, -1e-3f, 1e-7f, -1e-7f, 0.f, -0.f}) {
+        inputs.push_back(tiny);
+    }
+    return inputs;
+}
+
+void testFastMath() {
+    auto inputs = fastMathInputs();
+    const size_t count = inputs.size();
+    vector<float> full(count);
+    vector<float> fast(count);
+    const double epsilon = numeric_limits<float>::epsilon();
+
+    fastExpValues<MathAccuracy::full>(inputs.data(), full.data(), count);
+    fastExpValues<MathAccuracy::fast>(inputs.data(), fast.data(), count);
+    for (size_t offset = 0; offset < count; offset++) {
+        const double expected = std::exp((double) inputs[offset]);
+        if (inputs[offset] < FAST_EXP_MIN || inputs[offset] > FAST_EXP_MAX) {
+            if (full[offset] != (inputs[offset] < 0 ? 0.f : numeric_limits<float>::infinity())) {
+                throw exception("exp doesn't underflow to zero, or overflow to infinity.");
+            }
+            continue;
+        }
+        assertClose(expected, full[offset], 3 * epsilon * expected, "exp");
+        assertClose(expected, fast[offset], 3.5e-6 * expected, "fast exp");
+        assertClose(full[offset], fastExp(inputs[offset]), epsilon * full[offset], "scalar exp");
+    }
+
+    fastTanhValues<MathAccuracy::full>(inputs.data(), full.data(), count);
+    fastTanhValues<MathAccuracy::fast>(inputs.data(), fast.data(), count);
+    for (size_t offset = 0; offset < count; offset++) {
+        const double expected = std::tanh((double) inputs[offset]);
+        assertClose(expected, full[offset], 4 * epsilon, "tanh");
+        assertClose(expected, fast[offset], 2e-6, "fast tanh");
+        assertClose(full[offset], fastTanh(inputs[offset]), 2 * epsilon, "scalar tanh");
+    }
+
+    fastSigmoidValues<MathAccuracy::full>(inputs.data(), full.data(), count);
+    for (size_t offset = 0; offset < count; offset++) {
+        const double expected = 1.0 / (1.0 + std::exp(-(double) inputs[offset]));
+        // keeps its precision close to zero, too, until it gets too small to be a normal float
+        assertClose(expected, full[offset], 4 * epsilon * expected + numeric_limits<float>::min(), "sigmoid");
+        assertClose(full[offset], fastSigmoid(inputs[offset]), 2 * epsilon * full[offset], "scalar sigmoid");
+    }
+
+    vector<float> positive;
+    for (size_t offset = 0; offset < count; offset++) {
+        positive.push_back(std::exp(inputs[offset] * 0.8f));
+    }
+    // a denormal
+    positive.push_back(1e-40f);
+    fastLogValues(positive.data(), full.data(), positive.size());
+    for (size_t offset = 0; offset < positive.size(); offset++) {
+        const double expected = std::log((double) positive[offset]);
+        assertClose(expected, full[offset], 2 * epsilon * std::max(1.0, std::fabs(expected)), "log");
+        assertClose(full[offset], fastLog(positive[offset]), epsilon * std::max(1.0, std::fabs(expected)),
+                    "scalar log");
+    }
+
+    // the edges behave like the standard library's
+    const float infinity = numeric_limits<float>::infinity();
+    vector<float> edges{0.f, -1.f, infinity, numeric_limits<float>::quiet_NaN(), 100.f, -100.f, 1.f, 2.f};
+    vector<float> results(edges.size());
+    fastLogValues(edges.data(), results.data(), edges.size());
+    if (results[0] != -infinity || !std::isnan(results[1]) || results[2] != infinity || !std::isnan(results[3])) {
+        throw exception("log doesn't handle zero, negative, infinite or NaN values.");
+    }
+    fastExpValues(edges.data(), results.data(), edges.size());
+    if (results[0] != 1.f || results[2] != infinity || !std::isnan(results[3]) || results[4] != infinity ||
+        results[5] != 0.f) {
+        throw exception("exp doesn't handle zero, infinite, NaN, huge or tiny values.");
+    }
+    if (fastLog(0.f) != -infinity || !std::isnan(fastLog(-1.f)) || fastExp(-100.f) != 0.f ||
+        fastExp(100.f) != infinity || !std::isnan(fastExp(numeric_limits<float>::quiet_NaN()))) {
+        throw exception("Scalar versions don't handle the edges.");
+    }
+    cout << "testFastMath passed" << endl;
+}
+
+// an activation, read a row at a time (the vectorized path), matches reading it a value at a time, and the
+// function it's supposed to be.
+void assertActivationMatches(const shared_ptr<BaseTensor> &activation, const function<double(double)> &expected,
+                             double tolerance, const string &what) {
+    auto inputs = fastMathInputs();
+    auto input = make_shared<FullTensor>(make_shared<TensorFromFunction>([&inputs](size_t row, size_t col,
+                                                                                   size_t channel) {
+        return inputs[col];
+    }, 1, inputs.size(), 1));
+    vector<float> row(inputs.size());
+    auto view = dynamic_pointer_cast<BaseTensorActivationView>(activation)->withChild(input);
+    view->readRow(0, 0, 0, inputs.size(), row.data());
+    for (size_t col = 0; col < inputs.size(); col++) {
+        assertClose(expected(inputs[col]), row[col], tolerance, what);
+        assertClose(row[col], view->getValue(0, col, 0), tolerance, what + " value at a time");
+    }
+}
+
+void testActivationViews() {
+    auto input = columnVector({0.f});
+    auto sigmoid = [](double x) { return 1.0 / (1.0 + std::exp(-x)); };
+    assertActivationMatches(TanhActivationFunction().activate(input), [](double x) { return std::tanh(x); },
+                            1e-6, "tanh");
+    assertActivationMatches(TanhActivationFunction().derivative(input), [](double x) {
+        return 1 - (std::tanh(x) * std::tanh(x));
+    }, 1e-6, "tanh derivative");
+    assertActivationMatches(TanhApproximationActivationFunction().activate(input),
+                            [](double x) { return std::tanh(x); }, 3e-6, "tanh approx");
+    assertActivationMatches(SigmoidActivationFunction().activate(input), sigmoid, 1e-6, "sigmoid");
+    assertActivationMatches(SigmoidActivationFunction().derivative(input), [&sigmoid](double x) {
+        return sigmoid(x) * (1 - sigmoid(x));
+    }, 1e-6, "sigmoid derivative");
+    assertActivationMatches(SigmoidApproximationActivationFunction().activate(input), [](double x) {
+        return 0.5 * ((x / (1.0 + std::fabs(x))) + 1);
+    }, 1e-6, "sigmoid approx");
+    assertActivationMatches(ReLUActivationFunction().activate(input), [](double x) { return std::max(x, 0.0); }, 0,
+                            "relu");
+    assertActivationMatches(LeakyReLUActivationFunction().derivative(input), [](double x) {
+        return x < 0 ? 0.01 : 1.0;
+    }, 1e-9, "leaky relu derivative");
+
+    // softmax sums to one, without overflowing on big values
+    auto wide = make_shared<FullTensor>(make_shared<TensorFromFunction>([](size_t row, size_t col, size_t channel) {
+        return (float) col * 10.f;
+    }, 1, 20, 1));
+    auto softmax = make_shared<FullTensor>(SoftmaxActivationFunction().activate(wide));
+    double total = 0;
+    for (size_t col = 0; col < 20; col++) {
+        total += softmax->getValue(0, col, 0);
+        assertClose(std::exp(((double) col - 19) * 10.0) / (1 + std::exp(-10.0)), softmax->getValue(0, col, 0),
+                    1e-6, "softmax");
+    }
+    assertClose(1.0, total, 1e-6, "softmax total");
+
+    // the simplifier sees through them
+    auto simplified = simplifyTensor(makeView<TensorActivationView<Relu>>(makeView<TensorNoOpView>(wide)));
+    if (dynamic_cast<TensorActivationView<Relu> *>(simplified.get()) == nullptr ||
+        dynamic_cast<TensorActivationView<Relu> *>(simplified.get())->getChild() != wide) {
+        throw exception("The simplifier didn't rewrite the child of an activation.");
+    }
+    cout << "testActivationViews passed" << endl;
+}
+
 int main() {
     try {
         testTanh();
         testTanhDerivative();
         testTanhApprox();
         testTanhApproxDerivative();
+        testFastMath();
+        testActivationViews();
     } catch (const exception &e) {
         cout << e.what() << endl;
     }
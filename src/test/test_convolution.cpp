@@ -184,6 +184,51 @@ void testConv2DComplexTanhBias() {
     ASSERT_TRUE(loss < 0.1);
 }
 
+// A dense layer after a convolution with more than one filter flattens every filter's channel into one row, and
+// has to split its error back up into those channels.
+void testConv2DFiltersIntoFull() {
+    auto conv2dDataSource = make_shared<InMemoryTrainingDataSet>();
+    // given input, expected result
+    conv2dDataSource->addTrainingData(randomTensor(8, 8, 1, 0.f, 1.f), columnVector({0.25f, 0.75f}));
+
+    auto neuralNetwork = neuralNetworkBuilder()
+            ->addInput(conv2dDataSource->getGivenShape(), 4, 3, convolution2dValid, tanhApprox)->setUseBias(false)
+            ->addOutput(conv2dDataSource->getExpectedShape(), sigmoidApprox)
+            ->build();
+    float loss = neuralNetwork->train(conv2dDataSource);
+    cout << "Loss: " << loss << endl;
+    ASSERT_TRUE(loss < 0.1);
+}
+
+// Both layouts work out the same thing: the same predictions, the same error to pass back, and the same
+// weight updates.
+void testConvolutionLayouts() {
+    auto learningState = make_shared<MBGDLearningState>();
+    learningState->learningRate = 0.1f;
+    learningState->biasLearningRate = 0.01f;
+    const vector<size_t> inputShape{12, 10, 3};
+    auto channelsFirst = make_shared<MBGDConvolution2dValidFunction>("first", inputShape, 4, 3, 32, learningState,
+                                                                     channelsFirstLayout);
+    auto channelsLast = make_shared<MBGDConvolution2dValidFunction>("last", inputShape, 4, 3, 32, learningState,
+                                                                    channelsLastLayout);
+    ASSERT_FALSE(channelsFirst->isChannelsLast());
+    ASSERT_TRUE(channelsLast->isChannelsLast());
+    // automatic only picks channels-last when there's more than one channel to sum over
+    ASSERT_TRUE(MBGDConvolution2dValidFunction("auto", inputShape, 4, 3, 32, learningState).isChannelsLast());
+    ASSERT_FALSE(MBGDConvolution2dValidFunction("auto", {12, 10, 1}, 1, 3, 32, learningState).isChannelsLast());
+
+    auto input = randomTensor(12, 10, 3, 0.f, 1.f);
+    for (size_t step = 0; step < 2; step++) {
+        auto firstOutput = channelsFirst->forward({input}, true);
+        auto lastOutput = channelsLast->forward({input}, true);
+        assertEqual(firstOutput, lastOutput);
+        auto outputError = randomTensor(10, 8, 4, -1.f, 1.f);
+        assertEqual(channelsFirst->backward(outputError), channelsLast->backward(outputError));
+    }
+    assertEqual(channelsFirst->forward({input}, false), channelsLast->forward({input}, false));
+    PASS_TEST();
+}
+
 int main() {
     try {
         testSimpleConv2DNoBias();
@@ -193,6 +238,8 @@ int main() {
         testConv2DComplexNoBias();
         testConv2DComplexBias();
         testConv2DComplexTanhBias();
+        testConv2DFiltersIntoFull();
+        testConvolutionLayouts();
     } catch (const exception &e) {
         cout << e.what() << endl;
     }
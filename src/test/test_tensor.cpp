@@ -7,6 +7,14 @@
 #include <string>
 #include "../types/tensor.hpp"
 #include "../util/tensor_utils.hpp"
+#include "../types/tensor_reductions.hpp"
+#include "../types/tensor_derived_cache.hpp"
+#include "../types/tensor_out_of_core.hpp"
+#include "../types/random_tensors.hpp"
+#include "../types/bit_tensors.hpp"
+#include "../types/sparse_tensors.hpp"
+#include "../types/channel_last_tensors.hpp"
+#include "../training_data/data_encoder.hpp"
 #include "../util/unit_test.hpp"
 #include "../util/tensor_stats.hpp"
 #include "../util/timers.hpp"
@@ -561,6 +569,1252 @@ void testFullSaveLoad() {
     remove(filename.c_str());
 }
 
+void testFullTensorContiguousLayout() {
+    vector<vector<vector<float>>> a = {{{1, 2, 3},
+                                        {4, 5, 6}},
+                                       {{7, 8, 9},
+                                        {10, 11, 12}}};
+    auto matrix = make_shared<FullTensor>(a);
+    ASSERT_TRUE(0 == ((uintptr_t) matrix->data()) % TENSOR_DATA_ALIGNMENT);
+    ASSERT_TRUE(3 == matrix->rowStride());
+    ASSERT_TRUE(6 == matrix->channelStride());
+    const float *values = matrix->data();
+    for (size_t channel = 0; channel < 2; channel++) {
+        for (size_t row = 0; row < 2; row++) {
+            for (size_t col = 0; col < 3; col++) {
+                ASSERT_TRUE(values[channel * matrix->channelStride() + row * matrix->rowStride() + col] ==
+                            matrix->getValue(row, col, channel));
+            }
+        }
+    }
+    auto quarter = make_shared<QuarterTensor>(matrix, 8);
+    ASSERT_TRUE(0 == ((uintptr_t) quarter->data()) % TENSOR_DATA_ALIGNMENT);
+    ASSERT_TRUE(quarterToFloat(quarter->data()[quarter->channelStride() + quarter->rowStride() + 2], 8) == 12.f);
+}
+
+// Every view answers the same question two ways: one value at a time, or a row (or tile) at a time.
+// Dot products and convolutions may sum in a different order, so we allow a small tolerance.
+void assertReadRowMatchesGetValue(const shared_ptr<BaseTensor> &tensor) {
+    const size_t rows = tensor->rowCount();
+    const size_t columns = tensor->columnCount();
+    const size_t channels = tensor->channelCount();
+    vector<float> values(columns);
+    for (size_t channel = 0; channel < channels; channel++) {
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t first = 0; first < columns; first += 2) {
+                const size_t count = columns - first;
+                tensor->readRow(row, channel, first, count, values.data());
+                for (size_t offset = 0; offset < count; offset++) {
+                    const float expected = tensor->getValue(row, first + offset, channel);
+                    ASSERT_TRUE(abs(expected - values[offset]) <= 0.0001f * std::max(1.0f, abs(expected)));
+                }
+            }
+        }
+    }
+    const size_t tileRows = rows > 1 ? rows - 1 : rows;
+    const size_t tileColumns = columns > 1 ? columns - 1 : columns;
+    const size_t stride = tileColumns + 3;
+    vector<float> tile(tileRows * stride);
+    for (size_t channel = 0; channel < channels; channel++) {
+        tensor->readTile(rows - tileRows, tileRows, columns - tileColumns, tileColumns, channel, tile.data(), stride);
+        for (size_t row = 0; row < tileRows; row++) {
+            for (size_t col = 0; col < tileColumns; col++) {
+                const float expected = tensor->getValue(rows - tileRows + row, columns - tileColumns + col, channel);
+                ASSERT_TRUE(abs(expected - tile[row * stride + col]) <= 0.0001f * std::max(1.0f, abs(expected)));
+            }
+        }
+    }
+}
+
+void testReadRowMatchesGetValue() {
+    auto a = make_shared<FullTensor>(make_shared<TensorFromRandom>(5, 7, 3, -1.f, 1.f, 42));
+    auto b = make_shared<FullTensor>(make_shared<TensorFromRandom>(5, 7, 3, -1.f, 1.f, 43));
+    auto c = make_shared<FullTensor>(make_shared<TensorFromRandom>(7, 4, 3, -1.f, 1.f, 44));
+    auto kernel = make_shared<FullTensor>(make_shared<TensorFromRandom>(3, 2, 3, -1.f, 1.f, 45));
+    auto wide = make_shared<FullTensor>(make_shared<TensorFromRandom>(40, 70, 1, -1.f, 1.f, 46));
+
+    assertReadRowMatchesGetValue(a);
+    assertReadRowMatchesGetValue(make_shared<QuarterTensor>(a, 4));
+    assertReadRowMatchesGetValue(make_shared<HalfTensor>(a));
+    assertReadRowMatchesGetValue(make_shared<PixelTensor>(a));
+    assertReadRowMatchesGetValue(make_shared<UniformTensor>(3, 4, 2, 0.5f));
+    assertReadRowMatchesGetValue(make_shared<TensorFromRandom>(3, 4, 2, -1.f, 1.f, 47));
+    assertReadRowMatchesGetValue(make_shared<TensorAddScalarView>(a, 0.5f));
+    assertReadRowMatchesGetValue(make_shared<TensorMultiplyByScalarView>(a, 0.5f));
+    assertReadRowMatchesGetValue(make_shared<TensorAddTensorView>(a, b));
+    assertReadRowMatchesGetValue(make_shared<TensorMinusTensorView>(a, b));
+    assertReadRowMatchesGetValue(make_shared<TensorMultiplyTensorView>(a, b));
+    assertReadRowMatchesGetValue(make_shared<TensorDotTensorView>(a, c));
+    assertReadRowMatchesGetValue(make_shared<TensorReshapeView>(a, 7, 5));
+    assertReadRowMatchesGetValue(make_shared<TensorFlattenToRowView>(a));
+    assertReadRowMatchesGetValue(make_shared<TensorFlattenToColumnView>(a));
+    assertReadRowMatchesGetValue(make_shared<TensorTransposeView>(a));
+    assertReadRowMatchesGetValue(make_shared<TensorTransposeView>(wide));
+    assertReadRowMatchesGetValue(make_shared<TensorRotate180View>(a));
+    assertReadRowMatchesGetValue(make_shared<TensorSumChannelsView>(a));
+    assertReadRowMatchesGetValue(make_shared<TensorSumToChannelView>(a, 1, 3));
+    assertReadRowMatchesGetValue(make_shared<TensorChannelToTensorView>(a, 2));
+    assertReadRowMatchesGetValue(make_shared<TensorZeroPaddedView>(a, 1, 2, 3, 1));
+    assertReadRowMatchesGetValue(make_shared<TensorValidCrossCorrelation2dView>(a, kernel));
+    assertReadRowMatchesGetValue(make_shared<TensorFullConvolve2dView>(a, kernel));
+    assertReadRowMatchesGetValue(make_shared<TensorPowerView>(make_shared<TensorAddScalarView>(a, 2.f), 2.f));
+    assertReadRowMatchesGetValue(make_shared<TensorLogView>(make_shared<TensorAddScalarView>(a, 2.f)));
+    assertReadRowMatchesGetValue(make_shared<TensorValueTransformView>(a, [](float v) { return v * v; }));
+
+    auto full = make_shared<FullTensor>(make_shared<TensorDotTensorView>(a, c));
+    auto expected = make_shared<TensorDotTensorView>(a, c);
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t row = 0; row < 5; row++) {
+            for (size_t col = 0; col < 4; col++) {
+                ASSERT_TRUE(abs(full->getValue(row, col, channel) - expected->getValue(row, col, channel)) < 0.0001f);
+            }
+        }
+    }
+}
+
+void assertDotMatchesNaive(const shared_ptr<BaseTensor> &left, const shared_ptr<BaseTensor> &right) {
+    auto product = make_shared<FullTensor>(make_shared<TensorDotTensorView>(left, right));
+    const size_t inner = left->columnCount();
+    for (size_t channel = 0; channel < product->channelCount(); channel++) {
+        for (size_t row = 0; row < product->rowCount(); row++) {
+            for (size_t col = 0; col < product->columnCount(); col++) {
+                double expected = 0;
+                for (size_t k = 0; k < inner; k++) {
+                    expected += (double) left->getValue(row, k, channel) * (double) right->getValue(k, col, channel);
+                }
+                ASSERT_TRUE(abs(expected - product->getValue(row, col, channel)) < 0.001);
+            }
+        }
+    }
+}
+
+void testDotTensorGemm() {
+    // big enough to cover several blocks, partial micro-kernel tiles, and more than one pass over k
+    auto a = make_shared<FullTensor>(make_shared<TensorFromRandom>(131, 301, 1, -1.f, 1.f, 42));
+    auto b = make_shared<FullTensor>(make_shared<TensorFromRandom>(301, 75, 1, -1.f, 1.f, 43));
+    assertDotMatchesNaive(a, b);
+    // transposed operands are read in place with swapped strides
+    auto bt = make_shared<FullTensor>(make_shared<TensorFromRandom>(75, 301, 1, -1.f, 1.f, 44));
+    assertDotMatchesNaive(a, make_shared<TensorTransposeView>(bt));
+    auto at = make_shared<FullTensor>(make_shared<TensorFromRandom>(301, 131, 1, -1.f, 1.f, 45));
+    assertDotMatchesNaive(make_shared<TensorTransposeView>(at), b);
+    // a single row, like a dense layer seeing one example at a time, takes the streaming path
+    auto row = make_shared<FullTensor>(make_shared<TensorFromRandom>(1, 301, 1, -1.f, 1.f, 46));
+    assertDotMatchesNaive(row, b);
+    assertDotMatchesNaive(row, make_shared<TensorTransposeView>(bt));
+    // an outer product has k == 1
+    assertDotMatchesNaive(make_shared<TensorTransposeView>(row), row);
+    // children that aren't in memory get read into a buffer first
+    assertDotMatchesNaive(make_shared<TensorAddScalarView>(a, 1.f), make_shared<TensorMultiplyByScalarView>(b, 2.f));
+    // several channels
+    auto c = make_shared<FullTensor>(make_shared<TensorFromRandom>(9, 20, 3, -1.f, 1.f, 47));
+    auto d = make_shared<FullTensor>(make_shared<TensorFromRandom>(20, 11, 3, -1.f, 1.f, 48));
+    assertDotMatchesNaive(c, d);
+}
+
+void testFusedTensorEvaluator() {
+    auto weights = make_shared<FullTensor>(make_shared<TensorFromRandom>(40, 1500, 2, -1.f, 1.f, 42));
+    auto input = make_shared<FullTensor>(make_shared<TensorFromRandom>(3, 40, 2, -1.f, 1.f, 43));
+    auto error = make_shared<FullTensor>(make_shared<TensorFromRandom>(3, 1500, 2, -1.f, 1.f, 44));
+    auto gradient = make_shared<TensorDotTensorView>(make_shared<TensorTransposeView>(input), error);
+    shared_ptr<BaseTensor> tree = make_shared<TensorMinusTensorView>(
+            weights, make_shared<TensorMultiplyByScalarView>(gradient, 0.1f));
+    tree = make_shared<TensorAddTensorView>(make_shared<TensorAddScalarView>(tree, 0.5f),
+                                            make_shared<TensorMultiplyTensorView>(weights, weights));
+    tree = make_shared<TensorValueTransformView>(tree, [](float v) { return v > 0 ? v : 0.f; });
+
+    FusedTensorEvaluator evaluator(tree);
+    // weights (twice) and weights are streamed, only the dot product is a tile boundary
+    ASSERT_TRUE(1 == evaluator.boundaryCount());
+    ASSERT_TRUE(10 == evaluator.stepCount());
+
+    const size_t rows = tree->rowCount();
+    const size_t columns = tree->columnCount();
+    vector<float> fused(rows * columns);
+    for (size_t channel = 0; channel < tree->channelCount(); channel++) {
+        evaluator.readTile(0, rows, 0, columns, channel, fused.data(), columns);
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t col = 0; col < columns; col++) {
+                ASSERT_TRUE(abs(fused[row * columns + col] - tree->getValue(row, col, channel)) < 0.0001f);
+            }
+        }
+    }
+    // and materializing the tree goes through the same evaluator
+    auto materialized = make_shared<FullTensor>(tree);
+    auto half = make_shared<HalfTensor>(tree);
+    for (size_t row = 0; row < rows; row += 7) {
+        for (size_t col = 0; col < columns; col += 13) {
+            ASSERT_TRUE(abs(materialized->getValue(row, col, 1) - tree->getValue(row, col, 1)) < 0.0001f);
+            const float expected = tree->getValue(row, col, 1);
+            ASSERT_TRUE(abs(half->getValue(row, col, 1) - expected) <= 0.01f * std::max(1.f, abs(expected)));
+        }
+    }
+}
+
+void testParallelMaterialization() {
+    // big enough to be split across threads: by rows for most views, and by columns for a transpose
+    auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(300, 400, 2, -1.f, 1.f, 42));
+    vector<shared_ptr<BaseTensor>> views = {make_shared<TensorAddScalarView>(source, 1.f),
+                                            make_shared<TensorTransposeView>(source),
+                                            make_shared<TensorFlattenToRowView>(source)};
+    for (const auto &view: views) {
+        auto full = make_shared<FullTensor>(view);
+        auto pixel = make_shared<PixelTensor>(make_shared<TensorMultiplyByScalarView>(view, 0.25f));
+        for (size_t channel = 0; channel < view->channelCount(); channel++) {
+            for (size_t row = 0; row < view->rowCount(); row += 3) {
+                for (size_t col = 0; col < view->columnCount(); col += 7) {
+                    const float expected = view->getValue(row, col, channel);
+                    ASSERT_TRUE(full->getValue(row, col, channel) == expected);
+                    const float expected_pixel = std::max(0.f, std::min(expected * 0.25f, 1.f));
+                    ASSERT_TRUE(abs(pixel->getValue(row, col, channel) - expected_pixel) <= 1.f / 255.f);
+                }
+            }
+        }
+    }
+}
+
+void testStatsAndReductions() {
+    // big enough to be reduced on several threads
+    auto matrixFunc = [](size_t row, size_t col, size_t channel) {
+        return ((float) ((row * 31 + col * 17 + channel * 7) % 1000)) / 100.f - 5.f;
+    };
+    auto matrix = make_shared<TensorFromFunction>(matrixFunc, 700, 500, 3);
+    double expectedSum = 0;
+    float expectedMin = INFINITY;
+    float expectedMax = -INFINITY;
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t row = 0; row < 700; row++) {
+            for (size_t col = 0; col < 500; col++) {
+                const float val = matrixFunc(row, col, channel);
+                expectedSum += val;
+                expectedMin = std::min(expectedMin, val);
+                expectedMax = std::max(expectedMax, val);
+            }
+        }
+    }
+    auto summary = matrix->stats();
+    ASSERT_TRUE(summary.count == 700 * 500 * 3);
+    ASSERT_TRUE(summary.min == expectedMin);
+    ASSERT_TRUE(summary.max == expectedMax);
+    ASSERT_TRUE(abs(summary.sum - expectedSum) < 0.01);
+    ASSERT_TRUE(abs(summary.mean - expectedSum / (700 * 500 * 3)) < 0.0000001);
+    ASSERT_TRUE(abs(matrix->sum() - expectedSum) < 0.01);
+    ASSERT_TRUE(matrix->min() == expectedMin);
+    ASSERT_TRUE(matrix->max() == expectedMax);
+    ASSERT_TRUE(abs(matrix->arithmeticMean() - (float) (expectedSum / (700 * 500 * 3))) < 0.00001f);
+
+    // a float running total would lose every one of the small values
+    auto mixed = make_shared<TensorFromFunction>([](size_t row, size_t col, size_t channel) {
+        return row == 0 && col == 0 ? 100000000.f : 1.f;
+    }, 1000, 1000, 1);
+    ASSERT_TRUE(100000000.0 + 999999.0 == mixed->sum());
+
+    // geometric mean of a big positive tensor, and of one with a single zero hidden in it
+    auto ones = make_shared<UniformTensor>(800, 800, 1, 2.f);
+    ASSERT_TRUE(roughlyEqual(2.f, ones->geometricMean()));
+    auto withZero = make_shared<TensorFromFunction>([](size_t row, size_t col, size_t channel) {
+        return row == 799 && col == 5 ? 0.f : 1.f;
+    }, 800, 800, 1);
+    ASSERT_TRUE(isnan(withZero->geometricMean()));
+}
+
+void testMappedTensor() {
+    // each encoding gets its own file, since windows won't let us overwrite a file that is still mapped.
+    vector<string> filenames = {"unit_test_mapped_full.tensor", "unit_test_mapped_half.tensor",
+                                "unit_test_mapped_quarter.tensor", "unit_test_mapped_writable.tensor"};
+    try {
+        auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(20, 30, 3, -2.f, 2.f, 42));
+
+        saveMappedTensor(source, filenames[0]);
+        ASSERT_TRUE(isMappedTensorFile(filenames[0]));
+        auto mapped = make_shared<MappedFullTensor>(filenames[0]);
+        assertEqual(source, mapped);
+        ASSERT_TRUE(mapped->isMaterialized());
+        // dot products read the mapping directly
+        assertDotMatchesNaive(make_shared<TensorTransposeView>(mapped), source);
+        // loading through the usual function maps the file rather than reading it
+        ASSERT_TRUE(dynamic_pointer_cast<MappedFullTensor>(loadTensor(filenames[0], 32)) != nullptr);
+
+        saveMappedTensor(source, filenames[1], MappedTensorEncoding::half16);
+        assertEqual(make_shared<HalfTensor>(source), loadMappedTensor(filenames[1]));
+
+        saveMappedTensor(source, filenames[2], MappedTensorEncoding::quarter8, 8);
+        auto quarter = loadMappedTensor(filenames[2]);
+        ASSERT_TRUE(dynamic_pointer_cast<MappedQuarterTensor>(quarter)->getBias() == 8);
+        assertEqual(make_shared<QuarterTensor>(source, 8), quarter);
+
+        // a writable mapping takes updates and survives being reopened
+        saveMappedTensor(source, filenames[3]);
+        {
+            auto writable = make_shared<MappedFullTensor>(filenames[3], true, MappedAccess::random);
+            writable->copyFrom(make_shared<TensorMultiplyByScalarView>(source, 2.f));
+            writable->setValue(1, 2, 1, 123.f);
+            writable->flush();
+        }
+        auto reopened = make_shared<MappedFullTensor>(filenames[3], false, MappedAccess::sequential);
+        ASSERT_TRUE(reopened->getValue(1, 2, 1) == 123.f);
+        ASSERT_TRUE(reopened->getValue(3, 4, 2) == source->getValue(3, 4, 2) * 2.f);
+        bool threw = false;
+        try {
+            reopened->setValue(0, 0, 0, 1.f);
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        for (const auto &filename: filenames) {
+            remove(filename.c_str());
+        }
+        FAIL_TEST(e);
+    }
+    for (const auto &filename: filenames) {
+        remove(filename.c_str());
+    }
+}
+
+void testTensorArena() {
+    try {
+        ASSERT_TRUE(TensorArena::sizeClass(1) == 64);
+        ASSERT_TRUE(TensorArena::sizeClass(100) == 112);
+        ASSERT_TRUE(TensorArena::sizeClass(4096) == 4096);
+        ASSERT_TRUE(TensorArena::sizeClass(4097) == 5120);
+
+        auto &arena = TensorArena::instance();
+        auto weights = make_shared<FullTensor>(make_shared<TensorFromRandom>(64, 32, 1, -1.f, 1.f, 42));
+        auto inputs = make_shared<FullTensor>(make_shared<TensorFromRandom>(16, 64, 1, -1.f, 1.f, 43));
+        auto truth = make_shared<FullTensor>(make_shared<TensorFromRandom>(16, 32, 1, -1.f, 1.f, 44));
+        // roughly what a dense layer does each batch
+        auto step = [&weights, &inputs, &truth]() {
+            auto prediction = make_shared<FullTensor>(make_shared<TensorDotTensorView>(inputs, weights));
+            auto error = make_shared<FullTensor>(make_shared<TensorMinusTensorView>(prediction, truth));
+            auto gradient = make_shared<TensorDotTensorView>(make_shared<TensorTransposeView>(inputs), error);
+            weights = make_shared<FullTensor>(
+                    make_shared<TensorMinusTensorView>(weights,
+                                                       make_shared<TensorMultiplyByScalarView>(gradient, 0.01f)));
+            TensorArena::instance().endBatch();
+        };
+        for (int warm_up = 0; warm_up < 3; warm_up++) {
+            step();
+        }
+        const size_t system_allocations = arena.getCounters().systemAllocations;
+        for (int batch = 0; batch < 5; batch++) {
+            step();
+        }
+        const auto counters = arena.getCounters();
+        ASSERT_TRUE(counters.systemAllocations == system_allocations);
+        ASSERT_TRUE(counters.lastBatchSystemAllocations == 0);
+        ASSERT_TRUE(counters.reusedAllocations > 0);
+
+        arena.trim();
+        ASSERT_TRUE(arena.cachedBytes() == 0);
+        // tensors that are still alive keep their blocks
+        ASSERT_TRUE(arena.getCounters().liveBytes >= weights->size() * sizeof(float));
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testPooledViews() {
+    try {
+        auto input = make_shared<FullTensor>(make_shared<TensorFromRandom>(8, 8, 2, -1.f, 1.f, 42));
+        auto kernel = make_shared<FullTensor>(make_shared<TensorFromRandom>(3, 3, 2, -1.f, 1.f, 43));
+        // roughly the graph a convolution layer builds for one sample
+        auto build = [&input, &kernel]() {
+            shared_ptr<BaseTensor> result = nullptr;
+            for (size_t channel = 0; channel < 2; channel++) {
+                shared_ptr<BaseTensor> correlation = makeView<TensorValidCrossCorrelation2dView>(
+                        makeView<TensorChannelToTensorView>(input, channel),
+                        makeView<TensorChannelToTensorView>(kernel, channel));
+                result = result ? makeView<TensorAddTensorView>(result, correlation) : correlation;
+            }
+            return makeView<TensorSumToChannelView>(result, 0, 1);
+        };
+        const double expected = build()->sum();
+        for (int warm_up = 0; warm_up < 3; warm_up++) {
+            build();
+        }
+        const size_t fresh = ThreadLocalBlockPool::freshAllocations();
+        const size_t reused = ThreadLocalBlockPool::reusedAllocations();
+        for (int sample = 0; sample < 10; sample++) {
+            ASSERT_TRUE(build()->sum() == expected);
+        }
+        ASSERT_TRUE(ThreadLocalBlockPool::freshAllocations() == fresh);
+        ASSERT_TRUE(ThreadLocalBlockPool::reusedAllocations() > reused);
+
+        // views from the pool are still ordinary shared pointers
+        shared_ptr<BaseTensor> view = makeView<TensorMultiplyByScalarView>(input, 2.f);
+        weak_ptr<BaseTensor> watcher = view;
+        ASSERT_TRUE(view.use_count() == 1);
+        ASSERT_TRUE(view->getValue(1, 2, 1) == input->getValue(1, 2, 1) * 2.f);
+        view = nullptr;
+        ASSERT_TRUE(watcher.expired());
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testCachedView() {
+    try {
+        auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(100, 130, 2, -1.f, 1.f, 42));
+        size_t computed = 0;
+        auto counted = make_shared<TensorValueTransformView>(source, [&computed](float value) {
+            computed++;
+            return value * 3.f;
+        });
+        auto cached = make_shared<TensorCachedView>(counted);
+        bool matches = true;
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t channel = 0; channel < 2; channel++) {
+                for (size_t row = 0; row < 100; row++) {
+                    for (size_t column = 0; column < 130; column++) {
+                        matches &= cached->getValue(row, column, channel) ==
+                                   source->getValue(row, column, channel) * 3.f;
+                    }
+                }
+            }
+        }
+        ASSERT_TRUE(matches);
+        // every value was worked out exactly once, no matter how many times we read it
+        ASSERT_TRUE(computed == source->size());
+        ASSERT_TRUE(cached->tileLoadCount() == 2 * 2 * 3);
+
+        // with room for a single tile, we keep throwing tiles out, but the values are still right
+        auto tight = make_shared<TensorCachedView>(counted, 64 * 64 * sizeof(float));
+        assertEqual(cached, tight);
+        ASSERT_TRUE(tight->cachedTileCount() == 1);
+
+        // dot products put a cache in front of views they would otherwise recompute
+        auto dot = make_shared<TensorDotTensorView>(make_shared<TensorTransposeView>(counted), source);
+        ASSERT_TRUE(dynamic_pointer_cast<TensorCachedView>(dot->getChild1()) != nullptr);
+        ASSERT_TRUE(dot->getChild2() == source);
+        assertDotMatchesNaive(make_shared<TensorTransposeView>(counted), source);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testDenseTensorCodecs() {
+    try {
+        auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(17, 23, 2, 0.f, 1.f, 42));
+        // converting one dense tensor to another takes the direct path, a view takes the tiled path,
+        // and both should give the same values.
+        assertEqual(make_shared<HalfTensor>(source), make_shared<HalfTensor>(make_shared<TensorNoOpView>(source)));
+        assertEqual(make_shared<PixelTensor>(source), make_shared<PixelTensor>(make_shared<TensorNoOpView>(source)));
+        assertEqual(make_shared<QuarterTensor>(source, 14),
+                    make_shared<QuarterTensor>(make_shared<TensorNoOpView>(source), 14));
+        auto eight_bit = make_shared<QuarterTensor>(source, 14);
+        ASSERT_TRUE(eight_bit->get_bias() == 14);
+        assertEqual(eight_bit, make_shared<QuarterTensor>(eight_bit, 14));
+        assertEqual(eight_bit, make_shared<FullTensor>(eight_bit));
+
+        size_t visited_bytes = 0;
+        ASSERT_TRUE(visitDenseTensor(eight_bit, [&visited_bytes](auto &dense) {
+            visited_bytes = sizeof(*dense.data());
+        }));
+        ASSERT_TRUE(visited_bytes == sizeof(quarter));
+        ASSERT_TRUE(!visitDenseTensor(make_shared<TensorNoOpView>(source), [](auto &dense) {}));
+
+        // files always hold floats
+        const string filename = "unit_test_dense_codecs.tensor";
+        source->save(filename);
+        assertEqual(make_shared<PixelTensor>(source), make_shared<PixelTensor>(filename));
+        assertEqual(make_shared<HalfTensor>(source), make_shared<HalfTensor>(filename));
+        remove(filename.c_str());
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testStridedViews() {
+    try {
+        auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(6, 10, 3, 0.f, 1.f, 42));
+        // a no-op over a view that doesn't live in memory hides the buffer, so these take the old paths.
+        auto hidden = make_shared<TensorNoOpView>(make_shared<TensorAddScalarView>(source, 0.f));
+        TensorBufferLayout source_layout;
+        ASSERT_TRUE(source->bufferLayout(source_layout));
+
+        auto reshape = make_shared<TensorReshapeView>(source, 5, 12);
+        auto flat_row = make_shared<TensorFlattenToRowView>(source);
+        auto flat_column = make_shared<TensorFlattenToColumnView>(source);
+        auto transpose = make_shared<TensorTransposeView>(source);
+        auto channel = make_shared<TensorChannelToTensorView>(source, 2);
+        auto slice = make_shared<TensorSliceView>(source, 1, 4, 3, 5, 1, 2);
+        ASSERT_TRUE(reshape->isStrided() && flat_row->isStrided() && flat_column->isStrided());
+        ASSERT_TRUE(transpose->isStrided() && channel->isStrided() && slice->isStrided());
+        ASSERT_TRUE(!make_shared<TensorReshapeView>(hidden, 5, 12)->isStrided());
+
+        assertEqual(reshape, make_shared<TensorReshapeView>(hidden, 5, 12));
+        assertEqual(flat_row, make_shared<TensorFlattenToRowView>(hidden));
+        assertEqual(flat_column, make_shared<TensorFlattenToColumnView>(hidden));
+        assertEqual(transpose, make_shared<TensorTransposeView>(hidden));
+        assertEqual(channel, make_shared<TensorChannelToTensorView>(hidden, 2));
+        assertEqual(slice, make_shared<TensorSliceView>(hidden, 1, 4, 3, 5, 1, 2));
+        assertReadRowMatchesGetValue(slice);
+        assertReadRowMatchesGetValue(make_shared<TensorSliceView>(hidden, 1, 4, 3, 5, 1, 2));
+
+        // views of views still point straight into the source's memory.
+        TensorBufferLayout layout;
+        auto sliced_transpose = make_shared<TensorSliceView>(transpose, 2, 3, 1, 4, 0, 3);
+        ASSERT_TRUE(sliced_transpose->bufferLayout(layout));
+        ASSERT_TRUE(layout.data == source_layout.data + (1 * source_layout.rowStride) +
+                                   (2 * source_layout.columnStride));
+        assertEqual(sliced_transpose, make_shared<TensorSliceView>(make_shared<TensorTransposeView>(hidden),
+                                                                   2, 3, 1, 4, 0, 3));
+        // a transposed channel isn't one even run of values, so flattening it reads through the child.
+        auto stacked = make_shared<TensorFlattenToRowView>(make_shared<TensorTransposeView>(channel));
+        ASSERT_TRUE(!stacked->isStrided());
+        assertEqual(stacked, make_shared<TensorFlattenToRowView>(
+                make_shared<TensorTransposeView>(make_shared<TensorChannelToTensorView>(hidden, 2))));
+
+        bool slices_match = true;
+        auto rows = sliceRows(source, 2, 3);
+        auto columns = sliceColumns(source, 4, 6);
+        auto channels = sliceChannels(source, 1, 2);
+        for (size_t c = 0; c < 3; c++) {
+            for (size_t r = 0; r < 6; r++) {
+                for (size_t col = 0; col < 10; col++) {
+                    const float expected = source->getValue(r, col, c);
+                    if (r >= 2 && r < 5) {
+                        slices_match &= rows->getValue(r - 2, col, c) == expected;
+                    }
+                    if (col >= 4) {
+                        slices_match &= columns->getValue(r, col - 4, c) == expected;
+                    }
+                    if (c >= 1) {
+                        slices_match &= channels->getValue(r, col, c - 1) == expected;
+                    }
+                }
+            }
+        }
+        ASSERT_TRUE(slices_match);
+
+        bool threw = false;
+        try {
+            sliceRows(source, 4, 3);
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testSimplifyViews() {
+    try {
+        auto a = make_shared<FullTensor>(make_shared<TensorFromRandom>(9, 7, 1, -1.f, 1.f, 42));
+        auto b = make_shared<FullTensor>(make_shared<TensorFromRandom>(7, 5, 1, -1.f, 1.f, 7));
+        auto ones = make_shared<UniformTensor>(9, 7, 1, 1.f);
+        auto zeros = make_shared<UniformTensor>(9, 7, 1, 0.f);
+
+        TensorSimplifier simplifier;
+        auto scaled = makeView<TensorNoOpView>(
+                makeView<TensorMultiplyByScalarView>(makeView<TensorMultiplyByScalarView>(a, 2.f), 3.f));
+        auto simplified_scale = simplifier.simplify(scaled);
+        auto scale_view = dynamic_pointer_cast<TensorMultiplyByScalarView>(simplified_scale);
+        ASSERT_TRUE(scale_view != nullptr && scale_view->get_scale() == 6.f && scale_view->getChild() == a);
+        ASSERT_TRUE(simplifier.removedNodes() == 2);
+        assertEqual(scaled, simplified_scale);
+
+        ASSERT_TRUE(simplifyTensor(makeView<TensorMultiplyTensorView>(a, ones)) == a);
+        ASSERT_TRUE(simplifyTensor(makeView<TensorMultiplyTensorView>(ones, a)) == a);
+        ASSERT_TRUE(simplifyTensor(makeView<TensorAddTensorView>(a, zeros)) == a);
+        ASSERT_TRUE(simplifyTensor(makeView<TensorMinusTensorView>(a, zeros)) == a);
+        ASSERT_TRUE(simplifyTensor(makeView<TensorAddScalarView>(a, 0.f)) == a);
+        ASSERT_TRUE(simplifyTensor(makeView<TensorTransposeView>(makeView<TensorTransposeView>(a))) == a);
+        auto negated = makeView<TensorMinusTensorView>(zeros, a);
+        assertEqual(negated, simplifyTensor(negated));
+        auto square = make_shared<FullTensor>(make_shared<TensorFromRandom>(7, 7, 1, -1.f, 1.f, 3));
+        auto triple_transpose = makeView<TensorTransposeView>(
+                makeView<TensorTransposeView>(makeView<TensorTransposeView>(square)));
+        assertEqual(triple_transpose, simplifyTensor(triple_transpose));
+        // a graph with nothing to take out comes back as it went in.
+        auto plain = makeView<TensorAddTensorView>(a, makeView<TensorMultiplyByScalarView>(a, 2.f));
+        ASSERT_TRUE(simplifyTensor(plain) == plain);
+
+        // scalars on either side of a dot product, or on its result, end up as its alpha
+        auto dot = makeView<TensorMultiplyByScalarView>(
+                makeView<TensorDotTensorView>(makeView<TensorMultiplyByScalarView>(a, 2.f),
+                                              makeView<TensorMultiplyByScalarView>(b, 3.f)), 0.5f);
+        auto simplified_dot = dynamic_pointer_cast<TensorDotTensorView>(simplifyTensor(dot));
+        ASSERT_TRUE(simplified_dot != nullptr && simplified_dot->get_alpha() == 3.f);
+        ASSERT_TRUE(simplified_dot->getChild1() == a && simplified_dot->getChild2() == b);
+        assertEqual(dot, simplified_dot);
+        assertEqual(make_shared<FullTensor>(dot), make_shared<FullTensor>(simplified_dot));
+
+        // what a linear layer's backward pass builds: the derivative is all ones and the bias starts at zero
+        auto error = makeView<TensorMultiplyTensorView>(ones, makeView<TensorAddTensorView>(a, zeros));
+        auto before = TensorSimplifier::getCounters();
+        auto materialized = materializeTensor(error);
+        auto after = TensorSimplifier::getCounters();
+        ASSERT_TRUE(after.passes == before.passes + 1);
+        ASSERT_TRUE(after.removedNodes == before.removedNodes + 4);
+        assertEqual(error, materialized);
+        auto averaged = materializeTensor(makeView<TensorMultiplyByScalarView>(
+                makeView<TensorAddTensorView>(ones, ones), 0.5f));
+        ASSERT_TRUE(dynamic_pointer_cast<UniformTensor>(averaged) != nullptr);
+        ASSERT_TRUE(averaged->getValue(3, 4, 0) == 1.f);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testConcatViews() {
+    try {
+        auto a = make_shared<FullTensor>(make_shared<TensorFromRandom>(5, 6, 2, -1.f, 1.f, 42));
+        auto b = make_shared<FullTensor>(make_shared<TensorFromRandom>(5, 6, 1, -1.f, 1.f, 7));
+        auto c = make_shared<FullTensor>(make_shared<TensorFromRandom>(5, 4, 2, -1.f, 1.f, 3));
+
+        // the add chain the convolution layer used to build
+        auto channels = makeView<TensorConcatChannelsView>(vector<shared_ptr<BaseTensor>>{a, b});
+        ASSERT_TRUE(channels->channelCount() == 3);
+        auto first = makeView<TensorSumToChannelView>(makeView<TensorChannelToTensorView>(a, 0), 0, 3);
+        auto second = makeView<TensorSumToChannelView>(makeView<TensorChannelToTensorView>(a, 1), 1, 3);
+        auto summed = makeView<TensorAddTensorView>(makeView<TensorAddTensorView>(first, second),
+                                                    makeView<TensorSumToChannelView>(b, 2, 3));
+        assertEqual(summed, channels);
+        assertReadRowMatchesGetValue(channels);
+        assertEqual(summed, make_shared<FullTensor>(channels));
+
+        auto columns = makeView<TensorConcatColumnsView>(vector<shared_ptr<BaseTensor>>{a, c, a});
+        ASSERT_TRUE(columns->columnCount() == 16 && columns->channelCount() == 2);
+        bool columns_match = true;
+        for (size_t channel = 0; channel < 2; channel++) {
+            for (size_t row = 0; row < 5; row++) {
+                for (size_t column = 0; column < 16; column++) {
+                    const float expected = column < 6 ? a->getValue(row, column, channel)
+                                                      : column < 10 ? c->getValue(row, column - 6, channel)
+                                                                    : a->getValue(row, column - 10, channel);
+                    columns_match &= columns->getValue(row, column, channel) == expected;
+                }
+            }
+        }
+        ASSERT_TRUE(columns_match);
+        assertReadRowMatchesGetValue(columns);
+        assertEqual(columns, make_shared<FullTensor>(columns));
+        ASSERT_TRUE(columns->contains(c) && !columns->contains(b));
+
+        bool threw = false;
+        try {
+            makeView<TensorConcatChannelsView>(vector<shared_ptr<BaseTensor>>{a, c});
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void assertAxisReductionsMatch(const shared_ptr<BaseTensor> &tensor) {
+    const size_t rows = tensor->rowCount();
+    const size_t columns = tensor->columnCount();
+    const size_t channels = tensor->channelCount();
+    auto row_sums = sumAlongAxis(tensor, TensorAxis::rows);
+    auto row_means = meanAlongAxis(tensor, TensorAxis::rows);
+    auto row_maxes = maxAlongAxis(tensor, TensorAxis::rows);
+    auto column_sums = sumAlongAxis(tensor, TensorAxis::columns);
+    auto column_maxes = maxAlongAxis(tensor, TensorAxis::columns);
+    auto channel_sums = sumAlongAxis(tensor, TensorAxis::channels);
+    auto channel_means = meanAlongAxis(tensor, TensorAxis::channels);
+    auto channel_maxes = maxAlongAxis(tensor, TensorAxis::channels);
+    ASSERT_TRUE(row_sums->rowCount() == 1 && row_sums->columnCount() == columns &&
+                row_sums->channelCount() == channels);
+    ASSERT_TRUE(column_sums->rowCount() == rows && column_sums->columnCount() == 1 &&
+                column_sums->channelCount() == channels);
+    ASSERT_TRUE(channel_sums->rowCount() == rows && channel_sums->columnCount() == columns &&
+                channel_sums->channelCount() == 1);
+    auto close = [](double expected, float actual) {
+        return abs(expected - actual) <= 0.0001 * std::max(1.0, abs(expected));
+    };
+    bool matches = true;
+    for (size_t channel = 0; channel < channels; channel++) {
+        for (size_t column = 0; column < columns; column++) {
+            double sum = 0;
+            float largest = -INFINITY;
+            for (size_t row = 0; row < rows; row++) {
+                sum += tensor->getValue(row, column, channel);
+                largest = std::max(largest, tensor->getValue(row, column, channel));
+            }
+            matches &= close(sum, row_sums->getValue(0, column, channel));
+            matches &= close(sum / (double) rows, row_means->getValue(0, column, channel));
+            matches &= largest == row_maxes->getValue(0, column, channel);
+        }
+        for (size_t row = 0; row < rows; row++) {
+            double sum = 0;
+            float largest = -INFINITY;
+            for (size_t column = 0; column < columns; column++) {
+                sum += tensor->getValue(row, column, channel);
+                largest = std::max(largest, tensor->getValue(row, column, channel));
+            }
+            matches &= close(sum, column_sums->getValue(row, 0, channel));
+            matches &= largest == column_maxes->getValue(row, 0, channel);
+        }
+    }
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t column = 0; column < columns; column++) {
+            double sum = 0;
+            float largest = -INFINITY;
+            for (size_t channel = 0; channel < channels; channel++) {
+                sum += tensor->getValue(row, column, channel);
+                largest = std::max(largest, tensor->getValue(row, column, channel));
+            }
+            matches &= close(sum, channel_sums->getValue(row, column, 0));
+            matches &= close(sum / (double) channels, channel_means->getValue(row, column, 0));
+            matches &= largest == channel_maxes->getValue(row, column, 0);
+        }
+    }
+    ASSERT_TRUE(matches);
+}
+
+void testAxisReductions() {
+    try {
+        assertAxisReductionsMatch(make_shared<FullTensor>(make_shared<TensorFromRandom>(7, 11, 3, -1.f, 1.f, 42)));
+        assertAxisReductionsMatch(make_shared<TensorFromRandom>(1, 9, 1, -1.f, 1.f, 42));
+        // big enough to be split across threads, and read through a view
+        assertAxisReductionsMatch(makeView<TensorAddScalarView>(
+                make_shared<FullTensor>(make_shared<TensorFromRandom>(301, 299, 3, -1.f, 1.f, 7)), 0.5f));
+
+        auto first = make_shared<FullTensor>(make_shared<TensorFromRandom>(4, 5, 2, -1.f, 1.f, 1));
+        auto second = make_shared<FullTensor>(make_shared<TensorFromRandom>(4, 5, 2, -1.f, 1.f, 2));
+        auto third = make_shared<FullTensor>(make_shared<TensorFromRandom>(4, 5, 2, -1.f, 1.f, 3));
+        auto expected = makeView<TensorMultiplyByScalarView>(
+                makeView<TensorAddTensorView>(makeView<TensorAddTensorView>(first, second), third), 1.f / 3.f);
+        assertEqual(expected, averageTensors({first, second, third}));
+
+        bool threw = false;
+        try {
+            reduceAlongAxis(first, TensorAxis::channels, AxisReduction::sum, 3);
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+// Checks a broadcasting view against the value we'd get by looking up each child with its repeated dimensions
+// pinned to zero.
+void assertBroadcastMatches(const shared_ptr<BaseTensor> &view, const shared_ptr<BaseTensor> &left,
+                            const shared_ptr<BaseTensor> &right, const function<float(float, float)> &operation) {
+    bool values_match = true;
+    for (size_t channel = 0; channel < view->channelCount(); channel++) {
+        for (size_t row = 0; row < view->rowCount(); row++) {
+            for (size_t column = 0; column < view->columnCount(); column++) {
+                const float a = left->getValue(left->rowCount() == 1 ? 0 : row, left->columnCount() == 1 ? 0 : column,
+                                               left->channelCount() == 1 ? 0 : channel);
+                const float b = right->getValue(right->rowCount() == 1 ? 0 : row,
+                                                right->columnCount() == 1 ? 0 : column,
+                                                right->channelCount() == 1 ? 0 : channel);
+                values_match &= roughlyEqual(view->getValue(row, column, channel), operation(a, b));
+            }
+        }
+    }
+    ASSERT_TRUE(values_match);
+    assertReadRowMatchesGetValue(view);
+    assertEqual(view, make_shared<FullTensor>(view));
+}
+
+void testBroadcastViews() {
+    try {
+        auto batch = make_shared<FullTensor>(make_shared<TensorFromRandom>(40, 6, 2, -1.f, 1.f, 42));
+        auto bias = make_shared<FullTensor>(make_shared<TensorFromRandom>(1, 6, 2, -1.f, 1.f, 7));
+        auto channel_scale = make_shared<FullTensor>(make_shared<TensorFromRandom>(1, 1, 2, -1.f, 1.f, 3));
+        auto one_value = make_shared<FullTensor>(make_shared<TensorFromRandom>(1, 1, 1, -1.f, 1.f, 5));
+        auto column = make_shared<FullTensor>(make_shared<TensorFromRandom>(40, 1, 1, -1.f, 1.f, 11));
+        auto add = [](float a, float b) { return a + b; };
+        auto multiply = [](float a, float b) { return a * b; };
+        auto minus = [](float a, float b) { return a - b; };
+
+        // a bias row over a batch, straight from a buffer and through a view that has no layout
+        auto with_bias = makeView<TensorAddTensorView>(batch, bias);
+        ASSERT_TRUE(with_bias->rowCount() == 40 && with_bias->columnCount() == 6 && with_bias->channelCount() == 2);
+        assertBroadcastMatches(with_bias, batch, bias, add);
+        auto unlaid_bias = makeView<TensorNoOpView>(bias);
+        assertBroadcastMatches(makeView<TensorAddTensorView>(unlaid_bias, batch), unlaid_bias, batch, add);
+
+        // one scale per channel, and one value for everything
+        assertBroadcastMatches(makeView<TensorMultiplyTensorView>(batch, channel_scale), batch, channel_scale,
+                               multiply);
+        assertBroadcastMatches(makeView<TensorMinusTensorView>(one_value, batch), one_value, batch, minus);
+        auto unlaid_value = makeView<TensorNoOpView>(one_value);
+        assertBroadcastMatches(makeView<TensorMinusTensorView>(batch, unlaid_value), batch, unlaid_value, minus);
+
+        // both sides repeat: a column times a row is their outer product
+        auto outer = makeView<TensorMultiplyTensorView>(column, makeView<TensorChannelToTensorView>(bias, 0));
+        ASSERT_TRUE(outer->rowCount() == 40 && outer->columnCount() == 6 && outer->channelCount() == 1);
+        assertBroadcastMatches(outer, column, makeView<TensorChannelToTensorView>(bias, 0), multiply);
+
+        bool threw = false;
+        try {
+            makeView<TensorAddTensorView>(batch, sliceRows(batch, 0, 4));
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testAssign() {
+    try {
+        auto weights = make_shared<FullTensor>(make_shared<TensorFromRandom>(300, 300, 2, -1.f, 1.f, 42));
+        auto error = make_shared<FullTensor>(make_shared<TensorFromRandom>(300, 300, 2, -1.f, 1.f, 7));
+        auto original = make_shared<FullTensor>(weights);
+        auto *values_before = weights->data();
+
+        // the update the optimizer makes: it reads the weights, but each value only from its own position
+        auto update = makeView<TensorMinusTensorView>(weights, makeView<TensorMultiplyByScalarView>(error, 0.1f));
+        auto expected = make_shared<FullTensor>(update);
+        weights->assign(update);
+        ASSERT_TRUE(weights->data() == values_before);
+        assertEqual(expected, weights);
+
+        // nothing of ours in it
+        weights->assign(original);
+        assertEqual(original, weights);
+
+        // values read from other positions: transposes and dot products need every result before any is written
+        auto transposed = makeView<TensorTransposeView>(weights);
+        expected = make_shared<FullTensor>(transposed);
+        weights->assign(transposed);
+        assertEqual(expected, weights);
+        auto square = make_shared<FullTensor>(make_shared<TensorFromRandom>(40, 40, 1, -1.f, 1.f, 3));
+        auto product = makeView<TensorDotTensorView>(square, square);
+        expected = make_shared<FullTensor>(product);
+        square->assign(product);
+        assertEqual(expected, square);
+
+        // encoded tensors go through the same paths
+        auto half = make_shared<HalfTensor>(original);
+        auto half_update = makeView<TensorAddTensorView>(half, makeView<TensorChannelToTensorView>(half, 0));
+        auto half_expected = make_shared<HalfTensor>(half_update);
+        half->assign(half_update);
+        assertEqual(half_expected, half);
+
+        // and updateTensor() only reuses a tensor that already has the precision asked for
+        ASSERT_TRUE(updateTensor(weights, update, 32) == weights);
+        ASSERT_TRUE(updateTensor(weights, update, 16) != weights);
+
+        bool threw = false;
+        try {
+            weights->assign(sliceRows(original, 0, 4));
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testDerivedTensorCache() {
+    try {
+        auto &cache = DerivedTensorCache::shared();
+        auto weights = make_shared<HalfTensor>(make_shared<TensorFromRandom>(30, 20, 1, -1.f, 1.f, 42));
+        const auto generation = weights->generation();
+
+        // decoded and transposed once, then the same copies until the weights change
+        auto decoded = cachedDecode(weights);
+        ASSERT_TRUE(dynamic_cast<FullTensor *>(decoded.get()) != nullptr);
+        assertEqual(weights, decoded);
+        ASSERT_TRUE(cachedDecode(weights) == decoded);
+        auto transposed = cachedTranspose(weights);
+        assertEqual(makeView<TensorTransposeView>(weights), transposed);
+        ASSERT_TRUE(cachedTranspose(weights) == transposed);
+
+        weights->assign(makeView<TensorMultiplyByScalarView>(weights, 2.f));
+        ASSERT_TRUE(weights->generation() != generation);
+        auto redecoded = cachedDecode(weights);
+        ASSERT_TRUE(redecoded != decoded);
+        assertEqual(weights, redecoded);
+        auto retransposed = cachedTranspose(weights);
+        ASSERT_TRUE(retransposed != transposed);
+        assertEqual(makeView<TensorTransposeView>(weights), retransposed);
+
+        // a replacement is a different tensor, even if it ends up at the same address
+        auto replacement = make_shared<HalfTensor>(weights);
+        ASSERT_TRUE(replacement->id() != weights->id());
+        ASSERT_TRUE(cachedDecode(replacement) != redecoded);
+
+        // 32-bit buffers and views aren't copied or kept
+        auto full = make_shared<FullTensor>(weights);
+        ASSERT_TRUE(cachedDecode(full) == full);
+        auto view = makeView<TensorMultiplyByScalarView>(full, 3.f);
+        ASSERT_TRUE(cachedTranspose(view) != cachedTranspose(view));
+
+        // what we kept for a tensor goes away some time after the tensor does
+        const size_t before = cache.size();
+        weights = nullptr;
+        cachedTranspose(replacement);
+        ASSERT_TRUE(cache.size() < before + 1);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testPackedGemmTensor() {
+    try {
+        // more rows than one block of packing, and more columns than one block plus a partial panel
+        auto weights = make_shared<FullTensor>(make_shared<TensorFromRandom>(300, 2100, 1, -1.f, 1.f, 42));
+        auto packed = make_shared<PackedGemmTensor>(weights);
+        assertEqual(weights, packed);
+        assertReadRowMatchesGetValue(make_shared<PackedGemmTensor>(
+                make_shared<FullTensor>(make_shared<TensorFromRandom>(20, 40, 2, -1.f, 1.f, 3))));
+
+        bool tiles_match = true;
+        for (size_t rows: {(size_t) 1, (size_t) 2, (size_t) 37}) {
+            auto inputs = make_shared<FullTensor>(make_shared<TensorFromRandom>(rows, 300, 1, -1.f, 1.f, 7));
+            auto expected = make_shared<FullTensor>(makeView<TensorDotTensorView>(inputs, weights));
+            assertEqual(expected, make_shared<FullTensor>(makeView<TensorDotTensorView>(inputs, packed)));
+            // a window that starts and ends part way through panels, and crosses a block of columns
+            const size_t first_column = 5;
+            const size_t columns = 2060;
+            vector<float> tile(rows * columns);
+            makeView<TensorDotTensorView>(inputs, packed)->readTile(0, rows, first_column, columns, 0, tile.data(),
+                                                                   columns);
+            for (size_t row = 0; row < rows; row++) {
+                for (size_t column = 0; column < columns; column++) {
+                    tiles_match &= roughlyEqual(tile[(row * columns) + column],
+                                                expected->getValue(row, first_column + column, 0));
+                }
+            }
+        }
+        ASSERT_TRUE(tiles_match);
+
+        // updated in place, like the weights of a layer that is still learning
+        auto update = makeView<TensorMinusTensorView>(packed, makeView<TensorMultiplyByScalarView>(weights, 0.5f));
+        auto expected_update = make_shared<FullTensor>(update);
+        ASSERT_TRUE(updateTensor(packed, update, 32) == packed);
+        assertEqual(expected_update, packed);
+
+        ASSERT_TRUE(cachedPackForGemm(packed) == packed);
+        auto half = make_shared<HalfTensor>(weights);
+        auto half_packed = cachedPackForGemm(half);
+        ASSERT_TRUE(dynamic_cast<PackedGemmTensor *>(half_packed.get()) != nullptr);
+        ASSERT_TRUE(cachedPackForGemm(half) == half_packed);
+        assertEqual(half, half_packed);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testOutOfCore() {
+    vector<string> filenames = {"unit_test_out_of_core_view.tensor", "unit_test_out_of_core_half.tensor",
+                                "unit_test_out_of_core_wide.tensor", "unit_test_out_of_core_left.tensor",
+                                "unit_test_out_of_core_right.tensor", "unit_test_out_of_core_dot.tensor",
+                                "unit_test_out_of_core_scaled_dot.tensor"};
+    try {
+        // budgets far smaller than the tensors, so everything takes many tiles
+        auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(45, 70, 3, -2.f, 2.f, 42));
+        auto view = makeView<TensorAddScalarView>(makeView<TensorMultiplyByScalarView>(source, 2.f), 1.f);
+        auto expected = make_shared<FullTensor>(view);
+        assertEqual(expected, materializeToMappedFile(view, filenames[0], MappedTensorEncoding::float32, 0, 1024));
+        assertEqual(make_shared<HalfTensor>(expected),
+                    materializeToMappedFile(view, filenames[1], MappedTensorEncoding::half16, 0, 1024));
+        // rows that don't fit in the budget by themselves
+        assertEqual(expected, materializeToMappedFile(view, filenames[2], MappedTensorEncoding::float32, 0, 64));
+
+        // both sides of the dot product on disk, and blocks that don't divide any of the dimensions evenly
+        saveMappedTensor(make_shared<TensorFromRandom>(70, 90, 2, -1.f, 1.f, 43), filenames[3]);
+        saveMappedTensor(make_shared<TensorFromRandom>(90, 50, 2, -1.f, 1.f, 44), filenames[4]);
+        auto left = loadMappedTensor(filenames[3]);
+        auto right = loadMappedTensor(filenames[4]);
+        auto expected_dot = make_shared<FullTensor>(makeView<TensorDotTensorView>(left, right));
+        assertEqual(expected_dot, dotToMappedFile(left, right, filenames[5], 4096));
+        // a view on either side, and a scaled result
+        auto shifted_left = makeView<TensorAddScalarView>(makeView<TensorTransposeView>(left), 1.f);
+        auto scaled_dot = makeView<TensorDotTensorView>(makeView<TensorTransposeView>(right), shifted_left, 0.5f);
+        assertEqual(make_shared<FullTensor>(scaled_dot),
+                    materializeToMappedFile(scaled_dot, filenames[6], MappedTensorEncoding::float32, 0, 4096));
+
+        // writing over a mapping with something that reads it would clobber values we haven't read yet
+        auto target = make_shared<MappedFullTensor>(filenames[5], true);
+        bool threw = false;
+        try {
+            assignOutOfCore(target, makeView<TensorMultiplyByScalarView>(target, 2.f), 1024);
+        } catch (const exception &e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+    for (const auto &filename: filenames) {
+        remove(filename.c_str());
+    }
+}
+
+void assertMeanAndDeviation(const shared_ptr<BaseTensor> &tensor, double mean, double deviation) {
+    auto values = make_shared<FullTensor>(tensor);
+    double sum = 0;
+    double squares = 0;
+    const size_t count = values->size();
+    for (size_t row = 0; row < values->rowCount(); row++) {
+        for (size_t column = 0; column < values->columnCount(); column++) {
+            const double value = values->getValue(row, column, 0);
+            sum += value;
+            squares += value * value;
+        }
+    }
+    const double actual_mean = sum / (double) count;
+    const double actual_deviation = sqrt((squares / (double) count) - (actual_mean * actual_mean));
+    ASSERT_TRUE(abs(actual_mean - mean) < 0.01 * std::max(deviation, 1.0));
+    ASSERT_TRUE(abs(actual_deviation - deviation) < 0.01 * deviation);
+}
+
+void testPhiloxRandomTensor() {
+    try {
+        // known answers from the authors' reference implementation (Random123)
+        auto zeros = philox4x32({0, 0, 0, 0}, {0, 0});
+        ASSERT_TRUE(zeros[0] == 0x6627e8d5 && zeros[1] == 0xe169c58d && zeros[2] == 0xbc57ac4c &&
+                    zeros[3] == 0x9b00dbd8);
+        auto ones = philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff});
+        ASSERT_TRUE(ones[0] == 0x408f276d && ones[1] == 0x41c83b0e && ones[2] == 0xa20bc7c6 &&
+                    ones[3] == 0x6d5451fd);
+        auto pi = philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0});
+        ASSERT_TRUE(pi[0] == 0xd16cfe09 && pi[1] == 0x94fdcceb && pi[2] == 0x5001e420 && pi[3] == 0x24126ea1);
+
+        // a run of words starting part way through a block matches asking for them one at a time
+        vector<uint32_t> words(101);
+        philoxWords(7, 3, words.size(), words.data());
+        bool words_match = true;
+        for (size_t offset = 0; offset < words.size(); offset++) {
+            words_match &= words[offset] == philoxWord(7, 3 + offset);
+        }
+        ASSERT_TRUE(words_match);
+
+        for (auto distribution: {RandomDistribution::uniform, RandomDistribution::normal}) {
+            auto random = make_shared<PhiloxRandomTensor>(7, 45, 3, distribution, -1.f, 2.f, 11);
+            assertReadRowMatchesGetValue(random);
+            // the same seed gives the same values, and a different one doesn't
+            assertEqual(make_shared<FullTensor>(random),
+                        make_shared<PhiloxRandomTensor>(7, 45, 3, distribution, -1.f, 2.f, 11));
+            ASSERT_FALSE(make_shared<FullTensor>(random)->getValue(3, 4, 1) ==
+                         make_shared<PhiloxRandomTensor>(7, 45, 3, distribution, -1.f, 2.f, 12)->getValue(3, 4, 1));
+        }
+
+        auto uniform = make_shared<PhiloxRandomTensor>(500, 400, 1, RandomDistribution::uniform, -1.f, 2.f, 42);
+        ASSERT_TRUE(uniform->min() >= -1.f && uniform->max() < 2.f);
+        assertMeanAndDeviation(uniform, 0.5, 3.0 / sqrt(12.0));
+        assertMeanAndDeviation(make_shared<PhiloxRandomTensor>(500, 400, 1, RandomDistribution::normal, 0.f, 3.f, 42),
+                               0, 3);
+
+        // initializers are scaled by the size of the layer, and worked out up front unless we say otherwise
+        auto xavier = xavierUniform(300, 200, 1, 300, 200);
+        ASSERT_TRUE(xavier->isMaterialized());
+        ASSERT_TRUE(xavier->max() <= sqrt(6.f / 500.f) && xavier->min() >= -sqrt(6.f / 500.f));
+        assertMeanAndDeviation(xavierNormal(300, 200, 1, 300, 200), 0, sqrt(2.0 / 500.0));
+        auto he = heUniform(300, 200, 1, 300, 42, false);
+        ASSERT_FALSE(he->isMaterialized());
+        ASSERT_TRUE(he->max() <= sqrt(6.f / 300.f) && he->min() >= -sqrt(6.f / 300.f));
+        assertMeanAndDeviation(heNormal(300, 200, 1, 300), 0, sqrt(2.0 / 300.0));
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+shared_ptr<BaseTensor> randomBits(size_t rows, size_t columns, size_t channels, uint32_t seed) {
+    return make_shared<TensorValueTransformView>(make_shared<TensorFromRandom>(rows, columns, channels, -1.f, 1.f, seed),
+                                                 [](float v) { return v > 0.5f ? 1.f : 0.f; });
+}
+
+void testBitTensor() {
+    try {
+        // rows that don't fill their last word, and more than one word to a row
+        auto source = randomBits(37, 130, 2, 42);
+        auto bits = make_shared<BitTensor>(source);
+        ASSERT_TRUE(bits->isMaterialized());
+        ASSERT_TRUE(bits->byteCount() == 37 * 2 * 3 * sizeof(uint64_t));
+        assertEqual(bits, source);
+        assertReadRowMatchesGetValue(make_shared<BitTensor>(randomBits(5, 70, 2, 43)));
+
+        // bits against bits, against weights in memory (as they are, and transposed), and against a view
+        auto right_bits = make_shared<BitTensor>(randomBits(130, 71, 2, 44));
+        assertDotMatchesNaive(bits, right_bits);
+        auto weights = make_shared<FullTensor>(make_shared<TensorFromRandom>(130, 45, 2, -1.f, 1.f, 45));
+        assertDotMatchesNaive(bits, weights);
+        auto weights_t = make_shared<FullTensor>(make_shared<TensorFromRandom>(45, 130, 2, -1.f, 1.f, 46));
+        assertDotMatchesNaive(bits, make_shared<TensorTransposeView>(weights_t));
+        assertDotMatchesNaive(bits, make_shared<TensorAddScalarView>(weights, 1.f));
+        // tiles that start part way in, and a scaled result
+        auto small_bits = make_shared<BitTensor>(randomBits(6, 67, 1, 47));
+        assertReadRowMatchesGetValue(make_shared<TensorDotTensorView>(
+                small_bits, make_shared<BitTensor>(randomBits(67, 66, 1, 48)), 0.5f));
+        assertReadRowMatchesGetValue(make_shared<TensorDotTensorView>(
+                small_bits, make_shared<FullTensor>(make_shared<TensorFromRandom>(67, 9, 1, -1.f, 1.f, 49)), 0.5f));
+
+        // anything that isn't zero is a one
+        auto assigned = make_shared<BitTensor>(4, 65, 1);
+        ASSERT_TRUE(assigned->sum() == 0);
+        const auto generation = assigned->generation();
+        assigned->assign(make_shared<UniformTensor>(4, 65, 1, -0.25f));
+        ASSERT_TRUE(assigned->sum() == 4 * 65);
+        ASSERT_TRUE(assigned->generation() != generation);
+        assigned->setBit(3, 64, 0, false);
+        ASSERT_TRUE(assigned->getValue(3, 64, 0) == 0.f && assigned->getValue(3, 63, 0) == 1.f);
+        ASSERT_TRUE(assigned->sum() == (4 * 65) - 1);
+
+        map<string, size_t> categories{{"cat", 0}, {"dog", 1}, {"bird", 2}};
+        TextToCategoryEncoder encoder(categories);
+        auto encoded = encoder.encode({"dog", " bird "}, 1, 3, 2, true);
+        ASSERT_TRUE(dynamic_cast<BitTensor *>(encoded.get()) != nullptr);
+        ASSERT_TRUE(encoded->getValue(0, 1, 0) == 1.f && encoded->getValue(0, 2, 1) == 1.f);
+        ASSERT_TRUE(encoded->sum() == 2);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+// about four out of five values are zero
+shared_ptr<BaseTensor> mostlyZeros(size_t rows, size_t columns, size_t channels, uint32_t seed) {
+    return make_shared<TensorValueTransformView>(make_shared<TensorFromRandom>(rows, columns, channels, -1.f, 1.f, seed),
+                                                 [](float v) { return v > 0.6f ? v : 0.f; });
+}
+
+void testSparseTensor() {
+    try {
+        auto source = mostlyZeros(37, 130, 2, 42);
+        auto sparse = make_shared<SparseTensor>(source);
+        ASSERT_TRUE(sparse->isMaterialized());
+        ASSERT_TRUE(sparse->nonZeroCount() > 0 && sparse->nonZeroCount() < sparse->size() / 3);
+        ASSERT_TRUE(sparse->byteCount() < sparse->size() * sizeof(float) / 2);
+        assertEqual(sparse, source);
+        assertReadRowMatchesGetValue(make_shared<SparseTensor>(mostlyZeros(5, 70, 2, 43)));
+
+        // sparse on the left against weights in memory (as they are, and transposed) and against a view, and a
+        // transpose of sparse on the left, like a dense layer's weight error
+        auto weights = make_shared<FullTensor>(make_shared<TensorFromRandom>(130, 45, 2, -1.f, 1.f, 44));
+        assertDotMatchesNaive(sparse, weights);
+        auto weights_t = make_shared<FullTensor>(make_shared<TensorFromRandom>(45, 130, 2, -1.f, 1.f, 45));
+        assertDotMatchesNaive(sparse, make_shared<TensorTransposeView>(weights_t));
+        assertDotMatchesNaive(sparse, make_shared<TensorAddScalarView>(weights, 1.f));
+        auto error = make_shared<FullTensor>(make_shared<TensorFromRandom>(37, 20, 2, -1.f, 1.f, 46));
+        assertDotMatchesNaive(make_shared<TensorTransposeView>(sparse), error);
+        // tiles that start part way in, and a scaled result
+        auto small = make_shared<SparseTensor>(mostlyZeros(6, 67, 1, 47));
+        assertReadRowMatchesGetValue(make_shared<TensorDotTensorView>(
+                small, make_shared<FullTensor>(make_shared<TensorFromRandom>(67, 9, 1, -1.f, 1.f, 48)), 0.5f));
+        assertReadRowMatchesGetValue(make_shared<TensorDotTensorView>(
+                make_shared<TensorTransposeView>(small),
+                make_shared<FullTensor>(make_shared<TensorFromRandom>(6, 9, 1, -1.f, 1.f, 49)), 0.5f));
+
+        // arrays built by hand
+        auto by_hand = make_shared<SparseTensor>(2, 3, 1, vector<size_t>{0, 1, 3}, vector<uint32_t>{2, 0, 1},
+                                                 vector<float>{5.f, 6.f, 7.f});
+        assertEqual(by_hand, tensor({{{0.f, 0.f, 5.f}, {6.f, 7.f, 0.f}}}));
+        bool mismatched = false;
+        try {
+            SparseTensor(2, 3, 1, vector<size_t>{0, 1, 3}, vector<uint32_t>{2, 0}, vector<float>{5.f, 6.f});
+        } catch (const exception &e) {
+            mismatched = true;
+        }
+        ASSERT_TRUE(mismatched);
+
+        // flattening keeps it sparse
+        assertEqual(sparse->flattenToRow(), make_shared<TensorFlattenToRowView>(sparse));
+
+        // assign rebuilds it, and an expression that reads us writes back a tile at a time
+        auto assigned = make_shared<SparseTensor>(37, 130, 2);
+        ASSERT_TRUE(assigned->nonZeroCount() == 0);
+        assigned->assign(source);
+        assertEqual(assigned, source);
+        const auto generation = assigned->generation();
+        assigned->assign(make_shared<TensorValueTransformView>(
+                assigned, [](float v) { return v > 0.8f ? 0.f : v * 2.f; }));
+        assertEqual(assigned, make_shared<TensorValueTransformView>(
+                source, [](float v) { return v > 0.8f ? 0.f : v * 2.f; }));
+        ASSERT_TRUE(assigned->nonZeroCount() < sparse->nonZeroCount());
+        ASSERT_TRUE(assigned->generation() != generation);
+
+        auto encoded = TextToScalarEncoder(true).encode({"0", " 1.5", "0", "2", "0", "0"}, 2, 3, 1, true);
+        ASSERT_TRUE(dynamic_cast<SparseTensor *>(encoded.get())->nonZeroCount() == 2);
+        assertEqual(encoded, tensor({{{0.f, 1.5f, 0.f}, {2.f, 0.f, 0.f}}}));
+        auto pixels = TextToPixelEncoder(true).encode({"0", "255", "51", "0"}, 2, 2, 1, false);
+        assertEqual(pixels, tensor({{{0.f, 1.f}, {0.2f, 0.f}}}));
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
+void testChannelLastTensor() {
+    try {
+        auto source = make_shared<FullTensor>(make_shared<TensorFromRandom>(9, 11, 4, -1.f, 1.f, 42));
+        auto channel_last = make_shared<ChannelLastTensor>(source);
+        assertEqual(channel_last, source);
+        ASSERT_TRUE(channelLayoutOf(channel_last) == ChannelLayout::channelsLast);
+        ASSERT_TRUE(channelLayoutOf(source) == ChannelLayout::channelsFirst);
+        // every channel of a location is together
+        const float *location = channel_last->locationValues(3, 5);
+        for (size_t channel = 0; channel < 4; channel++) {
+            ASSERT_TRUE(location[channel] == source->getValue(3, 5, channel));
+        }
+        assertReadRowMatchesGetValue(channel_last);
+        // views read it in place through its strides
+        assertReadRowMatchesGetValue(make_shared<TensorChannelToTensorView>(channel_last, 2));
+        assertReadRowMatchesGetValue(make_shared<TensorTransposeView>(channel_last));
+        assertDotMatchesNaive(channel_last, make_shared<ChannelLastTensor>(
+                make_shared<TensorFromRandom>(11, 6, 4, -1.f, 1.f, 43)));
+
+        // converting to the layout a tensor already has is free, and converting back gives the same values
+        ASSERT_TRUE(toChannelLayout(channel_last, ChannelLayout::channelsLast) == channel_last);
+        ASSERT_TRUE(toChannelLayout(source, ChannelLayout::channelsFirst) == source);
+        auto channel_first = toChannelLayout(channel_last, ChannelLayout::channelsFirst);
+        ASSERT_TRUE(channelLayoutOf(channel_first) == ChannelLayout::channelsFirst);
+        assertEqual(channel_first, source);
+        ASSERT_TRUE(cachedChannelsLast(channel_last) == channel_last);
+        assertEqual(cachedChannelsLast(source), source);
+
+        auto assigned = make_shared<ChannelLastTensor>(9, 11, 4);
+        assigned->assign(make_shared<TensorAddScalarView>(source, 1.f));
+        assertEqual(assigned, make_shared<TensorAddScalarView>(source, 1.f));
+
+        // summing the correlation of each channel, whatever layout the input and kernel are in
+        auto kernel = make_shared<FullTensor>(make_shared<TensorFromRandom>(3, 2, 4, -1.f, 1.f, 44));
+        shared_ptr<BaseTensor> expected = nullptr;
+        for (size_t channel = 0; channel < 4; channel++) {
+            shared_ptr<BaseTensor> correlation = make_shared<TensorValidCrossCorrelation2dView>(
+                    make_shared<TensorChannelToTensorView>(source, channel),
+                    make_shared<TensorChannelToTensorView>(kernel, channel));
+            if (expected) {
+                expected = make_shared<TensorAddTensorView>(expected, correlation);
+            } else {
+                expected = correlation;
+            }
+        }
+        auto fused = make_shared<TensorChannelSumCrossCorrelation2dView>(channel_last,
+                                                                         make_shared<ChannelLastTensor>(kernel));
+        ASSERT_TRUE(fused->rowCount() == 7 && fused->columnCount() == 10 && fused->channelCount() == 1);
+        assertEqual(fused, expected);
+        assertReadRowMatchesGetValue(fused);
+        assertEqual(make_shared<TensorChannelSumCrossCorrelation2dView>(source, kernel), expected);
+        assertEqual(make_shared<TensorChannelSumCrossCorrelation2dView>(
+                make_shared<TensorAddScalarView>(source, 0.f), kernel), expected);
+        PASS_TEST();
+    } catch (const exception &e) {
+        FAIL_TEST(e);
+    }
+}
+
 int main() {
     try {
         // TODO: a lot of these tests don't cover the situation where we have many channels
@@ -626,6 +1880,54 @@ int main() {
         timer.printMilliseconds();
         testFullSaveLoad();
         timer.printMilliseconds();
+        testFullTensorContiguousLayout();
+        timer.printMilliseconds();
+        testReadRowMatchesGetValue();
+        timer.printMilliseconds();
+        testDotTensorGemm();
+        timer.printMilliseconds();
+        testFusedTensorEvaluator();
+        timer.printMilliseconds();
+        testParallelMaterialization();
+        timer.printMilliseconds();
+        testStatsAndReductions();
+        timer.printMilliseconds();
+        testMappedTensor();
+        timer.printMilliseconds();
+        testTensorArena();
+        timer.printMilliseconds();
+        testPooledViews();
+        timer.printMilliseconds();
+        testCachedView();
+        timer.printMilliseconds();
+        testDenseTensorCodecs();
+        timer.printMilliseconds();
+        testStridedViews();
+        timer.printMilliseconds();
+        testSimplifyViews();
+        timer.printMilliseconds();
+        testConcatViews();
+        timer.printMilliseconds();
+        testAxisReductions();
+        timer.printMilliseconds();
+        testBroadcastViews();
+        timer.printMilliseconds();
+        testAssign();
+        timer.printMilliseconds();
+        testDerivedTensorCache();
+        timer.printMilliseconds();
+        testPackedGemmTensor();
+        timer.printMilliseconds();
+        testOutOfCore();
+        timer.printMilliseconds();
+        testPhiloxRandomTensor();
+        timer.printMilliseconds();
+        testBitTensor();
+        timer.printMilliseconds();
+        testSparseTensor();
+        timer.printMilliseconds();
+        testChannelLastTensor();
+        timer.printMilliseconds();
 
         // need to finish writing this test:
         //test_pixel()
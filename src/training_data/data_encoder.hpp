@@ -13,6 +13,8 @@
 #include <locale>
 #include <map>
 #include "../types/tensor.hpp"
+#include "../types/bit_tensors.hpp"
+#include "../types/sparse_tensors.hpp"
 #include "../util/tensor_utils.hpp"
 
 using namespace std;
@@ -46,10 +48,41 @@ namespace happyml {
     };
 
 
+    // Words come in the order a SparseTensor keeps its values (channel, then row, then column), so we build its
+    // arrays as we go and never hold the zeros. Each value is multiplied by scale.
+    inline shared_ptr<BaseTensor> encodeSparse(const vector<string> &words, size_t rows, size_t columns, size_t channels,
+                                        bool trim, float scale) {
+        vector<size_t> row_starts((rows * channels) + 1, 0);
+        vector<uint32_t> column_indices;
+        vector<float> values;
+        size_t offset = 0;
+        for (size_t row_index = 0; row_index < rows * channels; row_index++) {
+            for (size_t column = 0; column < columns; column++) {
+                const float value = stringToFloat(trim ? stringTrim(words[offset]) : words[offset]) * scale;
+                if (value != 0.f) {
+                    column_indices.push_back((uint32_t) column);
+                    values.push_back(value);
+                }
+                offset++;
+            }
+            row_starts[row_index + 1] = values.size();
+        }
+        return make_shared<SparseTensor>(rows, columns, channels, std::move(row_starts), std::move(column_indices),
+                                         std::move(values));
+    }
+
     class TextToPixelEncoder : public TrainingDataInputEncoder {
     public:
+        // Sparse keeps only the pixels that aren't black, which suits images that are mostly background, like MNIST.
+        explicit TextToPixelEncoder(bool sparse = false) {
+            this->sparse = sparse;
+        }
+
         shared_ptr<BaseTensor> encode(const vector<string> &words,
                                       size_t rows, size_t columns, size_t channels, bool trim) override {
+            if (sparse) {
+                return encodeSparse(words, rows, columns, channels, trim, 1.f / 255.f);
+            }
             // it is wasteful to allocate a huge vector only to copy it into a tensor
             // however, I wanted tensors to be immutable.
             // TODO: I think I could make a FullTensor constructor that steals the memory we are allocating here.
@@ -72,12 +105,23 @@ namespace happyml {
             }
             return pixelTensor(result);
         }
+
+    private:
+        bool sparse;
     };
 
     class TextToScalarEncoder : public TrainingDataInputEncoder {
     public:
+        // Sparse keeps only the values that aren't zero, for wide rows of features that are mostly empty.
+        explicit TextToScalarEncoder(bool sparse = false) {
+            this->sparse = sparse;
+        }
+
         shared_ptr<BaseTensor> encode(const vector<string> &words,
                                       size_t rows, size_t columns, size_t channels, bool trim) override {
+            if (sparse) {
+                return encodeSparse(words, rows, columns, channels, trim, 1.f);
+            }
             vector<vector<vector<float>>> result;
             result.resize(channels);
             size_t offset = 0;
@@ -94,6 +138,9 @@ namespace happyml {
             }
             return tensor(result);
         }
+
+    private:
+        bool sparse;
     };
 
     class TextToCategoryEncoder : public TrainingDataInputEncoder {
@@ -108,15 +155,8 @@ namespace happyml {
                 throw exception(
                         "The result tensor must have exactly the same number of channels as there are words to encode.");
             }
-            vector<vector<vector<float>>> result;
-            result.resize(channels);
-            for (size_t channel = 0; channel < channels; channel++) {
-                result[channel].resize(rows);
-                for (size_t row = 0; row < rows; row++) {
-                    result[channel][row].resize(columns);
-                }
-            }
-
+            // one-hot: a single one per channel, so we only need a bit for each value.
+            auto result = make_shared<BitTensor>(rows, columns, channels);
             size_t channel_offset = 0;
             for (const auto &word: words) {
                 size_t column_offset;
@@ -125,11 +165,10 @@ namespace happyml {
                 } else {
                     column_offset = categoryMapping.at(word);
                 }
-                result[channel_offset][0][column_offset] = 1.f;
+                result->setBit(0, column_offset, channel_offset, true);
                 channel_offset++;
             }
-
-            return tensor(result);
+            return result;
         }
 
     private:
@@ -33,20 +33,15 @@ namespace happyml {
         }
 
         void shuffle() override {
-            // todo: likely can be optimized
-            random_device rd;
-            mt19937 g(rd());
-            std::shuffle(pairs.begin(), pairs.end(), g);
+            std::shuffle(pairs.begin(), pairs.end(), shuffleGenerator);
         }
 
         void shuffle(size_t start_offset, size_t end_offset) override {
-            // todo: likely can be optimized
-            random_device rd;
-            mt19937 g(rd());
             const size_t end = datasetSize - end_offset;
             // weird that I had to cast it down to an unsigned long
             // feels like a bug waiting to happen with a large data set.
-            std::shuffle(pairs.begin() + (unsigned long) start_offset, pairs.end() - (unsigned long) end, g);
+            std::shuffle(pairs.begin() + (unsigned long) start_offset, pairs.end() - (unsigned long) end,
+                         shuffleGenerator);
         }
 
         void restart() override {
@@ -92,6 +87,7 @@ namespace happyml {
         size_t datasetSize;
         vector<shared_ptr<TrainingPair>> pairs;
         size_t currentOffset;
+        mt19937 shuffleGenerator{random_device{}()};
     };
 }
 #endif //HAPPYML_GENERATED_DATASETS_HPP
@@ -162,21 +162,16 @@ namespace happyml {
         }
 
         void shuffle() override {
-            // todo: likely can be optimized
-            random_device rd;
-            mt19937 g(rd());
-            std::shuffle(pairs.begin(), pairs.end(), g);
+            std::shuffle(pairs.begin(), pairs.end(), shuffleGenerator);
             restart();
         }
 
         void shuffle(size_t start_offset, size_t end_offset) override {
-            // todo: likely can be optimized
-            random_device rd;
-            mt19937 g(rd());
             const size_t end = recordCount() - end_offset;
             // weird that I had to cast it down to an unsigned long
             // feels like a bug waiting to happen with a large data set.
-            std::shuffle(pairs.begin() + (unsigned long) start_offset, pairs.end() - (unsigned long) end, g);
+            std::shuffle(pairs.begin() + (unsigned long) start_offset, pairs.end() - (unsigned long) end,
+                         shuffleGenerator);
             restart();
         }
 
@@ -238,6 +233,9 @@ namespace happyml {
     private:
         vector<shared_ptr<TrainingPair>> pairs;
         size_t current_offset;
+        // seeded once. A random_device can be slow to ask (it may read from the operating system), and we shuffle
+        // every epoch.
+        mt19937 shuffleGenerator{random_device{}()};
     };
 
     // This is fine for small datasets, but
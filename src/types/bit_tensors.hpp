@@ -0,0 +1,216 @@
+//
+// Created by Erik Hyrkas on 1/17/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_BIT_TENSORS_HPP
+#define HAPPYML_BIT_TENSORS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "../util/gemm.hpp"
+#include "../util/tensor_arena.hpp"
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+#endif
+
+using namespace std;
+
+namespace happyml {
+
+    inline size_t bitCount(uint64_t word) {
+#if defined(_MSC_VER)
+        return (size_t) __popcnt64(word);
+#else
+        return (size_t) __builtin_popcountll(word);
+#endif
+    }
+
+    // position of the lowest set bit. word can't be zero.
+    inline size_t lowestBit(uint64_t word) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return (size_t) index;
+#else
+        return (size_t) __builtin_ctzll(word);
+#endif
+    }
+
+    // This is the bit matrix from the TODO at the top of tensor.hpp. A lot of inputs (and one-hot targets, like
+    // the ones TextToCategoryEncoder makes) are nothing but ones and zeros, and storing those as floats spends 32
+    // bits on each one. We keep one bit per value: anything that isn't zero is stored as a one.
+    //
+    // Each row starts on a new 64-bit word, so a row's bits can be handed to AND and popcount a word at a time,
+    // which is what a dot product with a BitTensor on its left does (see TensorDotTensorView.)
+    class BitTensor : public BaseAssignableTensor {
+    public:
+        // all zeros
+        BitTensor(size_t rows, size_t columns, size_t channels) {
+            this->rows = rows;
+            this->columns = columns;
+            this->channels = channels;
+            this->rowWords = (columns + 63) / 64;
+            words.resize(rowWords * rows * channels);
+        }
+
+        // Packs original a row at a time, so the floats never all exist at once, no matter how big original is.
+        explicit BitTensor(const shared_ptr<BaseTensor> &original)
+                : BitTensor(original->rowCount(), original->columnCount(), original->channelCount()) {
+            RowScratch values(columns);
+            for (size_t channel = 0; channel < channels; channel++) {
+                for (size_t row = 0; row < rows; row++) {
+                    readTileFused(original, row, 1, 0, columns, channel, values.data(), columns);
+                    writeRow(row, channel, 0, columns, values.data());
+                }
+            }
+        }
+
+        void printMaterializationPlan() override {
+            cout << "BitTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            return isSet(row, column, channel) ? 1.f : 0.f;
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const uint64_t *bits = rowBits(row, channel);
+            for (size_t offset = 0; offset < count; offset++) {
+                const size_t column = firstColumn + offset;
+                out[offset] = (float) ((bits[column / 64] >> (column % 64)) & 1);
+            }
+        }
+
+        [[nodiscard]] inline bool isSet(size_t row, size_t column, size_t channel) const {
+            return ((rowBits(row, channel)[column / 64] >> (column % 64)) & 1) != 0;
+        }
+
+        void setBit(size_t row, size_t column, size_t channel, bool value) {
+            uint64_t &word = writableRowBits(row, channel)[column / 64];
+            const uint64_t mask = (uint64_t) 1 << (column % 64);
+            word = value ? (word | mask) : (word & ~mask);
+            markModified();
+        }
+
+        // The bits of a row, lowest column first, in rowWordCount() words. Bits past the last column are zero.
+        [[nodiscard]] inline const uint64_t *rowBits(size_t row, size_t channel) const {
+            return words.data() + (((channel * rows) + row) * rowWords);
+        }
+
+        [[nodiscard]] size_t rowWordCount() const {
+            return rowWords;
+        }
+
+        // memory the bits take up
+        [[nodiscard]] size_t byteCount() const {
+            return words.size() * sizeof(uint64_t);
+        }
+
+    protected:
+        void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *values) override {
+            uint64_t *bits = writableRowBits(row, channel);
+            for (size_t offset = 0; offset < count; offset++) {
+                const size_t column = firstColumn + offset;
+                const uint64_t mask = (uint64_t) 1 << (column % 64);
+                bits[column / 64] = values[offset] != 0.f ? (bits[column / 64] | mask) : (bits[column / 64] & ~mask);
+            }
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        size_t channels;
+        size_t rowWords;
+        vector<uint64_t> words;
+
+        inline uint64_t *writableRowBits(size_t row, size_t channel) {
+            return words.data() + (((channel * rows) + row) * rowWords);
+        }
+    };
+
+    // c = a dot b for rows firstRow through firstRow + rows - 1 of a, and columns firstColumn through
+    // firstColumn + columns - 1 of b, when both sides are bits. Each value is how many places a's row and b's column
+    // are both set, so we gather b's columns into rows of bits first, and then each value is an AND and a popcount
+    // for every 64 of the inner dimension.
+    inline void bitDotBits(BitTensor &a, BitTensor &b, size_t channel, size_t firstRow, size_t rows,
+                           size_t firstColumn, size_t columns, float *c, size_t ldc) {
+        const size_t inner = a.columnCount();
+        const size_t words = a.rowWordCount();
+        ArenaBuffer<uint64_t> b_columns(columns * words);
+        std::fill(b_columns.data(), b_columns.data() + (columns * words), (uint64_t) 0);
+        for (size_t k = 0; k < inner; k++) {
+            const uint64_t *b_row = b.rowBits(k, channel);
+            const uint64_t k_bit = (uint64_t) 1 << (k % 64);
+            for (size_t column = 0; column < columns; column++) {
+                const size_t b_column = firstColumn + column;
+                if ((b_row[b_column / 64] >> (b_column % 64)) & 1) {
+                    b_columns.data()[(column * words) + (k / 64)] |= k_bit;
+                }
+            }
+        }
+        for (size_t row = 0; row < rows; row++) {
+            const uint64_t *a_row = a.rowBits(firstRow + row, channel);
+            float *c_row = c + (row * ldc);
+            for (size_t column = 0; column < columns; column++) {
+                const uint64_t *b_column = b_columns.data() + (column * words);
+                size_t total = 0;
+                for (size_t word = 0; word < words; word++) {
+                    total += bitCount(a_row[word] & b_column[word]);
+                }
+                c_row[column] = (float) total;
+            }
+        }
+    }
+
+    // c = a dot b for the same window, when only a is bits, and b already starts at firstColumn. A set bit adds a row of b, and a clear bit adds
+    // nothing, so rather than multiply by ones and zeros, we add up the rows of b that a's row picks out,
+    // skipping clear bits a word at a time. The sparser a is, the less work there is.
+    inline void bitDotValues(BitTensor &a, const StridedMatrix &b, size_t channel, size_t firstRow, size_t rows,
+                             size_t columns, float *c, size_t ldc) {
+        const size_t words = a.rowWordCount();
+        for (size_t row = 0; row < rows; row++) {
+            const uint64_t *a_row = a.rowBits(firstRow + row, channel);
+            float *c_row = c + (row * ldc);
+            std::fill(c_row, c_row + columns, 0.f);
+            for (size_t word = 0; word < words; word++) {
+                uint64_t bits = a_row[word];
+                while (bits != 0) {
+                    const size_t k = (word * 64) + lowestBit(bits);
+                    bits &= bits - 1;
+                    const float *b_row = b.data + (k * b.rowStride);
+                    if (b.columnStride == 1) {
+                        for (size_t column = 0; column < columns; column++) {
+                            c_row[column] += b_row[column];
+                        }
+                    } else {
+                        for (size_t column = 0; column < columns; column++) {
+                            c_row[column] += b_row[column * b.columnStride];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif //HAPPYML_BIT_TENSORS_HPP
@@ -0,0 +1,158 @@
+//
+// Created by Erik Hyrkas on 1/19/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_CHANNEL_LAST_TENSORS_HPP
+#define HAPPYML_CHANNEL_LAST_TENSORS_HPP
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "materialized_tensors.hpp"
+#include "../util/tensor_arena.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // The order a materialized tensor keeps its values in.
+    enum class ChannelLayout {
+        // channel, then row, then column (CHW): a row of a channel is together. FullTensor and the other dense
+        // tensors, and what we save to files.
+        channelsFirst,
+        // row, then column, then channel (HWC): every channel of one location is together. ChannelLastTensor.
+        channelsLast
+    };
+
+    // 32-bit floats kept channel-last: the value at (row, column, channel) is at
+    // data[(row * columns + column) * channels + channel].
+    //
+    // A convolution reads every input channel at the same location, and sums them. Laid out channel-first, those
+    // values are a whole channel apart, and each one is on its own cache line. Laid out like this, they're next to
+    // each other (see TensorChannelSumCrossCorrelation2dView.) The price is that a row of a single channel is now
+    // strided, so everything that reads one channel at a time is a little slower. Pick the layout that suits how
+    // the tensor is read.
+    class ChannelLastTensor : public BaseAssignableTensor {
+    public:
+        // all zeros
+        ChannelLastTensor(size_t rows, size_t columns, size_t channels) {
+            this->rows = rows;
+            this->columns = columns;
+            this->channels = channels;
+            values.resize(rows * columns * channels);
+        }
+
+        explicit ChannelLastTensor(const shared_ptr<BaseTensor> &original)
+                : ChannelLastTensor(original->rowCount(), original->columnCount(), original->channelCount()) {
+            RowScratch row_values(columns);
+            for (size_t channel = 0; channel < channels; channel++) {
+                for (size_t row = 0; row < rows; row++) {
+                    readTileFused(original, row, 1, 0, columns, channel, row_values.data(), columns);
+                    writeRow(row, channel, 0, columns, row_values.data());
+                }
+            }
+        }
+
+        void printMaterializationPlan() override {
+            cout << "ChannelLastTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            return values[(((row * columns) + column) * channels) + channel];
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const float *source = locationValues(row, firstColumn) + channel;
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = source[offset * channels];
+            }
+        }
+
+        bool bufferLayout(TensorBufferLayout &layout) override {
+            layout.data = values.data();
+            layout.rowStride = columns * channels;
+            layout.columnStride = channels;
+            layout.channelStride = 1;
+            return true;
+        }
+
+        // every channel of one location, one after the other.
+        [[nodiscard]] inline const float *locationValues(size_t row, size_t column) const {
+            return values.data() + (((row * columns) + column) * channels);
+        }
+
+    protected:
+        void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *source) override {
+            float *target = values.data() + (((row * columns) + firstColumn) * channels) + channel;
+            for (size_t offset = 0; offset < count; offset++) {
+                target[offset * channels] = source[offset];
+            }
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        size_t channels;
+        vector<float> values;
+    };
+
+    inline ChannelLayout channelLayoutOf(const shared_ptr<BaseTensor> &tensor) {
+        if (dynamic_cast<ChannelLastTensor *>(tensor.get()) != nullptr) {
+            return ChannelLayout::channelsLast;
+        }
+        return ChannelLayout::channelsFirst;
+    }
+
+    // tensor, materialized in the layout we asked for. A tensor that is already materialized that way comes back as
+    // it is.
+    inline shared_ptr<BaseTensor> toChannelLayout(const shared_ptr<BaseTensor> &tensor, ChannelLayout layout) {
+        if (tensor->isMaterialized() && channelLayoutOf(tensor) == layout) {
+            return tensor;
+        }
+        if (layout == ChannelLayout::channelsLast) {
+            return make_shared<ChannelLastTensor>(tensor);
+        }
+        return make_shared<FullTensor>(tensor);
+    }
+
+    // A rows x columns window of tensor, starting at (firstRow, firstColumn), with every channel of a location next
+    // to each other, so a row of the window is columns * channels values long, and rows are rowStride apart. A
+    // channel-last tensor is read in place. Anything else is copied into values first.
+    inline const float *readChannelLastWindow(const shared_ptr<BaseTensor> &tensor, size_t firstRow, size_t rows,
+                                              size_t firstColumn, size_t columns, ArenaBuffer<float> &values,
+                                              size_t &rowStride) {
+        const size_t channels = tensor->channelCount();
+        TensorBufferLayout layout;
+        if (tensor->bufferLayout(layout) && layout.channelStride == 1 && layout.columnStride == channels) {
+            rowStride = layout.rowStride;
+            return layout.data + (firstRow * layout.rowStride) + (firstColumn * channels);
+        }
+        rowStride = columns * channels;
+        values.resize(rows * rowStride);
+        ArenaBuffer<float> channel_values(rows * columns);
+        for (size_t channel = 0; channel < channels; channel++) {
+            readTileFused(tensor, firstRow, rows, firstColumn, columns, channel, channel_values.data(), columns);
+            for (size_t offset = 0; offset < rows * columns; offset++) {
+                values.data()[(offset * channels) + channel] = channel_values.data()[offset];
+            }
+        }
+        return values.data();
+    }
+}
+
+#endif //HAPPYML_CHANNEL_LAST_TENSORS_HPP
@@ -0,0 +1,380 @@
+//
+// Created by Erik Hyrkas on 1/5/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_MAPPED_TENSORS_HPP
+#define HAPPYML_MAPPED_TENSORS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "quarter_float.hpp"
+#include "half_float.hpp"
+#include "tensor.hpp"
+#include "materialized_tensors.hpp"
+#include "../util/memory_mapped_file.hpp"
+
+using namespace std;
+
+// This is the "solid-state" tensor from the TODO in materialized_tensors.hpp. The values live in a file and
+// we memory-map it, so opening a tensor costs the same no matter how big it is, and the operating system pages
+// values in (and back out) as we use them. A layer that doesn't fit in memory can still be used, just slower.
+//
+// The regular tensor file format (see BaseTensor::save) is big-endian and has to be converted value by value,
+// which defeats the point of mapping it. Mapped tensors use their own format that is laid out exactly the
+// way the values sit in memory:
+//   * a 64-byte header (MappedTensorHeader) so the values start on a cache line boundary
+//   * the values, channel -> row -> column, as native floats, halfs or quarters.
+// The header records which byte order the file was written in, and we refuse to open a file from a machine
+// with a different one rather than silently reading garbage.
+namespace happyml {
+
+    enum class MappedTensorEncoding : uint32_t {
+        float32 = 0, half16 = 1, quarter8 = 2
+    };
+
+    constexpr char MAPPED_TENSOR_MAGIC[8] = {'H', 'A', 'P', 'P', 'Y', 'M', 'A', 'P'};
+    constexpr uint32_t MAPPED_TENSOR_ENDIAN_MARKER = 0x01020304;
+    constexpr uint32_t MAPPED_TENSOR_VERSION = 1;
+
+    struct MappedTensorHeader {
+        char magic[8];
+        uint32_t endianMarker;
+        uint32_t version;
+        uint32_t encoding;
+        int32_t bias;
+        uint64_t channels;
+        uint64_t rows;
+        uint64_t columns;
+        uint8_t reserved[16];
+    };
+
+    static_assert(sizeof(MappedTensorHeader) == 64, "The mapped tensor header must be exactly 64 bytes.");
+
+    inline bool readMappedTensorHeader(const string &path, MappedTensorHeader &header) {
+        ifstream stream(path, std::ios::in | std::ios::binary);
+        if (!stream.is_open()) {
+            return false;
+        }
+        stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+        return stream.gcount() == sizeof(header) &&
+               std::memcmp(header.magic, MAPPED_TENSOR_MAGIC, sizeof(MAPPED_TENSOR_MAGIC)) == 0;
+    }
+
+    inline bool isMappedTensorFile(const string &path) {
+        MappedTensorHeader header{};
+        return readMappedTensorHeader(path, header);
+    }
+
+    // The shared part of the mapped tensors. Derived classes provide encode() and decode() to convert between
+    // floats and whatever is stored in the file. We call them through the derived type, rather than through
+    // a virtual function, so they can be inlined into the row loops.
+    template<typename T, typename Derived>
+    class BaseMappedTensor : public BaseAssignableTensor {
+    public:
+        BaseMappedTensor(const string &path, bool writable, MappedAccess access, MappedTensorEncoding encoding)
+                : file(path, writable, access) {
+            if (file.size() < sizeof(MappedTensorHeader)) {
+                throw exception("File is too small to be a mapped tensor.");
+            }
+            std::memcpy(&header, file.data(), sizeof(MappedTensorHeader));
+            if (std::memcmp(header.magic, MAPPED_TENSOR_MAGIC, sizeof(MAPPED_TENSOR_MAGIC)) != 0) {
+                throw exception("File is not a mapped tensor.");
+            }
+            if (header.endianMarker != MAPPED_TENSOR_ENDIAN_MARKER) {
+                throw exception("Mapped tensor was written on a machine with a different byte order.");
+            }
+            if (header.version != MAPPED_TENSOR_VERSION) {
+                throw exception("Unsupported mapped tensor version.");
+            }
+            if (header.encoding != (uint32_t) encoding) {
+                throw exception("Mapped tensor file holds a different encoding than requested.");
+            }
+            const size_t expected = sizeof(MappedTensorHeader) +
+                                    (header.channels * header.rows * header.columns * sizeof(T));
+            if (file.size() < expected) {
+                throw exception("Mapped tensor file is truncated.");
+            }
+            values = reinterpret_cast<T *>(file.data() + sizeof(MappedTensorHeader));
+            channelStride = header.rows * header.columns;
+        }
+
+        size_t rowCount() override {
+            return header.rows;
+        }
+
+        size_t columnCount() override {
+            return header.columns;
+        }
+
+        size_t channelCount() override {
+            return header.channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            return derived().decode(rowData(row, channel)[column]);
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const T *source = rowData(row, channel) + firstColumn;
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = derived().decode(source[offset]);
+            }
+        }
+
+        [[nodiscard]] bool isWritable() const {
+            return file.isWritable();
+        }
+
+        void setValue(size_t row, size_t column, size_t channel, float value) {
+            requireWritable();
+            rowData(row, channel)[column] = derived().encode(value);
+            markModified();
+        }
+
+        // Overwrites every value with the values of source, which needs to be the same shape. This is how weights
+        // in a writable mapping get updated. Call flush() when you need the changes to be on disk.
+        void copyFrom(const shared_ptr<BaseTensor> &source) {
+            requireWritable();
+            assign(source);
+        }
+
+        // Overwrites count values of one row, starting at firstColumn. This fills in a writable mapping a piece at
+        // a time, for when the values we're writing don't fit in memory all at once (see tensor_out_of_core.hpp.)
+        void setRowValues(size_t row, size_t channel, size_t firstColumn, size_t count, const float *source) {
+            writeRow(row, channel, firstColumn, count, source);
+            markModified();
+        }
+
+        void flush() {
+            file.flush();
+        }
+
+        void advise(MappedAccess access) {
+            file.advise(access);
+        }
+
+    protected:
+        void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *source) override {
+            requireWritable();
+            T *target = rowData(row, channel) + firstColumn;
+            for (size_t offset = 0; offset < count; offset++) {
+                target[offset] = derived().encode(source[offset]);
+            }
+        }
+
+        MemoryMappedFile file;
+        MappedTensorHeader header{};
+        T *values;
+        size_t channelStride;
+
+        inline T *rowData(size_t row, size_t channel) {
+            return values + (channel * channelStride) + (row * header.columns);
+        }
+
+    private:
+        inline Derived &derived() {
+            return *static_cast<Derived *>(this);
+        }
+
+        void requireWritable() {
+            if (!file.isWritable()) {
+                throw exception("Mapped tensor was opened read-only.");
+            }
+        }
+    };
+
+    class MappedFullTensor : public BaseMappedTensor<float, MappedFullTensor> {
+    public:
+        explicit MappedFullTensor(const string &path, bool writable = false,
+                                  MappedAccess access = MappedAccess::normal)
+                : BaseMappedTensor(path, writable, access, MappedTensorEncoding::float32) {
+        }
+
+        void printMaterializationPlan() override {
+            cout << "MappedFullTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            std::memcpy(out, rowData(row, channel) + firstColumn, count * sizeof(float));
+        }
+
+        // the kernels can read floats straight out of the mapping.
+        bool bufferLayout(TensorBufferLayout &layout) override {
+            layout.data = values;
+            layout.rowStride = header.columns;
+            layout.columnStride = 1;
+            layout.channelStride = channelStride;
+            return true;
+        }
+
+        static inline float decode(float value) {
+            return value;
+        }
+
+        static inline float encode(float value) {
+            return value;
+        }
+    };
+
+    class MappedHalfTensor : public BaseMappedTensor<half, MappedHalfTensor> {
+    public:
+        explicit MappedHalfTensor(const string &path, bool writable = false,
+                                  MappedAccess access = MappedAccess::normal)
+                : BaseMappedTensor(path, writable, access, MappedTensorEncoding::half16) {
+        }
+
+        void printMaterializationPlan() override {
+            cout << "MappedHalfTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        static inline float decode(half value) {
+            return halfToFloat(value);
+        }
+
+        static inline half encode(float value) {
+            return floatToHalf(value);
+        }
+    };
+
+    class MappedQuarterTensor : public BaseMappedTensor<quarter, MappedQuarterTensor> {
+    public:
+        explicit MappedQuarterTensor(const string &path, bool writable = false,
+                                     MappedAccess access = MappedAccess::normal)
+                : BaseMappedTensor(path, writable, access, MappedTensorEncoding::quarter8) {
+            bias = header.bias;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "MappedQuarterTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        [[nodiscard]] int getBias() const {
+            return bias;
+        }
+
+        [[nodiscard]] inline float decode(quarter value) const {
+            return quarterToFloat(value, bias);
+        }
+
+        [[nodiscard]] inline quarter encode(float value) const {
+            return floatToQuarter(value, bias);
+        }
+
+    private:
+        int bias;
+    };
+
+    inline MappedTensorHeader makeMappedTensorHeader(size_t rows, size_t columns, size_t channels,
+                                                     MappedTensorEncoding encoding, int bias) {
+        MappedTensorHeader header{};
+        std::memcpy(header.magic, MAPPED_TENSOR_MAGIC, sizeof(MAPPED_TENSOR_MAGIC));
+        header.endianMarker = MAPPED_TENSOR_ENDIAN_MARKER;
+        header.version = MAPPED_TENSOR_VERSION;
+        header.encoding = (uint32_t) encoding;
+        header.bias = bias;
+        header.channels = channels;
+        header.rows = rows;
+        header.columns = columns;
+        return header;
+    }
+
+    inline size_t mappedTensorValueBytes(MappedTensorEncoding encoding) {
+        switch (encoding) {
+            case MappedTensorEncoding::float32:
+                return sizeof(float);
+            case MappedTensorEncoding::half16:
+                return sizeof(half);
+            case MappedTensorEncoding::quarter8:
+                return sizeof(quarter);
+        }
+        throw exception("Unknown mapped tensor encoding.");
+    }
+
+    // Makes a mapped tensor file of the given shape without writing any values. They all read as zero until
+    // they're written. On most file systems the file doesn't take up any disk space until then, either.
+    // Open it with writable set to true to fill it in.
+    inline void createMappedTensorFile(const string &path, size_t rows, size_t columns, size_t channels,
+                                       MappedTensorEncoding encoding = MappedTensorEncoding::float32, int bias = 0) {
+        ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!stream.is_open()) {
+            throw exception("Unable to open file to create mapped tensor.");
+        }
+        const auto header = makeMappedTensorHeader(rows, columns, channels, encoding, bias);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const size_t value_bytes = rows * columns * channels * mappedTensorValueBytes(encoding);
+        if (value_bytes > 0) {
+            stream.seekp((streamoff) (sizeof(header) + value_bytes - 1));
+            stream.put(0);
+        }
+        stream.close();
+        if (stream.fail()) {
+            throw exception("Unable to create mapped tensor.");
+        }
+    }
+
+    // Writes a tensor in the mapped tensor format. The bias is only used for 8-bit (quarter) encoding.
+    // To make a writable mapping for weights, save the initial weights with this, then open the file with
+    // writable set to true.
+    inline void saveMappedTensor(const shared_ptr<BaseTensor> &tensor, const string &path,
+                                 MappedTensorEncoding encoding = MappedTensorEncoding::float32, int bias = 0) {
+        ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!stream.is_open()) {
+            throw exception("Unable to open file to save mapped tensor.");
+        }
+        const auto header = makeMappedTensorHeader(tensor->rowCount(), tensor->columnCount(),
+                                                   tensor->channelCount(), encoding, bias);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        const size_t columns = header.columns;
+        RowScratch rowValues(columns);
+        const float *values = rowValues.data();
+        vector<half> halfRow(encoding == MappedTensorEncoding::half16 ? columns : 0);
+        vector<quarter> quarterRow(encoding == MappedTensorEncoding::quarter8 ? columns : 0);
+        for (size_t channel = 0; channel < header.channels; channel++) {
+            for (size_t row = 0; row < header.rows; row++) {
+                tensor->readRow(row, channel, 0, columns, rowValues.data());
+                if (encoding == MappedTensorEncoding::float32) {
+                    stream.write(reinterpret_cast<const char *>(values), (streamsize) (columns * sizeof(float)));
+                } else if (encoding == MappedTensorEncoding::half16) {
+                    for (size_t column = 0; column < columns; column++) {
+                        halfRow[column] = floatToHalf(values[column]);
+                    }
+                    stream.write(reinterpret_cast<const char *>(halfRow.data()),
+                                 (streamsize) (columns * sizeof(half)));
+                } else {
+                    for (size_t column = 0; column < columns; column++) {
+                        quarterRow[column] = floatToQuarter(values[column], bias);
+                    }
+                    stream.write(reinterpret_cast<const char *>(quarterRow.data()),
+                                 (streamsize) (columns * sizeof(quarter)));
+                }
+            }
+        }
+        stream.close();
+    }
+
+    // Opens any mapped tensor file, picking the tensor class that matches what the file holds.
+    inline shared_ptr<BaseTensor> loadMappedTensor(const string &path, bool writable = false,
+                                                   MappedAccess access = MappedAccess::normal) {
+        MappedTensorHeader header{};
+        if (!readMappedTensorHeader(path, header)) {
+            throw exception("File is not a mapped tensor.");
+        }
+        switch ((MappedTensorEncoding) header.encoding) {
+            case MappedTensorEncoding::float32:
+                return make_shared<MappedFullTensor>(path, writable, access);
+            case MappedTensorEncoding::half16:
+                return make_shared<MappedHalfTensor>(path, writable, access);
+            case MappedTensorEncoding::quarter8:
+                return make_shared<MappedQuarterTensor>(path, writable, access);
+        }
+        throw exception("Unknown mapped tensor encoding.");
+    }
+}
+
+#endif //HAPPYML_MAPPED_TENSORS_HPP
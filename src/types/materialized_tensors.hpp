@@ -12,9 +12,18 @@
 #include <utility>
 #include <vector>
 #include <iomanip>
+#include <new>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <thread>
+#include <type_traits>
 #include "quarter_float.hpp"
 #include "half_float.hpp"
 #include "tensor.hpp"
+#include "tensor_codecs.hpp"
+#include "tensor_fusion.hpp"
 #include "../util/portable_bytes.hpp"
 
 using namespace std;
@@ -29,11 +38,16 @@ using namespace std;
 //  functions that do operations on the vectors. These functions wouldn't be part of a specific class, instead
 //  they would just be standard functions that multiple classes could use. There would be some amount of repetition
 //  but far less than there is today.
+// UPDATE: The conversions turned out to be easy to inline once they moved into small codec structs
+//  (tensor_codecs.hpp) that DenseTensor takes as a template parameter. FullTensor, PixelTensor, QuarterTensor and
+//  HalfTensor are now thin subclasses of DenseTensor that only supply the codec and their constructors.
 namespace happyml {
     // TODO: create a "solid-state" tensor, where instead of being in memory, use disk and mem-map it as needed.
     //  My c++ is rusty, so I need to dig into how this is done at some point. I know it is possible, but there
     //  may be crazy OS-specific requirements or other such nonsense to work through that isn't important to tackle
     //  at this exact moment.
+    //  UPDATE: See mapped_tensors.hpp. MappedFullTensor, MappedHalfTensor and MappedQuarterTensor map a file
+    //  written by saveMappedTensor(), and the OS-specific nonsense lives in util/memory_mapped_file.hpp.
 
     // TODO: is there a way to create a tensor backed by GPU memory? my whole approach is driven by optimizing for
     //  CPU and regular memory. I mean, I can think of ways of putting the tensors in GPU memory, but operations
@@ -62,248 +76,261 @@ namespace happyml {
     //  the original tensor could be overwritten, but I don't think this would be safe or reliable. I think the
     //  explicit instruction to reuse memory is still the best option.
 
-    template<typename T>
-    void allocateTensorVector(vector<vector<vector<T>>> &data, const size_t rows, const size_t columns,
-                              const size_t channels) {
-        // I wouldn't expect memory allocation in parallel to be faster than serial allocation, especially on this
-        // scale, since there would be a lot of lock contention. I did a quick experiment and found the timings
-        // weren't better or worse with small sizes. More experiments are needed, but it's not worth much time
-        // at this moment since I'm skeptical it would help.
-        data.resize(channels);
-        // #pragma omp for
-        for (size_t channel = 0; channel < channels; channel++) {
-            data.at(channel).resize(rows);
-            // omp for is roughly 5-10% slower here.
-            // #pragma omp for
-            for (size_t row = 0; row < rows; row++) {
-                data.at(channel).at(row).resize(columns);
-            }
-        }
-    }
+    // Every materialized tensor keeps its values in a single allocation laid out as channel -> row -> column.
+    // I originally used vectors of vectors of vectors to avoid one huge allocation, but every read paid for three
+    // bounds checks and three pointer hops, and rows ended up scattered all over the heap. One block with known
+    // strides is friendlier to the cpu cache and lets kernels walk the raw memory without a virtual call per element.
+    // The block is aligned to a cache line and comes from the TensorArena, so the short-lived tensors built
+    // during every training step reuse the blocks freed by the last step instead of going back to the heap.
 
-    // This is roughly 10% slower than the copy-and-pasted code. That's a huge hit. I'm leaving
-    // this here, in case I can think of a way to improve on this.
-    // Example usage:
-    //            allocateTensorVector<float>(data, rows,
-    //                                        columns,
-    //                                        channels,
-    //                                        original,
-    //                                        [](float original) {return original;});
     template<typename T>
-    void allocateTensorVector(vector<vector<vector<T>>> &data,
-                              const size_t rows, const size_t columns, const size_t channels,
-                              const shared_ptr<BaseTensor> &original,
-                              function<T(float)> conversionFunction) {
-        allocateTensorVector<T>(data, rows,
-                                columns,
-                                channels);
-
-#pragma omp for collapse(3)
-        for (size_t channel = 0; channel < channels; channel++) {
-            for (size_t row = 0; row < rows; row++) {
-                for (size_t column = 0; column < columns; column++) {
-                    data.at(channel).at(row).at(column) = conversionFunction(original->getValue(row, column, channel));
-                }
-            }
+    class AlignedTensorData {
+    public:
+        AlignedTensorData() : rows(0), columns(0), channels(0), elementsPerChannel(0), values(nullptr) {
         }
-    }
 
-// The full tensor is backed by a 32-bit float. This exists because our input into our models may
-// require accurate representations, and I don't think they'll ever be too big to fit in memory.
-// There may also be final dense layers that have few enough neurons feeding it that a full tensor
-// may work.
-    class FullTensor : public BaseAssignableTensor {
-    public:
-        explicit FullTensor(const shared_ptr<BaseTensor> &original) {
-            const size_t columns = original->columnCount();
-            const size_t rows = original->rowCount();
-            const size_t channels = original->channelCount();
+        AlignedTensorData(const AlignedTensorData &) = delete;
 
-            allocateTensorVector<float>(data, rows,
-                                        columns,
-                                        channels);
+        AlignedTensorData &operator=(const AlignedTensorData &) = delete;
 
-#pragma omp for collapse(3)
-            for (size_t channel = 0; channel < channels; channel++) {
-                for (size_t row = 0; row < rows; row++) {
-                    for (size_t col = 0; col < columns; col++) {
-                        setVal(row, col, channel, original->getValue(row, col, channel));
-                    }
-                }
-            }
+        ~AlignedTensorData() {
+            release();
         }
 
-        explicit FullTensor(const vector<float> &values) {
-            allocateTensorVector<float>(data, 1, values.size(), 1);
-            size_t col = 0;
-            for (float const &val: values) {
-                setVal(0, col, 0, val);
-                col++;
+        void allocate(const size_t newRows, const size_t newColumns, const size_t newChannels) {
+            release();
+            rows = newRows;
+            columns = newColumns;
+            channels = newChannels;
+            elementsPerChannel = rows * columns;
+            const size_t elements = elementsPerChannel * channels;
+            if (elements > 0) {
+                values = static_cast<T *>(TensorArena::instance().allocate(elements * sizeof(T)));
             }
         }
 
-        // get a weird warning here that CLion can't resolve constructor. I believe this is a bug with CLion itself:
-        // https://youtrack.jetbrains.com/issue/CPP-24510/Bad-detection-of-Constructor-is-not-implemented
-        explicit FullTensor(const vector<vector<vector<float>>> &values) {
-            allocateTensorVector<float>(data, values[0].size(), values[0][0].size(), values.size());
-            // TODO: this could be made parallel, but we'd have to index rather than use iterator
-            size_t channel_index = 0;
-            for (const vector<vector<float>> &next_channel: values) {
-                size_t row_index = 0;
-                for (const vector<float> &next_row: next_channel) {
-                    size_t col_index = 0;
-                    for (float val: next_row) {
-                        setVal(row_index, col_index, channel_index, val);
-                        col_index++;
-                    }
-                    row_index++;
-                }
-                channel_index++;
-            }
+        inline T *data() {
+            return values;
         }
 
-        explicit FullTensor(const string &fileName) {
-            try {
-                ifstream stream;
-                stream.open(fileName, ifstream::in | ios::binary);
-                assignFromStream(stream);
-                stream.close();
-            } catch (ofstream::failure &e) {
-                cerr << "Failed to load: " << fileName << endl << e.what() << endl;
-                throw e;
-            }
+        inline T *rowData(const size_t row, const size_t channel) {
+            return values + (channel * elementsPerChannel) + (row * columns);
         }
 
-        explicit FullTensor(ifstream &stream) {
-            assignFromStream(stream);
+        inline T &at(const size_t row, const size_t column, const size_t channel) {
+            return values[(channel * elementsPerChannel) + (row * columns) + column];
         }
 
-        size_t channelCount() override {
-            return data.size();
+        [[nodiscard]] inline size_t rowCount() const {
+            return rows;
         }
 
-        size_t rowCount() override {
-            if (data.empty()) {
-                return 0;
-            }
-            return data[0].size();
+        [[nodiscard]] inline size_t columnCount() const {
+            return columns;
         }
 
-        size_t columnCount() override {
-            if (data.empty() || data[0].empty()) {
-                return 0;
-            }
-            return data[0][0].size();
+        [[nodiscard]] inline size_t channelCount() const {
+            return channels;
         }
 
-        float getValue(size_t row, size_t column, size_t channel) override {
-            return data.at(channel).at(row).at(column);
+        // number of elements between the start of one row and the start of the next
+        [[nodiscard]] inline size_t rowStride() const {
+            return columns;
         }
 
-        void printMaterializationPlan() override {
-            cout << "FullTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        // number of elements between the start of one channel and the start of the next
+        [[nodiscard]] inline size_t channelStride() const {
+            return elementsPerChannel;
         }
 
     private:
-        vector<vector<vector<float>>> data;
+        size_t rows;
+        size_t columns;
+        size_t channels;
+        size_t elementsPerChannel;
+        T *values;
+
+        void release() {
+            if (values) {
+                TensorArena::instance().release(values, elementsPerChannel * channels * sizeof(T));
+                values = nullptr;
+            }
+        }
+    };
 
-        void assignFromStream(ifstream &stream) {
-            uint64_t channels;
-            uint64_t rows;
-            uint64_t columns;
-
-            stream.read(reinterpret_cast<char *>(&channels), sizeof(channels));
-            channels = portableBytes(channels);
-            stream.read(reinterpret_cast<char *>(&rows), sizeof(rows));
-            rows = portableBytes(rows);
-            stream.read(reinterpret_cast<char *>(&columns), sizeof(columns));
-            columns = portableBytes(columns);
-
-            data.resize(channels);
+    // reads the header shared by all tensor files and allocates room for the values that follow it.
+    template<typename T>
+    void allocateFromStreamHeader(ifstream &stream, AlignedTensorData<T> &data) {
+        uint64_t channels;
+        uint64_t rows;
+        uint64_t columns;
+
+        stream.read(reinterpret_cast<char *>(&channels), sizeof(channels));
+        channels = portableBytes(channels);
+        stream.read(reinterpret_cast<char *>(&rows), sizeof(rows));
+        rows = portableBytes(rows);
+        stream.read(reinterpret_cast<char *>(&columns), sizeof(columns));
+        columns = portableBytes(columns);
+
+        data.allocate(rows, columns, channels);
+    }
+
+    // Materializing a big view is usually the most expensive thing we do, and every element can be computed
+    // independently, so we split each channel into tiles and read them on separate threads. The tensor tells us
+    // (through readRowsInParallel) whether it would rather be split into bands of rows or bands of columns.
+    // A transposed view, for example, reads its child's columns, so splitting it by column keeps each thread
+    // reading whole child rows. Small tensors aren't worth the overhead of a thread and are read in one go.
+    constexpr size_t PARALLEL_MATERIALIZE_THRESHOLD = 1 << 16;
+    // We don't want to hand a thread less work than this, even if it means some threads sit idle.
+    constexpr size_t MIN_PARALLEL_TILE_ELEMENTS = 1 << 13;
+    // Encoded tensors can't have a view write floats straight into their memory, so they read a tile
+    // into a float buffer first. This caps the size of that buffer.
+    constexpr size_t MATERIALIZE_BLOCK_ELEMENTS = 1 << 16;
+
+    // Calls task(firstRow, rows, firstColumn, columns, channel) for tiles covering the whole tensor,
+    // in parallel when the tensor is big enough. No tile will have more than maxTileElements elements
+    // (unless a single row or column is bigger than that.)
+    template<typename TileTask>
+    void forEachMaterializationTile(const shared_ptr<BaseTensor> &original, size_t maxTileElements, TileTask task) {
+        const size_t columns = original->columnCount();
+        const size_t rows = original->rowCount();
+        const size_t channels = original->channelCount();
+        if (columns == 0 || rows == 0 || channels == 0) {
+            return;
+        }
+        const bool by_rows = original->readRowsInParallel();
+        const size_t span = by_rows ? rows : columns;
+        const size_t cross = by_rows ? columns : rows;
+        const size_t threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+        const bool parallel = threads > 1 && (rows * columns * channels) >= PARALLEL_MATERIALIZE_THRESHOLD;
+        size_t chunk = span;
+        if (parallel) {
+            // a few tiles per thread evens out tiles that take longer than others.
+            const size_t target_tiles = std::max((size_t) 1, (threads * 4) / channels);
+            chunk = (span + target_tiles - 1) / target_tiles;
+            chunk = std::max(chunk, (MIN_PARALLEL_TILE_ELEMENTS + cross - 1) / cross);
+        }
+        chunk = std::max((size_t) 1, std::min(chunk, maxTileElements / cross));
+        auto run_tile = [&task, by_rows, rows, columns](size_t channel, size_t first, size_t count) {
+            if (by_rows) {
+                task(first, count, (size_t) 0, columns, channel);
+            } else {
+                task((size_t) 0, rows, first, count, channel);
+            }
+        };
+        if (!parallel || (chunk >= span && channels == 1)) {
             for (size_t channel = 0; channel < channels; channel++) {
-                data.at(channel).resize(rows);
-                for (size_t row = 0; row < rows; row++) {
-                    data.at(channel).at(row).resize(columns);
-                    for (size_t column = 0; column < columns; column++) {
-                        uint32_t val;
-                        stream.read(reinterpret_cast<char *>(&val), sizeof(val));
-                        val = portableBytes(val);
-                        float nextVal = *(float *) &val;
-                        setVal(row, column, channel, nextVal);
-                    }
+                for (size_t first = 0; first < span; first += chunk) {
+                    run_tile(channel, first, std::min(chunk, span - first));
                 }
             }
+            return;
         }
-
-        inline void setVal(size_t row, size_t column, size_t channel, float val) {
-            data.at(channel).at(row).at(column) = val;
+        queue<future<void>> futures;
+        for (size_t channel = 0; channel < channels; channel++) {
+            for (size_t first = 0; first < span; first += chunk) {
+                futures.push(std::async(std::launch::async, run_tile, channel, first, std::min(chunk, span - first)));
+                if (futures.size() >= threads) {
+                    futures.front().get();
+                    futures.pop();
+                }
+            }
         }
-    };
-
+        while (!futures.empty()) {
+            futures.front().get();
+            futures.pop();
+        }
+    }
 
-// TODO: Okay, so I clearly need another layer of abstraction or to template the BaseAssignableTensor, but
-//  that'll be another day.
-// Pixel Tensor holds a value between 0.0f and 1.0f with an even distribution in 256 increments (8-bits.)
-// This is a compact representation useful for images, but also for other data that has an evenly distributed
-// range of values between 0 and 1 with a similar granularity.
-// The quarter tensor with a bias of 14 is capable of a similar representation, but the distribution of values isn't
-// even. This Tensor is also faster than the quarter tensor because far less math needs to happen to map between
-// float and 8-bits.
-    class PixelTensor : public BaseAssignableTensor {
-    public:
+    // Reads tiles through the fused evaluator into a float buffer and hands each one to consumer, which
+    // encodes the values into whatever representation the tensor uses.
+    template<typename TileConsumer>
+    void readEncodedTiles(const shared_ptr<BaseTensor> &original, TileConsumer consumer) {
+        forEachMaterializationTile(original, MATERIALIZE_BLOCK_ELEMENTS,
+                                   [&original, &consumer](size_t firstRow, size_t rows, size_t firstColumn,
+                                                          size_t columns, size_t channel) {
+                                       ArenaBuffer<float> values(rows * columns);
+                                       readTileFused(original, firstRow, rows, firstColumn, columns, channel,
+                                                     values.data(), columns);
+                                       for (size_t row = 0; row < rows; row++) {
+                                           consumer(firstRow + row, firstColumn, columns, channel,
+                                                    values.data() + (row * columns));
+                                       }
+                                   });
+    }
 
-        explicit PixelTensor(const shared_ptr<BaseTensor> &original) {
-            const size_t columns = original->columnCount();
-            const size_t rows = original->rowCount();
-            const size_t channels = original->channelCount();
+    template<typename Codec>
+    class DenseTensor;
 
-            allocateTensorVector<::uint8_t>(data, rows,
-                                            columns,
-                                            channels);
+    template<typename Visitor>
+    bool visitDenseTensor(const shared_ptr<BaseTensor> &tensor, Visitor &&visitor);
 
+    // Every materialized tensor that lives in memory is a DenseTensor. The only thing that differs between them
+    // is how a value is stored, which the Codec decides at compile time (see tensor_codecs.hpp.) Reading a row
+    // is one virtual call, and then a loop with the conversion inlined into it.
+    //
+    // Kernels that want to skip virtual calls entirely can use visitDenseTensor() to find out the concrete type
+    // once, then call valueAt() and rowValues(), which aren't virtual.
+    template<typename Codec>
+    class DenseTensor : public BaseAssignableTensor {
+    public:
+        using stored_type = typename Codec::stored_type;
 
-#pragma omp for collapse(3)
-            for (size_t channel = 0; channel < channels; channel++) {
-                for (size_t row = 0; row < rows; row++) {
-                    for (size_t col = 0; col < columns; col++) {
-                        setVal(row, col, channel, original->getValue(row, col, channel));
-                    }
-                }
+        DenseTensor(const shared_ptr<BaseTensor> &original, const Codec &codec) : codec(codec) {
+            storage.allocate(original->rowCount(), original->columnCount(), original->channelCount());
+            // another dense tensor can be converted a row at a time without any virtual calls.
+            if (visitDenseTensor(original, [this](auto &other) { this->copyFromDense(other); })) {
+                return;
+            }
+            if constexpr (is_same<Codec, FloatCodec>::value) {
+                // float rows have the same layout in the view and in our buffer, so the view can write directly
+                // into it. Asking for big tiles lets views like dot product work on a block at a time.
+                forEachMaterializationTile(original, SIZE_MAX,
+                                           [this, &original](size_t firstRow, size_t rows, size_t firstColumn,
+                                                             size_t columns, size_t channel) {
+                                               readTileFused(original, firstRow, rows, firstColumn, columns,
+                                                             channel, storage.rowData(firstRow, channel) +
+                                                                      firstColumn, storage.rowStride());
+                                           });
+            } else {
+                readEncodedTiles(original, [this](size_t row, size_t firstColumn, size_t columns, size_t channel,
+                                                  const float *values) {
+                    encodeValues(this->codec, values, columns, storage.rowData(row, channel) + firstColumn);
+                });
             }
         }
 
-        // If you use this constructor, you've already wasted a lot of memory.
-        // Maybe you can just use a full tensor?
-        explicit PixelTensor(const vector<float> &values) {
-            allocateTensorVector<::uint8_t>(data, 1, values.size(), 1);
-            size_t col = 0;
-            for (float const &val: values) {
-                setVal(0, col, 0, val);
-                col++;
+        // Values start out undefined. Kernels that produce a whole tensor at once write them through data().
+        DenseTensor(size_t rows, size_t columns, size_t channels, const Codec &codec) : codec(codec) {
+            storage.allocate(rows, columns, channels);
+        }
+
+        // a single row
+        DenseTensor(const vector<float> &values, const Codec &codec) : codec(codec) {
+            storage.allocate(1, values.size(), 1);
+            encodeValues(codec, values.data(), values.size(), storage.data());
+        }
+
+        // rows of a single channel
+        DenseTensor(const vector<vector<float>> &values, const Codec &codec) : codec(codec) {
+            storage.allocate(values.size(), values.at(0).size(), 1);
+            for (size_t row = 0; row < values.size(); row++) {
+                encodeValues(codec, values[row].data(), storage.columnCount(), storage.rowData(row, 0));
             }
         }
 
-        // see the note by FullTensor about the CLion warning bug.
-        // If you use this constructor, you've already wasted a lot of memory.
-        // Maybe you can just use a full tensor?
-        explicit PixelTensor(const vector<vector<vector<float>>> &values) {
-            allocateTensorVector<::uint8_t>(data, values[0].size(), values[0][0].size(), values.size());
-            size_t channel_index = 0;
-            for (const auto &next_channel: values) {
-                size_t row_index = 0;
-                for (const auto &next_row: next_channel) {
-                    size_t col_index = 0;
-                    for (float val: next_row) {
-                        setVal(row_index, col_index, channel_index, val);
-                        col_index++;
-                    }
-                    row_index++;
+        // channels of rows
+        DenseTensor(const vector<vector<vector<float>>> &values, const Codec &codec) : codec(codec) {
+            storage.allocate(values[0].size(), values[0][0].size(), values.size());
+            for (size_t channel = 0; channel < values.size(); channel++) {
+                for (size_t row = 0; row < values[channel].size(); row++) {
+                    encodeValues(codec, values[channel][row].data(), storage.columnCount(),
+                                 storage.rowData(row, channel));
                 }
-                channel_index++;
             }
         }
 
-        explicit PixelTensor(const string &fileName) {
+        DenseTensor(const string &fileName, const Codec &codec) : codec(codec) {
             try {
                 ifstream stream;
                 stream.open(fileName, ifstream::in | ios::binary);
@@ -315,325 +342,322 @@ namespace happyml {
             }
         }
 
-        explicit PixelTensor(ifstream &stream) {
+        DenseTensor(ifstream &stream, const Codec &codec) : codec(codec) {
             assignFromStream(stream);
         }
 
         size_t channelCount() override {
-            return data.size();
+            return storage.channelCount();
         }
 
         size_t rowCount() override {
-            if (data.empty()) {
-                return 0;
-            }
-            return data[0].size();
+            return storage.rowCount();
         }
 
         size_t columnCount() override {
-            if (data.empty() || data[0].empty()) {
-                return 0;
-            }
-            return data[0][0].size();
+            return storage.columnCount();
         }
 
         float getValue(size_t row, size_t column, size_t channel) override {
-            return ((float) data.at(channel).at(row).at(column)) / 255.f;
+            return codec.decode(storage.at(row, column, channel));
         }
 
-        void printMaterializationPlan() override {
-            cout << "PixelTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            decodeValues(codec, storage.rowData(row, channel) + firstColumn, count, out);
         }
 
-    private:
-        vector<vector<vector<uint8_t>>> data;
-
-        void assignFromStream(ifstream &stream) {
-            uint64_t channels;
-            uint64_t rows;
-            uint64_t columns;
-
-            stream.read(reinterpret_cast<char *>(&channels), sizeof(channels));
-            channels = portableBytes(channels);
-            stream.read(reinterpret_cast<char *>(&rows), sizeof(rows));
-            rows = portableBytes(rows);
-            stream.read(reinterpret_cast<char *>(&columns), sizeof(columns));
-            columns = portableBytes(columns);
-
-            data.resize(channels);
-            for (size_t channel = 0; channel < channels; channel++) {
-                data.at(channel).resize(rows);
-                for (size_t row = 0; row < rows; row++) {
-                    data.at(channel).at(row).resize(columns);
-                    for (size_t column = 0; column < columns; column++) {
-                        uint32_t val;
-                        stream.read(reinterpret_cast<char *>(&val), sizeof(val));
-                        val = portableBytes(val);
-                        float nextVal = *(float *) &val;
-                        setVal(row, column, channel, nextVal);
-                    }
-                }
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            for (size_t row = 0; row < rows; row++) {
+                decodeValues(codec, storage.rowData(firstRow + row, channel) + firstColumn, columns,
+                             out + (row * outRowStride));
             }
         }
 
-        inline void setVal(size_t row, size_t column, size_t channel, float val) {
-            data.at(channel).at(row).at(column) = (uint8_t) (std::max(0.0f, std::min(val, 1.0f)) * 255);
-        }
-    };
-
-    class QuarterTensor : public BaseAssignableTensor {
-    public:
-        explicit QuarterTensor(const shared_ptr<BaseTensor> &original, const int bias) {
-            this->bias = bias;
-            const size_t columns = original->columnCount();
-            const size_t rows = original->rowCount();
-            const size_t channels = original->channelCount();
-
-            allocateTensorVector<quarter>(data, rows,
-                                          columns,
-                                          channels);
-
-#pragma omp for collapse(3)
-            for (size_t channel = 0; channel < channels; channel++) {
-                for (size_t row = 0; row < rows; row++) {
-                    for (size_t col = 0; col < columns; col++) {
-                        setVal(row, col, channel, original->getValue(row, col, channel));
-                    }
-                }
+        bool bufferLayout(TensorBufferLayout &layout) override {
+            if constexpr (is_same<Codec, FloatCodec>::value) {
+                layout.data = storage.data();
+                layout.rowStride = storage.rowStride();
+                layout.columnStride = 1;
+                layout.channelStride = storage.channelStride();
+                return true;
+            } else {
+                return false;
             }
         }
 
-        QuarterTensor(const vector<float> &values, const int bias) {
-            this->bias = bias;
-            allocateTensorVector<quarter>(data, 1, values.size(), 1);
-            size_t col = 0;
-            for (float const &val: values) {
-                setVal(0, col, 0, val);
-                col++;
-            }
+        void printMaterializationPlan() override {
+            cout << "DenseTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
         }
 
-        QuarterTensor(const vector<vector<float>> &values, const int bias) {
-            this->bias = bias;
-            allocateTensorVector<quarter>(data, values.size(), values.at(0).size(), 1);
-            for (size_t row = 0; row < values.size(); row++) {
-                for (size_t col = 0; col < values[row].size(); col++) {
-                    const float val = values.at(row).at(col);
-                    setVal(row, col, 0, val);
-                }
-            }
+        // Raw access for kernels that want to skip virtual dispatch. Values are laid out channel -> row -> column,
+        // so element (row, column, channel) lives at data()[channel * channelStride() + row * rowStride() + column].
+        stored_type *data() {
+            return storage.data();
         }
 
-        explicit QuarterTensor(const string &fileName, const int bias) {
-            this->bias = bias;
-            try {
-                ifstream stream;
-                stream.open(fileName, ifstream::in | ios::binary);
-                assignFromStream(stream);
-                stream.close();
-            } catch (ofstream::failure &e) {
-                cerr << "Failed to load: " << fileName << endl << e.what() << endl;
-                throw e;
-            }
+        [[nodiscard]] size_t rowStride() const {
+            return storage.rowStride();
         }
 
-        explicit QuarterTensor(ifstream &stream, const int bias) {
-            this->bias = bias;
-            assignFromStream(stream);
+        [[nodiscard]] size_t channelStride() const {
+            return storage.channelStride();
         }
 
-        size_t channelCount() override {
-            return data.size();
+        [[nodiscard]] const Codec &getCodec() const {
+            return codec;
         }
 
-        size_t rowCount() override {
-            if (data.empty()) {
-                return 0;
-            }
-            return data[0].size();
+        inline float valueAt(size_t row, size_t column, size_t channel) {
+            return codec.decode(storage.at(row, column, channel));
         }
 
-        size_t columnCount() override {
-            if (data.empty() || data[0].empty()) {
-                return 0;
-            }
-            return data[0][0].size();
+        inline stored_type *rowValues(size_t row, size_t channel) {
+            return storage.rowData(row, channel);
         }
 
-        float getValue(size_t row, size_t column, size_t channel) override {
-            return quarterToFloat(data.at(channel).at(row).at(column), bias);
-        }
+    protected:
+        AlignedTensorData<stored_type> storage;
+        Codec codec;
 
-        [[nodiscard]] int get_bias() const {
-            return bias;
+        void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *values) override {
+            encodeValues(codec, values, count, storage.rowData(row, channel) + firstColumn);
         }
 
-
-        void printMaterializationPlan() override {
-            cout << "QuarterTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        void writeFrom(const shared_ptr<BaseTensor> &source) override {
+            if constexpr (is_same<Codec, FloatCodec>::value) {
+                // the same direct tile reads the constructor does.
+                forEachMaterializationTile(source, SIZE_MAX,
+                                           [this, &source](size_t firstRow, size_t rows, size_t firstColumn,
+                                                           size_t columns, size_t channel) {
+                                               readTileFused(source, firstRow, rows, firstColumn, columns, channel,
+                                                             storage.rowData(firstRow, channel) + firstColumn,
+                                                             storage.rowStride());
+                                           });
+            } else {
+                BaseAssignableTensor::writeFrom(source);
+            }
         }
 
-    private:
-        vector<vector<vector<quarter>>> data;
-        int bias;
+        template<typename OtherCodec>
+        void copyFromDense(DenseTensor<OtherCodec> &other) {
+            const size_t columns = storage.columnCount();
+            RowScratch row_values(columns);
+            for (size_t channel = 0; channel < storage.channelCount(); channel++) {
+                for (size_t row = 0; row < storage.rowCount(); row++) {
+                    if constexpr (is_same<Codec, OtherCodec>::value && !is_same<Codec, QuarterCodec>::value) {
+                        std::memcpy(storage.rowData(row, channel), other.rowValues(row, channel),
+                                    columns * sizeof(stored_type));
+                    } else {
+                        decodeValues(other.getCodec(), other.rowValues(row, channel), columns, row_values.data());
+                        encodeValues(codec, row_values.data(), columns, storage.rowData(row, channel));
+                    }
+                }
+            }
+        }
 
+        // Files always hold 32-bit floats, whatever we keep in memory.
         void assignFromStream(ifstream &stream) {
-            uint64_t channels;
-            uint64_t rows;
-            uint64_t columns;
-
-            stream.read(reinterpret_cast<char *>(&channels), sizeof(channels));
-            channels = portableBytes(channels);
-            stream.read(reinterpret_cast<char *>(&rows), sizeof(rows));
-            rows = portableBytes(rows);
-            stream.read(reinterpret_cast<char *>(&columns), sizeof(columns));
-            columns = portableBytes(columns);
-
-            data.resize(channels);
+            allocateFromStreamHeader(stream, storage);
+            const size_t channels = storage.channelCount();
+            const size_t rows = storage.rowCount();
+            const size_t columns = storage.columnCount();
+            RowScratch row_values(columns);
+            float *values = row_values.data();
             for (size_t channel = 0; channel < channels; channel++) {
-                data.at(channel).resize(rows);
                 for (size_t row = 0; row < rows; row++) {
-                    data.at(channel).at(row).resize(columns);
+                    stream.read(reinterpret_cast<char *>(values), (streamsize) (columns * sizeof(uint32_t)));
                     for (size_t column = 0; column < columns; column++) {
                         uint32_t val;
-                        stream.read(reinterpret_cast<char *>(&val), sizeof(val));
+                        std::memcpy(&val, values + column, sizeof(val));
                         val = portableBytes(val);
-                        float nextVal = *(float *) &val;
-                        setVal(row, column, channel, nextVal);
+                        std::memcpy(values + column, &val, sizeof(val));
                     }
+                    encodeValues(codec, values, columns, storage.rowData(row, channel));
                 }
             }
         }
+    };
+
+    // Calls visitor with the tensor as its concrete DenseTensor type and returns true, or returns false if the
+    // tensor isn't a DenseTensor. The visitor is usually a generic lambda, so its loops get compiled once for
+    // each codec, with the decoding inlined.
+    template<typename Visitor>
+    bool visitDenseTensor(const shared_ptr<BaseTensor> &tensor, Visitor &&visitor) {
+        BaseTensor *pointer = tensor.get();
+        if (auto full = dynamic_cast<DenseTensor<FloatCodec> *>(pointer)) {
+            visitor(*full);
+        } else if (auto half_tensor = dynamic_cast<DenseTensor<HalfCodec> *>(pointer)) {
+            visitor(*half_tensor);
+        } else if (auto quarter_tensor = dynamic_cast<DenseTensor<QuarterCodec> *>(pointer)) {
+            visitor(*quarter_tensor);
+        } else if (auto pixel = dynamic_cast<DenseTensor<PixelCodec> *>(pointer)) {
+            visitor(*pixel);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+// The full tensor is backed by a 32-bit float. This exists because our input into our models may
+// require accurate representations, and I don't think they'll ever be too big to fit in memory.
+// There may also be final dense layers that have few enough neurons feeding it that a full tensor
+// may work.
+    class FullTensor : public DenseTensor<FloatCodec> {
+    public:
+        explicit FullTensor(const shared_ptr<BaseTensor> &original) : DenseTensor(original, FloatCodec()) {
+        }
+
+        explicit FullTensor(const vector<float> &values) : DenseTensor(values, FloatCodec()) {
+        }
+
+        FullTensor(size_t rows, size_t columns, size_t channels) : DenseTensor(rows, columns, channels, FloatCodec()) {
+        }
+
+        // get a weird warning here that CLion can't resolve constructor. I believe this is a bug with CLion itself:
+        // https://youtrack.jetbrains.com/issue/CPP-24510/Bad-detection-of-Constructor-is-not-implemented
+        explicit FullTensor(const vector<vector<vector<float>>> &values) : DenseTensor(values, FloatCodec()) {
+        }
+
+        explicit FullTensor(const string &fileName) : DenseTensor(fileName, FloatCodec()) {
+        }
 
-        // Don't assign values directly to a tensor. If you have specific values for specific entries,
-        // use a view like TensorFromFunction to represent it. Chances are, you don't need to allocate
-        // a lot of memory for a full tensor that you will then do other math on. Wait to use memory
-        // for the final result.
-        inline void setVal(size_t row, size_t column, size_t channel, float val) {
-            data.at(channel).at(row).at(column) = floatToQuarter(val, bias);
+        explicit FullTensor(ifstream &stream) : DenseTensor(stream, FloatCodec()) {
+        }
+
+        void printMaterializationPlan() override {
+            cout << "FullTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
         }
     };
 
-    class HalfTensor : public BaseAssignableTensor {
+// Pixel Tensor holds a value between 0.0f and 1.0f with an even distribution in 256 increments (8-bits.)
+// This is a compact representation useful for images, but also for other data that has an evenly distributed
+// range of values between 0 and 1 with a similar granularity.
+// The quarter tensor with a bias of 14 is capable of a similar representation, but the distribution of values isn't
+// even. This Tensor is also faster than the quarter tensor because far less math needs to happen to map between
+// float and 8-bits.
+    class PixelTensor : public DenseTensor<PixelCodec> {
     public:
-        explicit HalfTensor(const shared_ptr<BaseTensor> &original) {
-            const size_t columns = original->columnCount();
-            const size_t rows = original->rowCount();
-            const size_t channels = original->channelCount();
+        explicit PixelTensor(const shared_ptr<BaseTensor> &original) : DenseTensor(original, PixelCodec()) {
+        }
 
-            allocateTensorVector<uint16_t>(data, rows,
-                                           columns,
-                                           channels);
+        // If you use this constructor, you've already wasted a lot of memory.
+        // Maybe you can just use a full tensor?
+        explicit PixelTensor(const vector<float> &values) : DenseTensor(values, PixelCodec()) {
+        }
 
-#pragma omp for collapse(3)
-            for (size_t channel = 0; channel < channels; channel++) {
-                for (size_t row = 0; row < rows; row++) {
-                    for (size_t col = 0; col < columns; col++) {
-                        setVal(row, col, channel, original->getValue(row, col, channel));
-                    }
-                }
-            }
+        // see the note by FullTensor about the CLion warning bug.
+        // If you use this constructor, you've already wasted a lot of memory.
+        // Maybe you can just use a full tensor?
+        explicit PixelTensor(const vector<vector<vector<float>>> &values) : DenseTensor(values, PixelCodec()) {
         }
 
-        explicit HalfTensor(const vector<float> &values) {
-            allocateTensorVector<uint16_t>(data, 1, values.size(), 1);
-            size_t col = 0;
-            for (float const &val: values) {
-                setVal(0, col, 0, val);
-                col++;
-            }
+        explicit PixelTensor(const string &fileName) : DenseTensor(fileName, PixelCodec()) {
         }
 
-        explicit HalfTensor(const vector<vector<float>> &values) {
-            allocateTensorVector<uint16_t>(data, values.size(), values.at(0).size(), 1);
-            for (size_t row = 0; row < values.size(); row++) {
-                for (size_t col = 0; col < values[row].size(); col++) {
-                    const float val = values.at(row).at(col);
-                    setVal(row, col, 0, val);
-                }
-            }
+        explicit PixelTensor(ifstream &stream) : DenseTensor(stream, PixelCodec()) {
         }
 
-        explicit HalfTensor(const string &fileName) {
-            try {
-                ifstream stream;
-                stream.open(fileName, ifstream::in | ios::binary);
-                assignFromStream(stream);
-                stream.close();
-            } catch (ofstream::failure &e) {
-                cerr << "Failed to load: " << fileName << endl << e.what() << endl;
-                throw e;
-            }
+        void printMaterializationPlan() override {
+            cout << "PixelTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
         }
+    };
 
-        explicit HalfTensor(ifstream &stream) {
-            assignFromStream(stream);
+    // The bias is picked for each tensor at runtime (see estimateBias() in tensor_utils.hpp), so it lives in the
+    // codec rather than in the type.
+    class QuarterTensor : public DenseTensor<QuarterCodec> {
+    public:
+        explicit QuarterTensor(const shared_ptr<BaseTensor> &original, const int bias)
+                : DenseTensor(original, QuarterCodec(bias)) {
         }
 
-        size_t channelCount() override {
-            return data.size();
+        QuarterTensor(const vector<float> &values, const int bias) : DenseTensor(values, QuarterCodec(bias)) {
         }
 
-        size_t rowCount() override {
-            if (data.empty()) {
-                return 0;
-            }
-            return data[0].size();
+        QuarterTensor(const vector<vector<float>> &values, const int bias) : DenseTensor(values, QuarterCodec(bias)) {
         }
 
-        size_t columnCount() override {
-            if (data.empty() || data[0].empty()) {
-                return 0;
-            }
-            return data[0][0].size();
+        explicit QuarterTensor(const string &fileName, const int bias) : DenseTensor(fileName, QuarterCodec(bias)) {
         }
 
-        float getValue(size_t row, size_t column, size_t channel) override {
-            return halfToFloat(data.at(channel).at(row).at(column));
+        explicit QuarterTensor(ifstream &stream, const int bias) : DenseTensor(stream, QuarterCodec(bias)) {
+        }
+
+        [[nodiscard]] int get_bias() const {
+            return codec.bias;
         }
 
         void printMaterializationPlan() override {
-            cout << "HalfTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+            cout << "QuarterTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
         }
+    };
 
-    private:
-        vector<vector<vector<half>>> data;
+    class HalfTensor : public DenseTensor<HalfCodec> {
+    public:
+        explicit HalfTensor(const shared_ptr<BaseTensor> &original) : DenseTensor(original, HalfCodec()) {
+        }
 
-        void assignFromStream(ifstream &stream) {
-            uint64_t channels;
-            uint64_t rows;
-            uint64_t columns;
-
-            stream.read(reinterpret_cast<char *>(&channels), sizeof(channels));
-            channels = portableBytes(channels);
-            stream.read(reinterpret_cast<char *>(&rows), sizeof(rows));
-            rows = portableBytes(rows);
-            stream.read(reinterpret_cast<char *>(&columns), sizeof(columns));
-            columns = portableBytes(columns);
-
-            data.resize(channels);
-            for (size_t channel = 0; channel < channels; channel++) {
-                data.at(channel).resize(rows);
-                for (size_t row = 0; row < rows; row++) {
-                    data.at(channel).at(row).resize(columns);
-                    for (size_t column = 0; column < columns; column++) {
-                        uint32_t val;
-                        stream.read(reinterpret_cast<char *>(&val), sizeof(val));
-                        val = portableBytes(val);
-                        float nextVal = *(float *) &val;
-                        setVal(row, column, channel, nextVal);
-                    }
-                }
-            }
+        explicit HalfTensor(const vector<float> &values) : DenseTensor(values, HalfCodec()) {
         }
 
-        // Don't assign values directly to a tensor. If you have specific values for specific entries,
-        // use a view like TensorFromFunction to represent it. Chances are, you don't need to allocate
-        // a lot of memory for a full tensor that you will then do other math on. Wait to use memory
-        // for the final result.
-        inline void setVal(size_t row, size_t column, size_t channel, float val) {
-            data.at(channel).at(row).at(column) = floatToHalf(val);
+        explicit HalfTensor(const vector<vector<float>> &values) : DenseTensor(values, HalfCodec()) {
+        }
+
+        explicit HalfTensor(const string &fileName) : DenseTensor(fileName, HalfCodec()) {
+        }
+
+        explicit HalfTensor(ifstream &stream) : DenseTensor(stream, HalfCodec()) {
+        }
+
+        void printMaterializationPlan() override {
+            cout << "HalfTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
         }
     };
+    inline void BaseAssignableTensor::writeFrom(const shared_ptr<BaseTensor> &source) {
+        readEncodedTiles(source, [this](size_t row, size_t firstColumn, size_t columns, size_t channel,
+                                        const float *values) {
+            writeRow(row, channel, firstColumn, columns, values);
+        });
+    }
+
+    // True when every value of expression is computed from the value at the same position of target, and from
+    // nothing else of target's. Then a tile of the result only needs the same tile of target, which is gone by the
+    // time we overwrite it.
+    inline bool readsOnlyMatchingValues(const shared_ptr<BaseTensor> &expression,
+                                        const shared_ptr<BaseTensor> &target) {
+        if (expression == target || !expression->contains(target)) {
+            return true;
+        }
+        if (auto unary = dynamic_cast<BaseTensorElementwiseUnaryView *>(expression.get())) {
+            return readsOnlyMatchingValues(unary->getChild(), target);
+        }
+        if (auto binary = dynamic_cast<BaseTensorElementwiseBinaryView *>(expression.get())) {
+            return readsOnlyMatchingValues(binary->getChild1(), target) &&
+                   readsOnlyMatchingValues(binary->getChild2(), target);
+        }
+        return false;
+    }
+
+    inline void BaseAssignableTensor::assign(const shared_ptr<BaseTensor> &expression) {
+        if (expression->rowCount() != rowCount() || expression->columnCount() != columnCount() ||
+            expression->channelCount() != channelCount()) {
+            throw exception("Can only assign a tensor of the same shape.");
+        }
+        if (expression.get() == this) {
+            return;
+        }
+        const auto self = shared_from_this();
+        if (!expression->contains(self)) {
+            writeFrom(expression);
+        } else if (readsOnlyMatchingValues(expression, self)) {
+            // each tile is read into a block-sized scratch buffer before any of it is written back.
+            BaseAssignableTensor::writeFrom(expression);
+        } else {
+            // something reads our values out of place (a transpose, a dot product...) so we need all of the
+            // results before we can write any of them.
+            writeFrom(make_shared<FullTensor>(expression));
+        }
+        markModified();
+    }
 }
 #endif //HAPPYML_MATERIALIZED_TENSORS_HPP
@@ -0,0 +1,110 @@
+//
+// Created by Erik Hyrkas on 1/13/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_PACKED_TENSORS_HPP
+#define HAPPYML_PACKED_TENSORS_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "materialized_tensors.hpp"
+#include "../util/gemm.hpp"
+#include "../util/tensor_arena.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // A tensor of 32-bit floats kept in the order the matrix multiply kernel reads the right side of a dot product
+    // (see PackedGemmMatrix), rather than row by row. A dot product with one of these on its right skips packing,
+    // and reads each panel of it from top to bottom. That's the shape of a dense layer's weights, and when we're
+    // predicting, weights are read far more often than they change.
+    //
+    // It is still an ordinary tensor to everything else: reading a row gathers it from the panels, and assign()
+    // scatters new values into them, so it can be saved, updated and compared like any other.
+    class PackedGemmTensor : public BaseAssignableTensor {
+    public:
+        explicit PackedGemmTensor(const shared_ptr<BaseTensor> &original) {
+            rows = original->rowCount();
+            columns = original->columnCount();
+            channels.resize(original->channelCount());
+            TensorBufferLayout layout;
+            const bool laid_out = original->bufferLayout(layout);
+            ArenaBuffer<float> values;
+            if (!laid_out) {
+                values.resize(rows * columns);
+            }
+            for (size_t channel = 0; channel < channels.size(); channel++) {
+                StridedMatrix source{};
+                if (laid_out) {
+                    source = {layout.data + (channel * layout.channelStride), layout.rowStride, layout.columnStride};
+                } else {
+                    readTileFused(original, 0, rows, 0, columns, channel, values.data(), columns);
+                    source = {values.data(), columns, 1};
+                }
+                packGemmMatrix(source, rows, columns, channels[channel]);
+            }
+        }
+
+        void printMaterializationPlan() override {
+            cout << "PackedGemmTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels.size();
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const auto &packed = channels[channel];
+            return packed.values[packed.offsetOf(row, column)];
+        }
+
+        // Within a panel, a row's values are next to each other, so we copy a panel's worth at a time.
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const auto &packed = channels[channel];
+            const size_t last_column = firstColumn + count;
+            for (size_t column = firstColumn; column < last_column;) {
+                const size_t run = std::min(last_column - column, GEMM_NR - (column % GEMM_NR));
+                std::memcpy(out + (column - firstColumn), packed.values.data() + packed.offsetOf(row, column),
+                            run * sizeof(float));
+                column += run;
+            }
+        }
+
+        [[nodiscard]] const PackedGemmMatrix &packedChannel(size_t channel) const {
+            return channels[channel];
+        }
+
+    protected:
+        void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *values) override {
+            auto &packed = channels[channel];
+            const size_t last_column = firstColumn + count;
+            for (size_t column = firstColumn; column < last_column;) {
+                const size_t run = std::min(last_column - column, GEMM_NR - (column % GEMM_NR));
+                std::memcpy(packed.values.data() + packed.offsetOf(row, column), values + (column - firstColumn),
+                            run * sizeof(float));
+                column += run;
+            }
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        vector<PackedGemmMatrix> channels;
+    };
+}
+
+#endif //HAPPYML_PACKED_TENSORS_HPP
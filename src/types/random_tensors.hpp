@@ -0,0 +1,167 @@
+//
+// Created by Erik Hyrkas on 1/16/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_RANDOM_TENSORS_HPP
+#define HAPPYML_RANDOM_TENSORS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include "tensor.hpp"
+#include "materialized_tensors.hpp"
+#include "../util/philox.hpp"
+#include "../util/tensor_arena.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    enum class RandomDistribution {
+        // every value between first and second is as likely as any other
+        uniform,
+        // a bell curve with a mean of first and a standard deviation of second
+        normal
+    };
+
+    // Random values from the Philox generator (see util/philox.hpp.) Value n of the tensor (counting channel, then
+    // row, then column, the way they're saved) is worked out from n and the seed alone, so reading a value
+    // costs the same no matter where it is or what was read before, and the same seed always gives the
+    // same tensor. Reading a row fills it a block of random words at a time.
+    //
+    // For weights, you probably want one of the initializers below rather than this directly.
+    class PhiloxRandomTensor : public BaseTensor {
+    public:
+        PhiloxRandomTensor(size_t rows, size_t columns, size_t channels, RandomDistribution distribution,
+                           float first, float second, uint64_t seed) {
+            this->rows = rows;
+            this->columns = columns;
+            this->channels = channels;
+            this->distribution = distribution;
+            this->first = first;
+            this->second = second;
+            this->seed = seed;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "PhiloxRandomTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const uint64_t index = valueIndex(row, column, channel);
+            if (distribution == RandomDistribution::uniform) {
+                return uniformValue(philoxWord(seed, index));
+            }
+            return normalValue(philoxWord(seed, index * 2), philoxWord(seed, (index * 2) + 1));
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const uint64_t index = valueIndex(row, firstColumn, channel);
+            if (distribution == RandomDistribution::uniform) {
+                ArenaBuffer<uint32_t> words(count);
+                philoxWords(seed, index, count, words.data());
+                for (size_t offset = 0; offset < count; offset++) {
+                    out[offset] = uniformValue(words.data()[offset]);
+                }
+                return;
+            }
+            // each normal value takes two words
+            ArenaBuffer<uint32_t> words(count * 2);
+            philoxWords(seed, index * 2, count * 2, words.data());
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = normalValue(words.data()[offset * 2], words.data()[(offset * 2) + 1]);
+            }
+        }
+
+        [[nodiscard]] RandomDistribution getDistribution() const {
+            return distribution;
+        }
+
+        [[nodiscard]] uint64_t getSeed() const {
+            return seed;
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        size_t channels;
+        RandomDistribution distribution;
+        float first;
+        float second;
+        uint64_t seed;
+
+        [[nodiscard]] inline uint64_t valueIndex(size_t row, size_t column, size_t channel) const {
+            return ((uint64_t) channel * rows * columns) + ((uint64_t) row * columns) + column;
+        }
+
+        [[nodiscard]] inline float uniformValue(uint32_t word) const {
+            return first + ((second - first) * philoxUnitFloat(word));
+        }
+
+        [[nodiscard]] inline float normalValue(uint32_t word1, uint32_t word2) const {
+            return first + (second * philoxStandardNormal(word1, word2));
+        }
+    };
+
+    // Random tensors are views: every read works the values out again. Initial weights are read over and over
+    // before the first update replaces them, so the initializers work them out once, unless you ask them not to.
+    inline shared_ptr<BaseTensor> randomInitialValues(const shared_ptr<BaseTensor> &random, bool materialize) {
+        if (!materialize) {
+            return random;
+        }
+        return make_shared<FullTensor>(random);
+    }
+
+    // Xavier (or Glorot) initialization, from "Understanding the difficulty of training deep feedforward neural
+    // networks" (Glorot, Bengio.) Weights are scaled by the number of inputs (fanIn) and outputs (fanOut) of the
+    // layer, so the size of the signal stays about the same going forward and backward. Good for tanh and sigmoid.
+    // For a fully connected layer's weights, fanIn is the rows and fanOut is the columns.
+    inline shared_ptr<BaseTensor> xavierUniform(size_t rows, size_t columns, size_t channels, size_t fanIn,
+                                                size_t fanOut, uint64_t seed = 42, bool materialize = true) {
+        const auto limit = (float) std::sqrt(6.0 / (double) (fanIn + fanOut));
+        return randomInitialValues(make_shared<PhiloxRandomTensor>(rows, columns, channels,
+                                                                   RandomDistribution::uniform, -limit, limit,
+                                                                   seed), materialize);
+    }
+
+    inline shared_ptr<BaseTensor> xavierNormal(size_t rows, size_t columns, size_t channels, size_t fanIn,
+                                               size_t fanOut, uint64_t seed = 42, bool materialize = true) {
+        const auto deviation = (float) std::sqrt(2.0 / (double) (fanIn + fanOut));
+        return randomInitialValues(make_shared<PhiloxRandomTensor>(rows, columns, channels,
+                                                                   RandomDistribution::normal, 0.f, deviation,
+                                                                   seed), materialize);
+    }
+
+    // He (or Kaiming) initialization, from "Delving Deep into Rectifiers" (He, Zhang, Ren, Sun.) Like Xavier, but
+    // only counts the inputs and doubles the variance, since relu zeroes out about half of what goes through it.
+    inline shared_ptr<BaseTensor> heUniform(size_t rows, size_t columns, size_t channels, size_t fanIn,
+                                            uint64_t seed = 42, bool materialize = true) {
+        const auto limit = (float) std::sqrt(6.0 / (double) fanIn);
+        return randomInitialValues(make_shared<PhiloxRandomTensor>(rows, columns, channels,
+                                                                   RandomDistribution::uniform, -limit, limit,
+                                                                   seed), materialize);
+    }
+
+    inline shared_ptr<BaseTensor> heNormal(size_t rows, size_t columns, size_t channels, size_t fanIn,
+                                           uint64_t seed = 42, bool materialize = true) {
+        const auto deviation = (float) std::sqrt(2.0 / (double) fanIn);
+        return randomInitialValues(make_shared<PhiloxRandomTensor>(rows, columns, channels,
+                                                                   RandomDistribution::normal, 0.f, deviation,
+                                                                   seed), materialize);
+    }
+}
+
+#endif //HAPPYML_RANDOM_TENSORS_HPP
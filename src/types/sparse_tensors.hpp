@@ -0,0 +1,260 @@
+//
+// Created by Erik Hyrkas on 1/18/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_SPARSE_TENSORS_HPP
+#define HAPPYML_SPARSE_TENSORS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "../util/gemm.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // Only the values that aren't zero, in compressed sparse row (CSR) form: for each row, the columns that have a
+    // value and what those values are, in column order. The rows of each channel follow the rows of the channel
+    // before, so every channel is its own CSR matrix, one after the other.
+    //
+    // MNIST pixels are mostly zeros, and so are a lot of wide tables of features. Kept like this, a dot product with
+    // a SparseTensor on its left (or a transpose of one, which is how a dense layer works out its weight error)
+    // only does work for the values that are there, rather than for every column (see TensorDotTensorView.)
+    // Reading a single value means searching its row, so getValue() is slower than it is for a FullTensor.
+    class SparseTensor : public BaseAssignableTensor {
+    public:
+        // all zeros
+        SparseTensor(size_t rows, size_t columns, size_t channels) {
+            this->rows = rows;
+            this->columns = columns;
+            this->channels = channels;
+            rowStarts.assign((rows * channels) + 1, 0);
+        }
+
+        // Keeps the values of original that aren't zero, reading it a row at a time, so the zeros are never stored.
+        explicit SparseTensor(const shared_ptr<BaseTensor> &original)
+                : SparseTensor(original->rowCount(), original->columnCount(), original->channelCount()) {
+            keepNonZeroValues(original);
+        }
+
+        // Takes CSR arrays someone else built (an encoder, for instance) without copying them. rowStarts has
+        // (rows * channels) + 1 entries: the values of row r of channel c are at rowStarts[(c * rows) + r] up to
+        // rowStarts[(c * rows) + r + 1], with their columns, in order, in columnIndices.
+        SparseTensor(size_t rows, size_t columns, size_t channels, vector<size_t> rowStarts,
+                     vector<uint32_t> columnIndices, vector<float> values) {
+            if (rowStarts.size() != (rows * channels) + 1 || rowStarts.back() != columnIndices.size() ||
+                columnIndices.size() != values.size()) {
+                throw exception("Sparse tensor rows don't line up with its values.");
+            }
+            this->rows = rows;
+            this->columns = columns;
+            this->channels = channels;
+            this->rowStarts = std::move(rowStarts);
+            this->columnIndices = std::move(columnIndices);
+            this->values = std::move(values);
+        }
+
+        void printMaterializationPlan() override {
+            cout << "SparseTensor{" << rowCount() << "," << columnCount() << "," << channelCount() << "}";
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const size_t end = rowEnd(row, channel);
+            const size_t offset = firstAtOrAfter(row, channel, column);
+            if (offset < end && columnIndices[offset] == column) {
+                return values[offset];
+            }
+            return 0.f;
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            std::fill(out, out + count, 0.f);
+            const size_t end = rowEnd(row, channel);
+            const size_t last_column = firstColumn + count;
+            for (size_t offset = firstAtOrAfter(row, channel, firstColumn);
+                 offset < end && columnIndices[offset] < last_column; offset++) {
+                out[columnIndices[offset] - firstColumn] = values[offset];
+            }
+        }
+
+        // how many values we keep
+        [[nodiscard]] size_t nonZeroCount() const {
+            return values.size();
+        }
+
+        // memory the values, and what we need to find them, take up
+        [[nodiscard]] size_t byteCount() const {
+            return (rowStarts.size() * sizeof(size_t)) + (columnIndices.size() * sizeof(uint32_t)) +
+                   (values.size() * sizeof(float));
+        }
+
+        // Where the values of a row are in rowColumns() and rowValues(): from rowStart() up to rowEnd().
+        [[nodiscard]] inline size_t rowStart(size_t row, size_t channel) const {
+            return rowStarts[(channel * rows) + row];
+        }
+
+        [[nodiscard]] inline size_t rowEnd(size_t row, size_t channel) const {
+            return rowStarts[(channel * rows) + row + 1];
+        }
+
+        // the first value of a row at column or past it, or rowEnd() if there isn't one.
+        [[nodiscard]] inline size_t firstAtOrAfter(size_t row, size_t channel, size_t column) const {
+            const auto begin = columnIndices.begin() + (ptrdiff_t) rowStart(row, channel);
+            const auto end = columnIndices.begin() + (ptrdiff_t) rowEnd(row, channel);
+            return (size_t) (std::lower_bound(begin, end, column) - columnIndices.begin());
+        }
+
+        [[nodiscard]] inline const uint32_t *rowColumns() const {
+            return columnIndices.data();
+        }
+
+        [[nodiscard]] inline const float *rowValues() const {
+            return values.data();
+        }
+
+        // The same values as one long row (the shape TensorFlattenToRowView gives), still sparse. Each value's
+        // column is where it would be in the file: channel, then row, then column.
+        shared_ptr<SparseTensor> flattenToRow() const {
+            vector<uint32_t> flat_columns(columnIndices.size());
+            for (size_t row_index = 0; row_index < rows * channels; row_index++) {
+                const auto row_offset = (uint32_t) (row_index * columns);
+                for (size_t offset = rowStarts[row_index]; offset < rowStarts[row_index + 1]; offset++) {
+                    flat_columns[offset] = row_offset + columnIndices[offset];
+                }
+            }
+            return make_shared<SparseTensor>(1, rows * columns * channels, 1, vector<size_t>{0, values.size()},
+                                             std::move(flat_columns), values);
+        }
+
+    protected:
+        // Values may come and go, so everything after the row moves. This is for the odd tile assign() writes
+        // in place. Anything bigger rebuilds the whole tensor through writeFrom().
+        void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *newValues) override {
+            const size_t first = firstAtOrAfter(row, channel, firstColumn);
+            const size_t last = firstAtOrAfter(row, channel, firstColumn + count);
+            vector<uint32_t> kept_columns;
+            vector<float> kept_values;
+            for (size_t offset = 0; offset < count; offset++) {
+                if (newValues[offset] != 0.f) {
+                    kept_columns.push_back((uint32_t) (firstColumn + offset));
+                    kept_values.push_back(newValues[offset]);
+                }
+            }
+            columnIndices.erase(columnIndices.begin() + (ptrdiff_t) first, columnIndices.begin() + (ptrdiff_t) last);
+            columnIndices.insert(columnIndices.begin() + (ptrdiff_t) first, kept_columns.begin(), kept_columns.end());
+            values.erase(values.begin() + (ptrdiff_t) first, values.begin() + (ptrdiff_t) last);
+            values.insert(values.begin() + (ptrdiff_t) first, kept_values.begin(), kept_values.end());
+            const auto change = (ptrdiff_t) kept_columns.size() - (ptrdiff_t) (last - first);
+            for (size_t index = (channel * rows) + row + 1; index < rowStarts.size(); index++) {
+                rowStarts[index] = (size_t) ((ptrdiff_t) rowStarts[index] + change);
+            }
+        }
+
+        void writeFrom(const shared_ptr<BaseTensor> &source) override {
+            keepNonZeroValues(source);
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        size_t channels;
+        vector<size_t> rowStarts;
+        vector<uint32_t> columnIndices;
+        vector<float> values;
+
+        void keepNonZeroValues(const shared_ptr<BaseTensor> &source) {
+            vector<uint32_t> new_columns;
+            vector<float> new_values;
+            RowScratch row_values(columns);
+            for (size_t channel = 0; channel < channels; channel++) {
+                for (size_t row = 0; row < rows; row++) {
+                    readTileFused(source, row, 1, 0, columns, channel, row_values.data(), columns);
+                    for (size_t column = 0; column < columns; column++) {
+                        if (row_values.data()[column] != 0.f) {
+                            new_columns.push_back((uint32_t) column);
+                            new_values.push_back(row_values.data()[column]);
+                        }
+                    }
+                    rowStarts[(channel * rows) + row + 1] = new_values.size();
+                }
+            }
+            new_columns.shrink_to_fit();
+            new_values.shrink_to_fit();
+            columnIndices = std::move(new_columns);
+            values = std::move(new_values);
+        }
+    };
+
+    // out += scale * source, where source steps columnStride between values.
+    inline void addScaledRow(float scale, const float *source, size_t columnStride, size_t count, float *out) {
+        if (columnStride == 1) {
+            for (size_t column = 0; column < count; column++) {
+                out[column] += scale * source[column];
+            }
+            return;
+        }
+        for (size_t column = 0; column < count; column++) {
+            out[column] += scale * source[column * columnStride];
+        }
+    }
+
+    // c = a dot b for rows firstRow through firstRow + rows - 1 of a, when b already starts at the first column we
+    // want. Each value of a's row scales a row of b into the result, so the work is the values we kept times the
+    // columns, however many columns of a there are.
+    inline void sparseDotValues(const SparseTensor &a, const StridedMatrix &b, size_t channel, size_t firstRow,
+                                size_t rows, size_t columns, float *c, size_t ldc) {
+        const uint32_t *a_columns = a.rowColumns();
+        const float *a_values = a.rowValues();
+        for (size_t row = 0; row < rows; row++) {
+            float *c_row = c + (row * ldc);
+            std::fill(c_row, c_row + columns, 0.f);
+            const size_t end = a.rowEnd(firstRow + row, channel);
+            for (size_t offset = a.rowStart(firstRow + row, channel); offset < end; offset++) {
+                const float *b_row = b.data + (a_columns[offset] * b.rowStride);
+                addScaledRow(a_values[offset], b_row, b.columnStride, columns, c_row);
+            }
+        }
+    }
+
+    // c = transpose(a) dot b for rows firstRow through firstRow + rows - 1 of transpose(a) (so columns of a), when b
+    // already starts at the first column we want. A dense layer's weight error is transpose(input) dot error, and
+    // when the input is sparse, we only touch the rows of the result that a value of the input lands on.
+    inline void sparseTransposeDotValues(const SparseTensor &a, size_t aRows, const StridedMatrix &b, size_t channel,
+                                         size_t firstRow, size_t rows, size_t columns, float *c, size_t ldc) {
+        for (size_t row = 0; row < rows; row++) {
+            std::fill(c + (row * ldc), c + (row * ldc) + columns, 0.f);
+        }
+        const uint32_t *a_columns = a.rowColumns();
+        const float *a_values = a.rowValues();
+        const size_t last_row = firstRow + rows;
+        for (size_t k = 0; k < aRows; k++) {
+            const float *b_row = b.data + (k * b.rowStride);
+            const size_t end = a.rowEnd(k, channel);
+            for (size_t offset = a.firstAtOrAfter(k, channel, firstRow);
+                 offset < end && a_columns[offset] < last_row; offset++) {
+                float *c_row = c + ((a_columns[offset] - firstRow) * ldc);
+                addScaledRow(a_values[offset], b_row, b.columnStride, columns, c_row);
+            }
+        }
+    }
+}
+
+#endif //HAPPYML_SPARSE_TENSORS_HPP
@@ -6,21 +6,27 @@
 #ifndef HAPPYML_TENSOR_HPP
 #define HAPPYML_TENSOR_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <execution>
 #include <future>
 #include <iterator>
+#include <queue>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <iomanip>
+#include <sstream>
 #include <fstream>
 #include "quarter_float.hpp"
 #include "half_float.hpp"
 #include "../util/portable_bytes.hpp"
+#include "../util/tensor_arena.hpp"
+#include "../util/pooled_allocator.hpp"
 
 // TODO:
-// * create bit matrix since there are many inputs that are strictly 1s and 0s
-//    -- NOTE: the challenge is initializing without a set(). If we allocate with a vector of floats...
-//             well, we will end up spending more memory and cpu for a very short lived object.
 // * consider improving parallel operations with something like: bool optimized_for_columns_first_iteration() {}
 //   true for base matrices because of memory organization and caching, but views may transform the underlying
 //   matrix and our iterations would then be slower to iterate by column or row from its perspective. the cpu
@@ -97,6 +103,9 @@
  * Since I'm using vectors of vectors, I do wonder whether there will be performance implications with huge number of
  * operations accessing individual elements.
  *
+ * UPDATE: There were. Profiles of dense layers pointed straight at the nested vectors, so materialized tensors now
+ * use one aligned allocation per tensor (see AlignedTensorData in materialized_tensors.hpp.)
+ *
  * Since I don't allow resizing or reshaping, I don't provide an empty constructor.
  *
  * I do provide a number of handy methods to change the values of the matrix. One of which is random(). I'm not
@@ -106,6 +115,182 @@ using namespace std;
 
 namespace happyml {
 
+    // Scratch space for reading a row (or part of one) out of a tensor. Most rows we deal with are small enough to
+    // live on the stack, so we only go to the arena when somebody hands us an unusually wide row.
+    class RowScratch {
+    public:
+        explicit RowScratch(const size_t count) {
+            if (count > LOCAL_CAPACITY) {
+                wide.resize(count);
+                values = wide.data();
+            } else {
+                values = local;
+            }
+        }
+
+        RowScratch(const RowScratch &) = delete;
+
+        RowScratch &operator=(const RowScratch &) = delete;
+
+        inline float *data() {
+            return values;
+        }
+
+    private:
+        static constexpr size_t LOCAL_CAPACITY = 512;
+        float local[LOCAL_CAPACITY];
+        ArenaBuffer<float> wide;
+        float *values;
+    };
+
+    // Describes where a tensor's float values live in memory, for tensors that keep them in a single buffer.
+    // Value (row, column, channel) is at data[channel * channelStride + row * rowStride + column * columnStride].
+    // Views that only move values around (transpose, reshape, slices, ...) can describe themselves with a layout
+    // over their child's buffer, so reading them costs the same as reading the child.
+    struct TensorBufferLayout {
+        const float *data = nullptr;
+        size_t rowStride = 0;
+        size_t columnStride = 0;
+        size_t channelStride = 0;
+
+        [[nodiscard]] inline float at(size_t row, size_t column, size_t channel) const {
+            return data[(channel * channelStride) + (row * rowStride) + (column * columnStride)];
+        }
+
+        inline void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) const {
+            const float *source = data + (channel * channelStride) + (row * rowStride) + (firstColumn * columnStride);
+            if (columnStride == 1) {
+                std::memcpy(out, source, count * sizeof(float));
+            } else if (columnStride == 0) {
+                // a broadcast column: one value, repeated
+                std::fill(out, out + count, *source);
+            } else {
+                for (size_t offset = 0; offset < count; offset++) {
+                    out[offset] = source[offset * columnStride];
+                }
+            }
+        }
+    };
+
+    // Reading a rows x columns channel row by row, if each value is always the same distance (step) past the
+    // one before it, we can treat the channel as one long run of values. That's what lets reshapes and
+    // flattens describe themselves as a layout.
+    inline bool linearStep(const TensorBufferLayout &layout, size_t rows, size_t columns, size_t &step) {
+        if (columns == 1) {
+            step = layout.rowStride;
+        } else if (rows == 1 || layout.rowStride == columns * layout.columnStride) {
+            step = layout.columnStride;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // The same, but over every channel of the tensor, one after another.
+    inline bool flattenStep(const TensorBufferLayout &layout, size_t rows, size_t columns, size_t channels,
+                            size_t &step) {
+        if (!linearStep(layout, rows, columns, step)) {
+            return false;
+        }
+        return channels == 1 || layout.channelStride == rows * columns * step;
+    }
+
+    // Reductions read a block of values at a time. 16k floats is 64kb, which stays comfortably in L2.
+    constexpr size_t REDUCE_BLOCK_ELEMENTS = 1 << 14;
+    // Below this many values, reducing on one thread is faster than starting more.
+    constexpr size_t PARALLEL_REDUCE_THRESHOLD = 1 << 18;
+
+    // Adds up doubles while carrying the rounding error along (Kahan-Babuska, also known as Neumaier's variant
+    // of Kahan summation.) Adding a small number to a big total loses the small number's low bits, but we
+    // keep those bits in the compensation and give them back at the end.
+    struct CompensatedSum {
+        double sum = 0;
+        double compensation = 0;
+
+        inline void add(double value) {
+            const double next = sum + value;
+            if (std::abs(sum) >= std::abs(value)) {
+                compensation += (sum - next) + value;
+            } else {
+                compensation += (value - next) + sum;
+            }
+            sum = next;
+        }
+
+        inline void add(const CompensatedSum &other) {
+            add(other.sum);
+            compensation += other.compensation;
+        }
+
+        [[nodiscard]] inline double total() const {
+            return sum + compensation;
+        }
+    };
+
+    // The block functions below keep eight independent running values. Without them, each step would have to
+    // wait for the one before it, and the compiler isn't allowed to reorder floating point math to vectorize
+    // the loop on its own. With them, the loop maps directly onto SIMD registers.
+    inline double sumOfBlock(const float *values, size_t count) {
+        double lanes[8] = {};
+        size_t offset = 0;
+        for (; offset + 8 <= count; offset += 8) {
+            for (size_t lane = 0; lane < 8; lane++) {
+                lanes[lane] += (double) values[offset + lane];
+            }
+        }
+        for (; offset < count; offset++) {
+            lanes[0] += (double) values[offset];
+        }
+        // and add the lanes pairwise, too.
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+
+    inline double productOfBlock(const float *values, size_t count) {
+        double lanes[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+        size_t offset = 0;
+        for (; offset + 8 <= count; offset += 8) {
+            for (size_t lane = 0; lane < 8; lane++) {
+                lanes[lane] *= (double) values[offset + lane];
+            }
+        }
+        for (; offset < count; offset++) {
+            lanes[0] *= (double) values[offset];
+        }
+        return ((lanes[0] * lanes[1]) * (lanes[2] * lanes[3])) * ((lanes[4] * lanes[5]) * (lanes[6] * lanes[7]));
+    }
+
+    // NaN is skipped, the same as std::min and std::max did when we used them one value at a time.
+    inline void minMaxOfBlock(const float *values, size_t count, float &minValue, float &maxValue) {
+        float mins[8] = {INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY};
+        float maxes[8] = {-INFINITY, -INFINITY, -INFINITY, -INFINITY, -INFINITY, -INFINITY, -INFINITY, -INFINITY};
+        size_t offset = 0;
+        for (; offset + 8 <= count; offset += 8) {
+            for (size_t lane = 0; lane < 8; lane++) {
+                const float val = values[offset + lane];
+                mins[lane] = val < mins[lane] ? val : mins[lane];
+                maxes[lane] = val > maxes[lane] ? val : maxes[lane];
+            }
+        }
+        for (; offset < count; offset++) {
+            const float val = values[offset];
+            mins[0] = val < mins[0] ? val : mins[0];
+            maxes[0] = val > maxes[0] ? val : maxes[0];
+        }
+        for (size_t lane = 0; lane < 8; lane++) {
+            minValue = mins[lane] < minValue ? mins[lane] : minValue;
+            maxValue = maxes[lane] > maxValue ? maxes[lane] : maxValue;
+        }
+    }
+
+    // The result of BaseTensor::stats()
+    struct TensorSummary {
+        float min;
+        float max;
+        double sum;
+        double mean;
+        size_t count;
+    };
+
     class BaseTensor : public enable_shared_from_this<BaseTensor> {
     public:
         virtual size_t rowCount() = 0;
@@ -130,13 +315,17 @@ namespace happyml {
             auto portableColumns = portableBytes(columns);
             stream.write(reinterpret_cast<const char *>(&portableColumns), sizeof(portableColumns));
 
+            RowScratch rowValues(columns);
+            vector<uint32_t> portableRow(columns);
             for (size_t channel = 0; channel < channels; channel++) {
                 for (size_t row = 0; row < rows; row++) {
+                    readRow(row, channel, 0, columns, rowValues.data());
                     for (size_t column = 0; column < columns; column++) {
-                        float floatVal = getValue(row, column, channel);
-                        uint32_t portableVal = portableBytes(*(uint32_t *) &floatVal);
-                        stream.write(reinterpret_cast<const char *>(&portableVal), sizeof(portableVal));
+                        float floatVal = rowValues.data()[column];
+                        portableRow[column] = portableBytes(*(uint32_t *) &floatVal);
                     }
+                    stream.write(reinterpret_cast<const char *>(portableRow.data()),
+                                 (streamsize) (sizeof(uint32_t) * columns));
                 }
             }
         }
@@ -183,6 +372,32 @@ namespace happyml {
 
         virtual float getValue(size_t row, size_t column, size_t channel) = 0;
 
+        // If this tensor's values are already sitting in memory as floats, describe where they are and return true.
+        // Kernels like matrix multiply use this to read the memory directly rather than copying it first.
+        // Views that only rearrange values (transpose, for example) can answer by adjusting their child's layout.
+        virtual bool bufferLayout(TensorBufferLayout &layout) {
+            return false;
+        }
+
+        // Reads count values from a row, starting at firstColumn, into out.
+        // The default falls back to getValue(), but views override this so that a child fills a buffer once
+        // and the parent transforms that whole buffer in a tight loop. For a deep stack of views, this turns
+        // one virtual call per view per element into one virtual call per view per row.
+        virtual void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) {
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = getValue(row, firstColumn + offset, channel);
+            }
+        }
+
+        // Reads a block of rows and columns into out. Each row of the tile starts outRowStride floats after the
+        // previous one, so callers can read straight into a larger buffer.
+        virtual void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                              float *out, size_t outRowStride) {
+            for (size_t row = 0; row < rows; row++) {
+                readRow(firstRow + row, channel, firstColumn, columns, out + (row * outRowStride));
+            }
+        }
+
         virtual vector <size_t> getShape() {
             return {rowCount(), columnCount(), channelCount()};
         }
@@ -198,89 +413,65 @@ namespace happyml {
         }
 
         double product() {
-            double result = 1.0;
-            const size_t maxRows = rowCount();
-            const size_t maxCols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < maxRows; row++) {
-                    for (size_t col = 0; col < maxCols; col++) {
-                        result *= getValue(row, col, channel);
-                    }
-                }
-            }
-            return result;
+            return reduceValues<double>(1.0, [](double &result, const float *values, size_t count) {
+                result *= productOfBlock(values, count);
+            }, [](double left, double right) { return left * right; });
         }
 
         double sum() {
-            double result = 0.0;
-            const size_t maxRows = rowCount();
-            const size_t maxCols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < maxRows; row++) {
-                    for (size_t col = 0; col < maxCols; col++) {
-                        result += getValue(row, col, channel);
-                    }
-                }
-            }
-            return result;
+            return reduceValues<CompensatedSum>(CompensatedSum{}, [](CompensatedSum &result, const float *values,
+                                                                     size_t count) {
+                result.add(sumOfBlock(values, count));
+            }, [](CompensatedSum left, const CompensatedSum &right) {
+                left.add(right);
+                return left;
+            }).total();
         }
 
         float max() {
-            float result = -INFINITY;
-            const size_t maxRows = rowCount();
-            const size_t maxCols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < maxRows; row++) {
-                    for (size_t col = 0; col < maxCols; col++) {
-                        result = std::max(result, getValue(row, col, channel));
-                    }
-                }
-            }
-            return result;
+            return range().second;
         }
 
         float min() {
-            float result = INFINITY;
-            const size_t maxRows = rowCount();
-            const size_t maxCols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < maxRows; row++) {
-                    for (size_t col = 0; col < maxCols; col++) {
-                        result = std::min(result, getValue(row, col, channel));
-                    }
-                }
-            }
-            return result;
+            return range().first;
         }
 
         pair<float, float> range() {
-            float minResult = INFINITY;
-            float maxResult = -INFINITY;
-            const size_t maxRows = rowCount();
-            const size_t maxCols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < maxRows; row++) {
-                    for (size_t col = 0; col < maxCols; col++) {
-                        const auto val = getValue(row, col, channel);
-                        minResult = std::min(minResult, val);
-                        maxResult = std::max(maxResult, val);
-                    }
-                }
-            }
-            return {minResult, maxResult};
+            const auto summary = stats();
+            return {summary.min, summary.max};
+        }
+
+        // Min, max, sum and mean in a single pass over the values.
+        TensorSummary stats() {
+            const auto partial = reduceValues<SummaryPartial>(SummaryPartial{}, [](SummaryPartial &result,
+                                                                                const float *values, size_t count) {
+                minMaxOfBlock(values, count, result.min, result.max);
+                result.sum.add(sumOfBlock(values, count));
+            }, [](SummaryPartial left, const SummaryPartial &right) {
+                left.min = std::min(left.min, right.min);
+                left.max = std::max(left.max, right.max);
+                left.sum.add(right.sum);
+                return left;
+            });
+            const size_t count = size();
+            TensorSummary result;
+            result.min = partial.min;
+            result.max = partial.max;
+            result.sum = partial.sum.total();
+            result.mean = count > 0 ? result.sum / (double) count : 0.0;
+            result.count = count;
+            return result;
         }
 
         size_t maxIndex(size_t channel, size_t row) {
             size_t result = 0;
             float currentMax = -INFINITY;
             const size_t maxCols = columnCount();
+            RowScratch rowValues(maxCols);
+            readRow(row, channel, 0, maxCols, rowValues.data());
+            const float *values = rowValues.data();
             for (size_t col = 0; col < maxCols; col++) {
-                float nextVal = getValue(row, col, channel);
+                float nextVal = values[col];
                 if (nextVal > currentMax) {
                     currentMax = nextVal;
                     result = col;
@@ -293,8 +484,11 @@ namespace happyml {
             size_t result = 0;
             float currentMin = INFINITY;
             const size_t maxCols = columnCount();
+            RowScratch rowValues(maxCols);
+            readRow(row, channel, 0, maxCols, rowValues.data());
+            const float *values = rowValues.data();
             for (size_t col = 0; col < maxCols; col++) {
-                float nextVal = getValue(row, col, channel);
+                float nextVal = values[col];
                 if (nextVal < currentMin) {
                     currentMin = nextVal;
                     result = col;
@@ -307,8 +501,11 @@ namespace happyml {
             vector<size_t> result;
             float current_max = -INFINITY;
             const size_t maxCols = columnCount();
+            RowScratch rowValues(maxCols);
+            readRow(row, channel, 0, maxCols, rowValues.data());
+            const float *values = rowValues.data();
             for (size_t col = 0; col < maxCols; col++) {
-                float nextVal = getValue(row, col, channel);
+                float nextVal = values[col];
                 if (nextVal > current_max) {
                     current_max = nextVal;
                     result.clear();
@@ -324,8 +521,11 @@ namespace happyml {
             vector<size_t> result;
             float currentMin = INFINITY;
             const size_t maxCols = columnCount();
+            RowScratch rowValues(maxCols);
+            readRow(row, channel, 0, maxCols, rowValues.data());
+            const float *values = rowValues.data();
             for (size_t col = 0; col < maxCols; col++) {
-                float nextVal = getValue(row, col, channel);
+                float nextVal = values[col];
                 if (nextVal < currentMin) {
                     currentMin = nextVal;
                     result.clear();
@@ -349,22 +549,17 @@ namespace happyml {
             //
             // for each offset:
             //   average = average + (val[offset] - average)/(offset+1)
-            double average = 0;
-            double index = 0;
-            const size_t rows = rowCount();
-            const size_t cols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < rows; row++) {
-                    for (size_t col = 0; col < cols; col++) {
-                        index++;
-                        const double val = getValue(row, col, channel);
-                        average += (val - average) / index;
-                    }
-                }
+            //
+            // UPDATE: That running average is inherently serial, and every MSE loss calculation goes through here.
+            // Now we add up blocks of values in double precision (where overflowing would take around 10^270
+            // maximum-sized floats) and carry the rounding error between blocks with compensated summation. That
+            // gives us a sum we can split across threads, and dividing at the end is at least as accurate as the
+            // running average was.
+            const size_t count = size();
+            if (count == 0) {
+                return 0.f;
             }
-
-            return (float) average;
+            return (float) (sum() / (double) count);
         }
 
         float geometricMean() {
@@ -422,25 +617,31 @@ namespace happyml {
             // This also gave nearly correct, but still incorrect answers. I've already forgotten more about what other
             // attempts I made, but I spent too much time on it for something that I don't have an immediate need for
             // and clearly don't fully understand.
-            double sum = 0;
-            double index = 0;
-            const size_t rows = rowCount();
-            const size_t cols = columnCount();
-            const size_t maxChannels = channelCount();
-            for (size_t channel = 0; channel < maxChannels; channel++) {
-                for (size_t row = 0; row < rows; row++) {
-                    for (size_t col = 0; col < cols; col++) {
-                        const double val = ((double) getValue(row, col, channel));
-                        index++;
-                        if (val <= 0) {
-                            return NAN;
-                        }
-                        sum += log(val);
+            const size_t count = size();
+            const auto logs = reduceValues<LogSumPartial>(LogSumPartial{}, [](LogSumPartial &result,
+                                                                           const float *values, size_t count) {
+                if (result.invalid) {
+                    return;
+                }
+                double block = 0;
+                for (size_t offset = 0; offset < count; offset++) {
+                    const double val = (double) values[offset];
+                    if (val <= 0) {
+                        result.invalid = true;
+                        return;
                     }
+                    block += log(val);
                 }
+                result.sum.add(block);
+            }, [](LogSumPartial left, const LogSumPartial &right) {
+                left.invalid = left.invalid || right.invalid;
+                left.sum.add(right.sum);
+                return left;
+            });
+            if (logs.invalid || count == 0) {
+                return NAN;
             }
-            sum /= index;
-            return (float) exp(sum);
+            return (float) exp(logs.sum.total() / (double) count);
         }
 
         void print() {
@@ -478,14 +679,128 @@ namespace happyml {
                 }
             }
         }
+
+    private:
+        struct SummaryPartial {
+            float min = INFINITY;
+            float max = -INFINITY;
+            CompensatedSum sum;
+        };
+
+        struct LogSumPartial {
+            bool invalid = false;
+            CompensatedSum sum;
+        };
+
+        // Splits the tensor into bands of rows, reduces each band on its own thread with reduceBlock, then
+        // combines the partial results pairwise, like a tree. Each band is always the same rows and is always
+        // combined in the same order, so the answer doesn't depend on the number of threads or their timing.
+        template<typename Partial, typename ReduceBlock, typename Combine>
+        Partial reduceValues(const Partial &identity, ReduceBlock reduceBlock, Combine combine) {
+            const size_t rows = rowCount();
+            const size_t columns = columnCount();
+            const size_t channels = channelCount();
+            if (rows == 0 || columns == 0 || channels == 0) {
+                return identity;
+            }
+            // we treat (channel, row) as one long list of rows, so a band can span channels.
+            const size_t total_rows = rows * channels;
+            const size_t block_rows = std::max((size_t) 1, REDUCE_BLOCK_ELEMENTS / columns);
+            const size_t threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+            size_t band_rows = total_rows;
+            if (threads > 1 && total_rows * columns >= PARALLEL_REDUCE_THRESHOLD) {
+                const size_t target_bands = threads * 4;
+                band_rows = std::max((total_rows + target_bands - 1) / target_bands, block_rows);
+            }
+            const size_t bands = (total_rows + band_rows - 1) / band_rows;
+            vector<Partial> partials(bands, identity);
+            auto reduce_band = [this, &partials, &reduceBlock, band_rows, block_rows, total_rows, rows, columns](
+                    size_t band) {
+                const size_t last = std::min(total_rows, (band + 1) * band_rows);
+                ArenaBuffer<float> values(std::min(block_rows, last - (band * band_rows)) * columns);
+                for (size_t position = band * band_rows; position < last;) {
+                    const size_t channel = position / rows;
+                    const size_t row = position % rows;
+                    const size_t count = std::min(std::min(block_rows, last - position), rows - row);
+                    readTile(row, count, 0, columns, channel, values.data(), columns);
+                    reduceBlock(partials[band], values.data(), count * columns);
+                    position += count;
+                }
+            };
+            if (bands == 1) {
+                reduce_band(0);
+            } else {
+                queue<future<void>> futures;
+                for (size_t band = 0; band < bands; band++) {
+                    futures.push(std::async(std::launch::async, reduce_band, band));
+                    if (futures.size() >= threads) {
+                        futures.front().get();
+                        futures.pop();
+                    }
+                }
+                while (!futures.empty()) {
+                    futures.front().get();
+                    futures.pop();
+                }
+            }
+            for (size_t width = 1; width < bands; width *= 2) {
+                for (size_t band = 0; band + width < bands; band += 2 * width) {
+                    partials[band] = combine(partials[band], partials[band + width]);
+                }
+            }
+            return partials[0];
+        }
     };
 
 // This abstract class lets us build float tensors and bit tensors as well and use them interchangeably.
     class BaseAssignableTensor : public BaseTensor {
     public:
+        BaseAssignableTensor() : tensorId(nextTensorId().fetch_add(1, memory_order_relaxed)) {
+        }
+
         bool isMaterialized() override {
             return true;
         }
+
+        // Never reused, even after the tensor is gone, unlike its address. Replacing a tensor with a new one
+        // gives it a new id.
+        [[nodiscard]] uint64_t id() const {
+            return tensorId;
+        }
+
+        // Goes up every time our values change. Anything worked out from our values is good for as long as the
+        // generation it was worked out from is still current.
+        [[nodiscard]] uint64_t generation() const {
+            return currentGeneration.load(memory_order_acquire);
+        }
+
+        // Kernels that write through raw pointers after the tensor has been handed out call this when they're done.
+        void markModified() {
+            currentGeneration.fetch_add(1, memory_order_acq_rel);
+        }
+
+        // Overwrites our values with the values of expression, which needs to be the same shape, without allocating
+        // a new tensor. Expression may read from us (weights - learning_rate * error, for example): we check with
+        // contains() and only then put results in a scratch buffer before writing them. Defined in
+        // materialized_tensors.hpp.
+        void assign(const shared_ptr<BaseTensor> &expression);
+
+    protected:
+        // Stores count values starting at (row, firstColumn) in channel.
+        virtual void writeRow(size_t row, size_t channel, size_t firstColumn, size_t count, const float *values) = 0;
+
+        // Copies source into us when source doesn't read from us. Tensors that can have views write straight into
+        // their memory override this.
+        virtual void writeFrom(const shared_ptr<BaseTensor> &source);
+
+    private:
+        const uint64_t tensorId;
+        atomic<uint64_t> currentGeneration{0};
+
+        static atomic<uint64_t> &nextTensorId() {
+            static atomic<uint64_t> next{1};
+            return next;
+        }
     };
 
 
@@ -597,11 +912,13 @@ namespace happyml {
         }
 
         float getValue(size_t row, size_t column, size_t channel) override {
-            // nothing magical here... I'm finding an offset, expanding it by a massive amount relative to the range,
-            // then forcing it into a range. I picked a few constants that I felt gave a reasonable looking distribution.
-            const double offset = (((double) channel * channel_size) + ((double) row * (double) cols) +
-                                   (((double) column + 1.0) * range_const) + seed_const) * 3.14159265358979323846;
-            return (float) (max_value - fmod(offset, range));
+            return randomValue(row, column, channel);
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = randomValue(row, firstColumn + offset, channel);
+            }
         }
 
         [[nodiscard]] float get_min_value() const {
@@ -627,6 +944,14 @@ namespace happyml {
         uint32_t seed;
         double seed_const;
         double range_const;
+
+        inline float randomValue(size_t row, size_t column, size_t channel) const {
+            // nothing magical here... I'm finding an offset, expanding it by a massive amount relative to the range,
+            // then forcing it into a range. I picked a few constants that I felt gave a reasonable looking distribution.
+            const double offset = (((double) channel * channel_size) + ((double) row * (double) cols) +
+                                   (((double) column + 1.0) * range_const) + seed_const) * 3.14159265358979323846;
+            return (float) (max_value - fmod(offset, range));
+        }
     };
 
 // There are cases were we want a tensor of all zeros or all ones.
@@ -663,6 +988,14 @@ namespace happyml {
             return value;
         }
 
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            std::fill(out, out + count, value);
+        }
+
+        [[nodiscard]] float get_value() const {
+            return value;
+        }
+
     private:
         size_t rows;
         size_t cols;
@@ -708,6 +1041,13 @@ namespace happyml {
         size_t channels;
     };
 
+    // Use this rather than make_shared() for views built on every sample. It returns the same shared_ptr, but
+    // the view and its reference counts come from a per-thread pool instead of the heap.
+    template<typename View, typename... Args>
+    inline shared_ptr<View> makeView(Args &&...args) {
+        return allocate_shared<View>(PooledAllocator<View>(), std::forward<Args>(args)...);
+    }
+
     class BaseTensorUnaryOperatorView : public BaseTensor {
     public:
         explicit BaseTensorUnaryOperatorView(const shared_ptr<BaseTensor> &tensor) {
@@ -734,11 +1074,176 @@ namespace happyml {
             return child->channelCount();
         }
 
+        [[nodiscard]] const shared_ptr<BaseTensor> &getChild() const {
+            return child;
+        }
+
     protected:
         shared_ptr<BaseTensor> child;
     };
 
 
+    // A unary view that only moves values around. When its child keeps its values in one buffer, the view works
+    // out its own layout over that buffer once, when it's made, and after that reads go straight to memory
+    // rather than through the child. Kernels that take a bufferLayout() read it directly too.
+    class BaseTensorStridedView : public BaseTensorUnaryOperatorView {
+    public:
+        explicit BaseTensorStridedView(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(tensor) {
+        }
+
+        bool bufferLayout(TensorBufferLayout &out) override {
+            if (!strided) {
+                return false;
+            }
+            out = layout;
+            return true;
+        }
+
+        [[nodiscard]] bool isStrided() const {
+            return strided;
+        }
+
+    protected:
+        bool strided = false;
+        TensorBufferLayout layout;
+
+        // Describe our layout in terms of the child's, or return false if we can't.
+        virtual bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) = 0;
+
+        // Subclasses call this at the end of their constructor, once they know their own shape.
+        void initializeLayout() {
+            TensorBufferLayout child_layout;
+            strided = child->bufferLayout(child_layout) && composeLayout(child_layout, layout);
+        }
+    };
+
+    // Repeats a tensor along any of its dimensions of size one until it has the given shape, the way NumPy
+    // broadcasts. A row of biases becomes a batch's worth of rows, a 1x1xN tensor becomes one scale per channel,
+    // and so on. Nothing is copied: when the child keeps its values in a buffer, a repeated dimension is just a
+    // stride of zero.
+    class TensorBroadcastView : public BaseTensorStridedView {
+    public:
+        TensorBroadcastView(const shared_ptr<BaseTensor> &tensor, size_t rows, size_t columns, size_t channels)
+                : BaseTensorStridedView(tensor) {
+            if (!canBroadcast(tensor->rowCount(), rows) || !canBroadcast(tensor->columnCount(), columns) ||
+                !canBroadcast(tensor->channelCount(), channels)) {
+                stringstream ss;
+                ss << "Can't broadcast [" << tensor->rowCount() << ", " << tensor->columnCount() << ", "
+                   << tensor->channelCount() << "] to [" << rows << ", " << columns << ", " << channels << "]";
+                throw exception(ss.str().c_str());
+            }
+            this->rows = rows;
+            this->columns = columns;
+            this->channels = channels;
+            repeatRows = tensor->rowCount() != rows;
+            repeatColumns = tensor->columnCount() != columns;
+            repeatChannels = tensor->channelCount() != channels;
+            initializeLayout();
+        }
+
+        static bool canBroadcast(size_t from, size_t to) {
+            return from == to || from == 1;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorBroadcastView{" << rowCount() << "," << columnCount() << "," << channelCount() << "}->";
+            child->printMaterializationPlan();
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        [[nodiscard]] bool repeatsRows() const {
+            return repeatRows;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            if (strided) {
+                return layout.at(row, column, channel);
+            }
+            return child->getValue(repeatRows ? 0 : row, repeatColumns ? 0 : column, repeatChannels ? 0 : channel);
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            if (strided) {
+                layout.readRow(row, channel, firstColumn, count, out);
+            } else if (repeatColumns) {
+                std::fill(out, out + count, child->getValue(repeatRows ? 0 : row, 0, repeatChannels ? 0 : channel));
+            } else {
+                child->readRow(repeatRows ? 0 : row, repeatChannels ? 0 : channel, firstColumn, count, out);
+            }
+        }
+
+        void readTile(size_t firstRow, size_t rowsToRead, size_t firstColumn, size_t columnsToRead, size_t channel,
+                      float *out, size_t outRowStride) override {
+            if (!repeatRows) {
+                BaseTensor::readTile(firstRow, rowsToRead, firstColumn, columnsToRead, channel, out, outRowStride);
+                return;
+            }
+            // every row is the same, so we read it once and copy it while it's still in cache.
+            readRow(0, channel, firstColumn, columnsToRead, out);
+            for (size_t row = 1; row < rowsToRead; row++) {
+                std::memcpy(out + (row * outRowStride), out, columnsToRead * sizeof(float));
+            }
+        }
+
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            viewLayout = childLayout;
+            if (repeatRows) {
+                viewLayout.rowStride = 0;
+            }
+            if (repeatColumns) {
+                viewLayout.columnStride = 0;
+            }
+            if (repeatChannels) {
+                viewLayout.channelStride = 0;
+            }
+            return true;
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        size_t channels;
+        bool repeatRows;
+        bool repeatColumns;
+        bool repeatChannels;
+    };
+
+    // A unary view where each value depends only on the matching value of the child. Subclasses describe how to
+    // transform a run of values and this class handles reading rows and tiles from the child.
+    class BaseTensorElementwiseUnaryView : public BaseTensorUnaryOperatorView {
+    public:
+        explicit BaseTensorElementwiseUnaryView(const shared_ptr<BaseTensor> &tensor)
+                : BaseTensorUnaryOperatorView(tensor) {
+        }
+
+        virtual void transformValues(float *values, size_t count) = 0;
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            child->readRow(row, channel, firstColumn, count, out);
+            transformValues(out, count);
+        }
+
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            child->readTile(firstRow, rows, firstColumn, columns, channel, out, outRowStride);
+            for (size_t row = 0; row < rows; row++) {
+                transformValues(out + (row * outRowStride), columns);
+            }
+        }
+    };
+
     class BaseTensorBinaryOperatorView : public BaseTensor {
     public:
         explicit BaseTensorBinaryOperatorView(const shared_ptr<BaseTensor> &tensor1,
@@ -755,11 +1260,95 @@ namespace happyml {
             return child1->channelCount();
         }
 
+        [[nodiscard]] const shared_ptr<BaseTensor> &getChild1() const {
+            return child1;
+        }
+
+        [[nodiscard]] const shared_ptr<BaseTensor> &getChild2() const {
+            return child2;
+        }
+
     protected:
         shared_ptr<BaseTensor> child1;
         shared_ptr<BaseTensor> child2;
     };
 
+    // A binary view where each value depends only on the matching values of both children.
+    // Subclasses combine a run of values from the second child into a run of values from the first.
+    //
+    // The children don't need the same shape, as long as each of their dimensions either matches the other's or is
+    // one, which gets repeated to fit (NumPy's broadcasting rules). Subclasses call broadcastChildren() in their
+    // constructors, which wraps whichever child is smaller in a TensorBroadcastView, so that everything after
+    // that, including the fused evaluator, sees two children of the same shape.
+    class BaseTensorElementwiseBinaryView : public BaseTensorBinaryOperatorView {
+    public:
+        BaseTensorElementwiseBinaryView(const shared_ptr<BaseTensor> &tensor1, const shared_ptr<BaseTensor> &tensor2)
+                : BaseTensorBinaryOperatorView(tensor1, tensor2) {
+        }
+
+        virtual void combineValues(float *values, const float *otherValues, size_t count) = 0;
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            RowScratch other(count);
+            child1->readRow(row, channel, firstColumn, count, out);
+            child2->readRow(row, channel, firstColumn, count, other.data());
+            combineValues(out, other.data(), count);
+        }
+
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            child1->readTile(firstRow, rows, firstColumn, columns, channel, out, outRowStride);
+            if (child2RepeatsRows) {
+                // a bias row over a batch: read the row once and combine it into every row of the tile.
+                RowScratch other(columns);
+                child2->readRow(firstRow, channel, firstColumn, columns, other.data());
+                for (size_t row = 0; row < rows; row++) {
+                    combineValues(out + (row * outRowStride), other.data(), columns);
+                }
+                return;
+            }
+            ArenaBuffer<float> other(rows * columns);
+            child2->readTile(firstRow, rows, firstColumn, columns, channel, other.data(), columns);
+            for (size_t row = 0; row < rows; row++) {
+                combineValues(out + (row * outRowStride), other.data() + (row * columns), columns);
+            }
+        }
+
+    protected:
+        void broadcastChildren(const char *operation) {
+            const size_t rows = std::max(child1->rowCount(), child2->rowCount());
+            const size_t columns = std::max(child1->columnCount(), child2->columnCount());
+            const size_t channels = std::max(child1->channelCount(), child2->channelCount());
+            if (!fits(child1, rows, columns, channels) || !fits(child2, rows, columns, channels)) {
+                stringstream ss;
+                ss << "Can't broadcast [" << child1->rowCount() << ", " << child1->columnCount() << ", "
+                   << child1->channelCount() << "] " << operation << " [" << child2->rowCount() << ", "
+                   << child2->columnCount() << ", " << child2->channelCount() << "]";
+                throw exception(ss.str().c_str());
+            }
+            child1 = broadcast(child1, rows, columns, channels);
+            child2 = broadcast(child2, rows, columns, channels);
+            auto repeated = dynamic_cast<TensorBroadcastView *>(child2.get());
+            child2RepeatsRows = repeated != nullptr && repeated->repeatsRows();
+        }
+
+    private:
+        bool child2RepeatsRows = false;
+
+        static bool fits(const shared_ptr<BaseTensor> &tensor, size_t rows, size_t columns, size_t channels) {
+            return TensorBroadcastView::canBroadcast(tensor->rowCount(), rows) &&
+                   TensorBroadcastView::canBroadcast(tensor->columnCount(), columns) &&
+                   TensorBroadcastView::canBroadcast(tensor->channelCount(), channels);
+        }
+
+        static shared_ptr<BaseTensor> broadcast(const shared_ptr<BaseTensor> &tensor, size_t rows, size_t columns,
+                                                size_t channels) {
+            if (tensor->rowCount() == rows && tensor->columnCount() == columns && tensor->channelCount() == channels) {
+                return tensor;
+            }
+            return makeView<TensorBroadcastView>(tensor, rows, columns, channels);
+        }
+    };
 
 }
 #endif //HAPPYML_TENSOR_HPP
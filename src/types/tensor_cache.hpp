@@ -0,0 +1,264 @@
+//
+// Created by Erik Hyrkas on 1/8/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_CACHE_HPP
+#define HAPPYML_TENSOR_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "../util/tensor_arena.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // Tiles are at most 64x64 floats (16kb.) Square tiles do equally well whether the reader walks rows (a dot
+    // product's left side) or columns (its right side), or little neighborhoods (convolutions.) Smaller tensors get
+    // tiles cut down to their size.
+    constexpr size_t TENSOR_CACHE_TILE_ROWS = 64;
+    constexpr size_t TENSOR_CACHE_TILE_COLUMNS = 64;
+    // Most memory one cached view holds on to before it starts throwing out the tiles it used least recently.
+    constexpr size_t TENSOR_CACHE_DEFAULT_BYTES = (size_t) 64 << 20;
+    // Tensors this small cost more to keep track of than to recompute.
+    constexpr size_t TENSOR_CACHE_MIN_ELEMENTS = 256;
+
+    // Sits between a view that gets read many times and whatever reads it. The first time anybody touches a
+    // tile, we work the tile out once (through the fused evaluator) and keep it, so every later read is a copy.
+    // It's the middle ground between leaving a tensor as a view, which recomputes each value every time it's
+    // read, and materializing it, which pays for the whole tensor up front.
+    //
+    // When the whole child fits under the memory cap, tiles are never thrown out, so once a tile is loaded we
+    // read it without taking any locks. When it doesn't fit, we keep the tiles we used most recently and read
+    // under a lock, since another thread may be about to throw out the tile we're reading.
+    //
+    // The cache assumes the child doesn't change while the view is alive. Views are cheap to rebuild, so build
+    // a new one rather than caching something that is being assigned to.
+    class TensorCachedView : public BaseTensorUnaryOperatorView {
+    public:
+        explicit TensorCachedView(const shared_ptr<BaseTensor> &tensor,
+                                  size_t maxCachedBytes = TENSOR_CACHE_DEFAULT_BYTES)
+                : BaseTensorUnaryOperatorView(tensor) {
+            totalRows = child->rowCount();
+            totalColumns = child->columnCount();
+            totalChannels = child->channelCount();
+            tileHeight = std::max((size_t) 1, std::min(TENSOR_CACHE_TILE_ROWS, totalRows));
+            tileWidth = std::max((size_t) 1, std::min(TENSOR_CACHE_TILE_COLUMNS, totalColumns));
+            tileRows = (totalRows + tileHeight - 1) / tileHeight;
+            tileColumns = (totalColumns + tileWidth - 1) / tileWidth;
+            tileCount = tileRows * tileColumns * totalChannels;
+            tiles = make_unique<CachedTile[]>(tileCount);
+            const size_t tile_bytes = tileHeight * tileWidth * sizeof(float);
+            maxTiles = std::max((size_t) 1, maxCachedBytes / tile_bytes);
+            evicts = tileCount > maxTiles;
+            loadedTiles = 0;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorCachedView{" << rowCount() << "," << columnCount() << "," << channelCount() << "}->";
+            child->printMaterializationPlan();
+        }
+
+        size_t rowCount() override {
+            return totalRows;
+        }
+
+        size_t columnCount() override {
+            return totalColumns;
+        }
+
+        size_t channelCount() override {
+            return totalChannels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const size_t tile_row = row / tileHeight;
+            const size_t tile_column = column / tileWidth;
+            const size_t offset = ((row % tileHeight) * tileWidth) + (column % tileWidth);
+            const size_t index = tileIndex(tile_row, tile_column, channel);
+            if (!evicts) {
+                return loadedTile(index)[offset];
+            }
+            lock_guard<mutex> guard(lruLock);
+            return touchTile(index)[offset];
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            readTile(row, 1, firstColumn, count, channel, out, count);
+        }
+
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            if (rows == 0 || columns == 0) {
+                return;
+            }
+            const size_t last_row = firstRow + rows;
+            const size_t last_column = firstColumn + columns;
+            for (size_t tile_row = firstRow / tileHeight; tile_row * tileHeight < last_row; tile_row++) {
+                const size_t tile_first_row = tile_row * tileHeight;
+                const size_t row_start = std::max(firstRow, tile_first_row);
+                const size_t row_end = std::min(last_row, tile_first_row + tileHeight);
+                for (size_t tile_column = firstColumn / tileWidth; tile_column * tileWidth < last_column;
+                     tile_column++) {
+                    const size_t tile_first_column = tile_column * tileWidth;
+                    const size_t column_start = std::max(firstColumn, tile_first_column);
+                    const size_t column_end = std::min(last_column, tile_first_column + tileWidth);
+                    const size_t index = tileIndex(tile_row, tile_column, channel);
+                    unique_lock<mutex> guard(lruLock, defer_lock);
+                    const float *values;
+                    if (evicts) {
+                        guard.lock();
+                        values = touchTile(index);
+                    } else {
+                        values = loadedTile(index);
+                    }
+                    for (size_t row = row_start; row < row_end; row++) {
+                        std::memcpy(out + ((row - firstRow) * outRowStride) + (column_start - firstColumn),
+                                    values + ((row - tile_first_row) * tileWidth) +
+                                    (column_start - tile_first_column),
+                                    (column_end - column_start) * sizeof(float));
+                    }
+                }
+            }
+        }
+
+        // number of tiles we are holding right now
+        size_t cachedTileCount() {
+            lock_guard<mutex> guard(lruLock);
+            return loadedTiles;
+        }
+
+        // number of times we've had to work out a tile from the child
+        [[nodiscard]] size_t tileLoadCount() const {
+            return tileLoads.load(memory_order_relaxed);
+        }
+
+    private:
+        struct CachedTile {
+            atomic<const float *> ready{nullptr};
+            ArenaBuffer<float> values;
+            list<size_t>::iterator lruPosition;
+        };
+
+        static constexpr size_t LOAD_LOCKS = 16;
+
+        size_t totalRows;
+        size_t totalColumns;
+        size_t totalChannels;
+        size_t tileHeight;
+        size_t tileWidth;
+        // how many tiles it takes to cover one channel, top to bottom and left to right
+        size_t tileRows;
+        size_t tileColumns;
+        size_t tileCount;
+        size_t maxTiles;
+        size_t loadedTiles;
+        bool evicts;
+        unique_ptr<CachedTile[]> tiles;
+        // most recently used at the front. Only used when we evict.
+        list<size_t> lru;
+        mutex lruLock;
+        // threads loading different tiles don't wait for each other, unless they happen to share a lock.
+        mutex loadLocks[LOAD_LOCKS];
+        atomic<size_t> tileLoads{0};
+
+        [[nodiscard]] inline size_t tileIndex(size_t tileRow, size_t tileColumn, size_t channel) const {
+            return (((channel * tileRows) + tileRow) * tileColumns) + tileColumn;
+        }
+
+        // Tiles at the right and bottom edges hang off of the tensor. We only fill in the part that's inside it.
+        void loadTile(size_t index, CachedTile &tile) {
+            const size_t channel = index / (tileRows * tileColumns);
+            const size_t tile_row = (index / tileColumns) % tileRows;
+            const size_t tile_column = index % tileColumns;
+            const size_t first_row = tile_row * tileHeight;
+            const size_t first_column = tile_column * tileWidth;
+            tile.values.resize(tileHeight * tileWidth);
+            readTileFused(child, first_row, std::min(tileHeight, totalRows - first_row),
+                          first_column, std::min(tileWidth, totalColumns - first_column), channel,
+                          tile.values.data(), tileWidth);
+            tileLoads.fetch_add(1, memory_order_relaxed);
+        }
+
+        // only used when we never evict, so a tile stays put once it's ready.
+        const float *loadedTile(size_t index) {
+            CachedTile &tile = tiles[index];
+            const float *values = tile.ready.load(memory_order_acquire);
+            if (values != nullptr) {
+                return values;
+            }
+            lock_guard<mutex> guard(loadLocks[index % LOAD_LOCKS]);
+            values = tile.ready.load(memory_order_acquire);
+            if (values == nullptr) {
+                loadTile(index, tile);
+                values = tile.values.data();
+                {
+                    lock_guard<mutex> count_guard(lruLock);
+                    loadedTiles++;
+                }
+                tile.ready.store(values, memory_order_release);
+            }
+            return values;
+        }
+
+        // caller holds lruLock.
+        const float *touchTile(size_t index) {
+            CachedTile &tile = tiles[index];
+            const float *values = tile.ready.load(memory_order_relaxed);
+            if (values != nullptr) {
+                lru.splice(lru.begin(), lru, tile.lruPosition);
+                return values;
+            }
+            if (loadedTiles >= maxTiles) {
+                CachedTile &oldest = tiles[lru.back()];
+                oldest.ready.store(nullptr, memory_order_relaxed);
+                oldest.values.release();
+                lru.pop_back();
+                loadedTiles--;
+            }
+            loadTile(index, tile);
+            lru.push_front(index);
+            tile.lruPosition = lru.begin();
+            loadedTiles++;
+            values = tile.values.data();
+            tile.ready.store(values, memory_order_relaxed);
+            return values;
+        }
+    };
+
+    // True when reading a value only means finding it in memory: the tensor is in memory, or it's a chain of
+    // views that just move values around (padding, rotating, picking a channel, ...) on top of one that is.
+    inline bool isCheapToRead(const shared_ptr<BaseTensor> &tensor) {
+        TensorBufferLayout layout;
+        if (tensor->isMaterialized() || tensor->bufferLayout(layout) ||
+            dynamic_cast<TensorCachedView *>(tensor.get()) != nullptr) {
+            return true;
+        }
+        if (dynamic_cast<BaseTensorElementwiseUnaryView *>(tensor.get()) != nullptr) {
+            return false;
+        }
+        if (auto unary = dynamic_cast<BaseTensorUnaryOperatorView *>(tensor.get())) {
+            return isCheapToRead(unary->getChild());
+        }
+        return false;
+    }
+
+    // Dot products and convolutions read each value of their inputs many times. If an input is a view that
+    // would work its values out again on every read, we put a cache in front of it.
+    inline shared_ptr<BaseTensor> cacheForRepeatedReads(const shared_ptr<BaseTensor> &tensor) {
+        if (tensor->size() <= TENSOR_CACHE_MIN_ELEMENTS || isCheapToRead(tensor)) {
+            return tensor;
+        }
+        return makeView<TensorCachedView>(tensor);
+    }
+}
+
+#endif //HAPPYML_TENSOR_CACHE_HPP
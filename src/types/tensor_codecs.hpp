@@ -0,0 +1,106 @@
+//
+// Created by Erik Hyrkas on 1/9/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_CODECS_HPP
+#define HAPPYML_TENSOR_CODECS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "quarter_float.hpp"
+#include "half_float.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // A codec says how a materialized tensor stores a float: which type it keeps in memory (stored_type) and how
+    // to turn a float into one (encode) and back (decode.) DenseTensor takes the codec as a template parameter,
+    // so the conversions are inlined right into the loops that read and write values.
+
+    // 32-bit floats, stored as they are.
+    struct FloatCodec {
+        using stored_type = float;
+
+        [[nodiscard]] inline float decode(const float value) const {
+            return value;
+        }
+
+        [[nodiscard]] inline float encode(const float value) const {
+            return value;
+        }
+    };
+
+    // A value between 0.0f and 1.0f in 256 even steps (8-bits.) Anything outside that range is clamped.
+    struct PixelCodec {
+        using stored_type = uint8_t;
+
+        [[nodiscard]] inline float decode(const uint8_t value) const {
+            return ((float) value) / 255.f;
+        }
+
+        [[nodiscard]] inline uint8_t encode(const float value) const {
+            return (uint8_t) (std::max(0.0f, std::min(value, 1.0f)) * 255);
+        }
+    };
+
+    // 8-bit floats. The bias picks the range of values they can hold (see quarter_float.hpp.)
+    struct QuarterCodec {
+        using stored_type = quarter;
+
+        explicit QuarterCodec(const int bias) : bias(bias) {
+        }
+
+        [[nodiscard]] inline float decode(const quarter value) const {
+            return quarterToFloat(value, bias);
+        }
+
+        [[nodiscard]] inline quarter encode(const float value) const {
+            return floatToQuarter(value, bias);
+        }
+
+        int bias;
+    };
+
+    // 16-bit floats.
+    struct HalfCodec {
+        using stored_type = half;
+
+        [[nodiscard]] inline float decode(const half value) const {
+            return halfToFloat(value);
+        }
+
+        [[nodiscard]] inline half encode(const float value) const {
+            return floatToHalf(value);
+        }
+    };
+
+    template<typename Codec>
+    inline void decodeValues(const Codec &codec, const typename Codec::stored_type *values, size_t count,
+                             float *out) {
+        if constexpr (is_same<Codec, FloatCodec>::value) {
+            std::memcpy(out, values, count * sizeof(float));
+        } else {
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = codec.decode(values[offset]);
+            }
+        }
+    }
+
+    template<typename Codec>
+    inline void encodeValues(const Codec &codec, const float *values, size_t count,
+                             typename Codec::stored_type *out) {
+        if constexpr (is_same<Codec, FloatCodec>::value) {
+            std::memcpy(out, values, count * sizeof(float));
+        } else {
+            for (size_t offset = 0; offset < count; offset++) {
+                out[offset] = codec.encode(values[offset]);
+            }
+        }
+    }
+}
+
+#endif //HAPPYML_TENSOR_CODECS_HPP
@@ -0,0 +1,171 @@
+//
+// Created by Erik Hyrkas on 1/12/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_DERIVED_CACHE_HPP
+#define HAPPYML_TENSOR_DERIVED_CACHE_HPP
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include "tensor.hpp"
+#include "tensor_views.hpp"
+#include "materialized_tensors.hpp"
+#include "packed_tensors.hpp"
+#include "channel_last_tensors.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // The forms of a tensor we know how to work out and keep.
+    enum class DerivedRepresentation {
+        // the transpose, laid out in its own buffer so that rows of it are rows in memory
+        transposed,
+        // 32-bit floats, for tensors we store in 16 or 8 bits
+        decoded,
+        // 32-bit floats in the order the matrix multiply kernel reads them (a PackedGemmTensor)
+        packedForGemm,
+        // 32-bit floats with every channel of a location together (a ChannelLastTensor)
+        channelsLast
+    };
+
+    struct DerivedTensorCacheCounters {
+        // times we handed back something we already had
+        size_t hits = 0;
+        // times we had to build it
+        size_t builds = 0;
+    };
+
+    // Between two weight updates, a layer reads its weights the same way over and over: every prediction decodes
+    // (or packs) the same values and every backward pass transposes the same matrix. We work each of those out once
+    // and keep it, keyed by the tensor's id, its generation and the representation. When the tensor is assigned
+    // to, its generation goes up and the next request builds the form again. When it's replaced by a new tensor,
+    // the new tensor has a new id.
+    //
+    // Only tensors that track a generation (materialized ones) get cached. A view could be reading anything, so
+    // we'd have no way to tell when what we kept went stale.
+    //
+    // We hold a weak pointer to each source tensor and throw out what we kept for it once it's gone.
+    class DerivedTensorCache {
+    public:
+        template<typename Build>
+        shared_ptr<BaseTensor> get(const shared_ptr<BaseTensor> &source, DerivedRepresentation representation,
+                                   Build build) {
+            auto assignable = dynamic_pointer_cast<BaseAssignableTensor>(source);
+            if (!assignable) {
+                builds.fetch_add(1, memory_order_relaxed);
+                return build();
+            }
+            const auto key = make_pair(assignable->id(), representation);
+            const uint64_t generation = assignable->generation();
+            {
+                lock_guard<mutex> guard(lock);
+                auto found = entries.find(key);
+                if (found != entries.end() && found->second.generation == generation) {
+                    hits.fetch_add(1, memory_order_relaxed);
+                    return found->second.derived;
+                }
+            }
+            // two threads asking at once may both build it, which is wasteful but harmless. Building while
+            // holding the lock would make every other tensor wait on this one.
+            auto derived = build();
+            builds.fetch_add(1, memory_order_relaxed);
+            lock_guard<mutex> guard(lock);
+            forgetExpired();
+            entries[key] = {generation, assignable, derived};
+            return derived;
+        }
+
+        // things we're holding right now
+        size_t size() {
+            lock_guard<mutex> guard(lock);
+            return entries.size();
+        }
+
+        void clear() {
+            lock_guard<mutex> guard(lock);
+            entries.clear();
+        }
+
+        [[nodiscard]] DerivedTensorCacheCounters getCounters() const {
+            DerivedTensorCacheCounters result;
+            result.hits = hits.load(memory_order_relaxed);
+            result.builds = builds.load(memory_order_relaxed);
+            return result;
+        }
+
+        // the cache the layers share
+        static DerivedTensorCache &shared() {
+            static DerivedTensorCache cache;
+            return cache;
+        }
+
+    private:
+        struct Entry {
+            uint64_t generation;
+            weak_ptr<BaseAssignableTensor> source;
+            shared_ptr<BaseTensor> derived;
+        };
+
+        mutex lock;
+        map<pair<uint64_t, DerivedRepresentation>, Entry> entries;
+        atomic<size_t> hits{0};
+        atomic<size_t> builds{0};
+
+        // caller holds lock.
+        void forgetExpired() {
+            for (auto entry = entries.begin(); entry != entries.end();) {
+                if (entry->second.source.expired()) {
+                    entry = entries.erase(entry);
+                } else {
+                    ++entry;
+                }
+            }
+        }
+    };
+
+    // A transposed copy of tensor, rebuilt only when tensor changes.
+    inline shared_ptr<BaseTensor> cachedTranspose(const shared_ptr<BaseTensor> &tensor) {
+        return DerivedTensorCache::shared().get(tensor, DerivedRepresentation::transposed, [&tensor]() {
+            return static_pointer_cast<BaseTensor>(make_shared<FullTensor>(makeView<TensorTransposeView>(tensor)));
+        });
+    }
+
+    // tensor as 32-bit floats, decoded only when tensor changes. Tensors that already keep 32-bit floats in a
+    // buffer (including mapped ones, which we don't want to copy into memory) come back as they are.
+    inline shared_ptr<BaseTensor> cachedDecode(const shared_ptr<BaseTensor> &tensor) {
+        TensorBufferLayout layout;
+        if (!tensor->isMaterialized() || tensor->bufferLayout(layout)) {
+            return tensor;
+        }
+        return DerivedTensorCache::shared().get(tensor, DerivedRepresentation::decoded, [&tensor]() {
+            return static_pointer_cast<BaseTensor>(make_shared<FullTensor>(tensor));
+        });
+    }
+
+    // tensor packed for the right side of a dot product, packed again only when tensor changes.
+    inline shared_ptr<BaseTensor> cachedPackForGemm(const shared_ptr<BaseTensor> &tensor) {
+        if (dynamic_cast<PackedGemmTensor *>(tensor.get()) != nullptr) {
+            return tensor;
+        }
+        return DerivedTensorCache::shared().get(tensor, DerivedRepresentation::packedForGemm, [&tensor]() {
+            return static_pointer_cast<BaseTensor>(make_shared<PackedGemmTensor>(tensor));
+        });
+    }
+
+    // tensor laid out channel-last, laid out again only when tensor changes.
+    inline shared_ptr<BaseTensor> cachedChannelsLast(const shared_ptr<BaseTensor> &tensor) {
+        if (channelLayoutOf(tensor) == ChannelLayout::channelsLast) {
+            return tensor;
+        }
+        return DerivedTensorCache::shared().get(tensor, DerivedRepresentation::channelsLast, [&tensor]() {
+            return static_pointer_cast<BaseTensor>(make_shared<ChannelLastTensor>(tensor));
+        });
+    }
+}
+
+#endif //HAPPYML_TENSOR_DERIVED_CACHE_HPP
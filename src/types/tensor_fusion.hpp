@@ -0,0 +1,198 @@
+//
+// Created by Erik Hyrkas on 1/3/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_FUSION_HPP
+#define HAPPYML_TENSOR_FUSION_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "tensor.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    // Forward and backward passes build deep stacks of views like:
+    //   minus(weights, multiplyByScalar(dot(transpose(input), error), learningRate))
+    // Reading a tile out of the top of that stack one view at a time means every elementwise view makes its own
+    // pass over the whole tile. When the tile is a whole channel of a big matrix, each of those passes goes
+    // out to main memory and back.
+    //
+    // The fused evaluator flattens the elementwise part of the tree into a short program, a bit like a compiler
+    // would. Non-elementwise views (dot product, convolution, reshape, ...) are "tile boundaries": we read each of
+    // them once for the whole tile. Then we walk the tile in small blocks that fit in the L1 cache and run the
+    // whole program on each block before moving to the next. Each instruction is a tight loop over a block, so
+    // there are no per-element virtual calls, and the values never leave the cache between instructions.
+    //
+    // Materialized tensors (and anything else that is already sitting in memory) are cheap to read, so they
+    // are streamed a block at a time rather than copied up front.
+    class FusedTensorEvaluator {
+    public:
+        explicit FusedTensorEvaluator(const shared_ptr<BaseTensor> &tensor) {
+            // we hold on to the root so the raw pointers in our steps can't outlive the views they point at.
+            root = tensor;
+            registerCount = 0;
+            compile(tensor, 0);
+        }
+
+        // Same contract as BaseTensor::readTile() on the root of the tree.
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) {
+            if (rows == 0 || columns == 0) {
+                return;
+            }
+            for (auto &boundary: boundaries) {
+                boundary.values.resize(rows * columns);
+                boundary.tensor->readTile(firstRow, rows, firstColumn, columns, channel, boundary.values.data(),
+                                          columns);
+            }
+            const size_t block_columns = std::min(columns, FUSED_BLOCK_ELEMENTS);
+            const size_t block_rows = std::max((size_t) 1, FUSED_BLOCK_ELEMENTS / block_columns);
+            ArenaBuffer<float> registers(registerCount * block_rows * block_columns);
+            for (size_t row_block = 0; row_block < rows; row_block += block_rows) {
+                const size_t current_rows = std::min(block_rows, rows - row_block);
+                for (size_t column_block = 0; column_block < columns; column_block += block_columns) {
+                    const size_t current_columns = std::min(block_columns, columns - column_block);
+                    const size_t count = current_rows * current_columns;
+                    for (const auto &step: steps) {
+                        float *target = registers.data() + (step.target * block_rows * block_columns);
+                        switch (step.kind) {
+                            case FusedStepKind::stream:
+                                step.leaf->readTile(firstRow + row_block, current_rows, firstColumn + column_block,
+                                                    current_columns, channel, target, current_columns);
+                                break;
+                            case FusedStepKind::boundary: {
+                                const float *source = boundaries[step.source].values.data() +
+                                                      (row_block * columns) + column_block;
+                                for (size_t row = 0; row < current_rows; row++) {
+                                    std::memcpy(target + (row * current_columns), source + (row * columns),
+                                                current_columns * sizeof(float));
+                                }
+                                break;
+                            }
+                            case FusedStepKind::unary:
+                                step.unary->transformValues(target, count);
+                                break;
+                            case FusedStepKind::binary:
+                                step.binary->combineValues(target, registers.data() +
+                                                                   (step.source * block_rows * block_columns), count);
+                                break;
+                        }
+                    }
+                    // the result of the whole tree always lands in the first register
+                    for (size_t row = 0; row < current_rows; row++) {
+                        std::memcpy(out + ((row_block + row) * outRowStride) + column_block,
+                                    registers.data() + (row * current_columns), current_columns * sizeof(float));
+                    }
+                }
+            }
+            for (auto &boundary: boundaries) {
+                boundary.values.release();
+            }
+        }
+
+        [[nodiscard]] size_t stepCount() const {
+            return steps.size();
+        }
+
+        [[nodiscard]] size_t boundaryCount() const {
+            return boundaries.size();
+        }
+
+        void printPlan() {
+            cout << "FusedTensorEvaluator{registers=" << registerCount << "}" << endl;
+            for (const auto &step: steps) {
+                switch (step.kind) {
+                    case FusedStepKind::stream:
+                        cout << "\tr" << step.target << " = stream ";
+                        step.leaf->printMaterializationPlan();
+                        break;
+                    case FusedStepKind::boundary:
+                        cout << "\tr" << step.target << " = boundary " << step.source << ": ";
+                        boundaries[step.source].tensor->printMaterializationPlan();
+                        break;
+                    case FusedStepKind::unary:
+                        cout << "\tr" << step.target << " = ";
+                        step.unary->printMaterializationPlan();
+                        cout << "r" << step.target;
+                        break;
+                    case FusedStepKind::binary:
+                        cout << "\tr" << step.target << " = r" << step.target << " <op> r" << step.source;
+                        break;
+                }
+                cout << endl;
+            }
+        }
+
+    private:
+        // Each register holds one block of floats. 1024 floats is 4kb, so a handful of them fit in L1.
+        static constexpr size_t FUSED_BLOCK_ELEMENTS = 1024;
+
+        enum class FusedStepKind {
+            stream, boundary, unary, binary
+        };
+
+        struct FusedStep {
+            FusedStepKind kind;
+            size_t target;
+            size_t source;
+            shared_ptr<BaseTensor> leaf;
+            BaseTensorElementwiseUnaryView *unary;
+            BaseTensorElementwiseBinaryView *binary;
+        };
+
+        struct FusedBoundary {
+            shared_ptr<BaseTensor> tensor;
+            ArenaBuffer<float> values;
+        };
+
+        vector<FusedStep> steps;
+        vector<FusedBoundary> boundaries;
+        shared_ptr<BaseTensor> root;
+        size_t registerCount;
+
+        // Registers are handed out like a stack: a node's result lands in the register at its depth, and the
+        // right side of a binary node uses the next one up. That keeps the register count at the depth of the
+        // deepest chain of binary nodes, rather than the number of nodes.
+        size_t compile(const shared_ptr<BaseTensor> &node, size_t depth) {
+            registerCount = std::max(registerCount, depth + 1);
+            if (auto unary = dynamic_cast<BaseTensorElementwiseUnaryView *>(node.get())) {
+                const size_t target = compile(unary->getChild(), depth);
+                steps.push_back({FusedStepKind::unary, target, 0, nullptr, unary, nullptr});
+                return target;
+            }
+            if (auto binary = dynamic_cast<BaseTensorElementwiseBinaryView *>(node.get())) {
+                const size_t target = compile(binary->getChild1(), depth);
+                const size_t source = compile(binary->getChild2(), depth + 1);
+                steps.push_back({FusedStepKind::binary, target, source, nullptr, nullptr, binary});
+                return target;
+            }
+            TensorBufferLayout layout;
+            if (node->isMaterialized() || node->bufferLayout(layout)) {
+                steps.push_back({FusedStepKind::stream, depth, 0, node, nullptr, nullptr});
+            } else {
+                steps.push_back({FusedStepKind::boundary, depth, boundaries.size(), nullptr, nullptr, nullptr});
+                boundaries.push_back({node, ArenaBuffer<float>()});
+            }
+            return depth;
+        }
+    };
+
+    // Reads a tile from a tensor, fusing the elementwise views at the top of the tree when there are any.
+    inline void readTileFused(const shared_ptr<BaseTensor> &tensor, size_t firstRow, size_t rows, size_t firstColumn,
+                              size_t columns, size_t channel, float *out, size_t outRowStride) {
+        if (dynamic_cast<BaseTensorElementwiseUnaryView *>(tensor.get()) == nullptr &&
+            dynamic_cast<BaseTensorElementwiseBinaryView *>(tensor.get()) == nullptr) {
+            tensor->readTile(firstRow, rows, firstColumn, columns, channel, out, outRowStride);
+            return;
+        }
+        FusedTensorEvaluator evaluator(tensor);
+        evaluator.readTile(firstRow, rows, firstColumn, columns, channel, out, outRowStride);
+    }
+}
+
+#endif //HAPPYML_TENSOR_FUSION_HPP
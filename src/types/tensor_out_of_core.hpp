@@ -0,0 +1,218 @@
+//
+// Created by Erik Hyrkas on 1/14/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_OUT_OF_CORE_HPP
+#define HAPPYML_TENSOR_OUT_OF_CORE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include "tensor.hpp"
+#include "tensor_views.hpp"
+#include "tensor_cache.hpp"
+#include "tensor_fusion.hpp"
+#include "mapped_tensors.hpp"
+#include "../util/gemm.hpp"
+#include "../util/tensor_arena.hpp"
+
+using namespace std;
+
+// Materializing a view means holding all of its values in memory at once, and so does the dot product's
+// usual approach of reading its whole right side before it starts. When the result (or the right side) is
+// bigger than memory, neither works. Here we work a view out a tile at a time and hand each tile off (usually
+// into a writable mapped tensor) before moving on to the next one, so the most memory we hold at once is the
+// tile budget, no matter how big the tensors are.
+//
+// The budget covers the buffers we read tiles into. The gemm kernel packs what it's given into a few megabytes
+// of its own, and a view in the middle of the tree may still read more than a tile of its children: only a dot
+// product at the root gets the out-of-core schedule. A dot product further down reads its whole right side
+// for every tile unless that side is already in a buffer (as a mapped tensor is.)
+namespace happyml {
+
+    // Most memory we read tiles into at once, unless told otherwise.
+    constexpr size_t OUT_OF_CORE_DEFAULT_TILE_BYTES = (size_t) 64 << 20;
+
+    // The tensor a cache sits in front of. We read each value once, so the cache wouldn't save us anything, and
+    // it would hold on to much more than our budget.
+    inline shared_ptr<BaseTensor> withoutReadCache(const shared_ptr<BaseTensor> &tensor) {
+        if (auto cached = dynamic_cast<TensorCachedView *>(tensor.get())) {
+            return cached->getChild();
+        }
+        return tensor;
+    }
+
+    // Calls consumer(row, channel, firstColumn, count, values) for every row of tensor, in the order values are
+    // kept in a file: channel, then row, then column. We read as many whole rows at a time as fit in tileBytes.
+    // A row that doesn't fit by itself comes a piece at a time.
+    template<typename Consumer>
+    void forEachRowWithinBudget(const shared_ptr<BaseTensor> &tensor, size_t tileBytes, Consumer consumer) {
+        const size_t rows = tensor->rowCount();
+        const size_t columns = tensor->columnCount();
+        const size_t channels = tensor->channelCount();
+        if (rows == 0 || columns == 0) {
+            return;
+        }
+        const size_t budget = std::max((size_t) 1, tileBytes / sizeof(float));
+        const size_t piece = std::min(columns, budget);
+        const size_t band = std::max((size_t) 1, std::min(rows, budget / piece));
+        ArenaBuffer<float> values(band * piece);
+        for (size_t channel = 0; channel < channels; channel++) {
+            for (size_t first_row = 0; first_row < rows; first_row += band) {
+                const size_t band_rows = std::min(band, rows - first_row);
+                for (size_t first_column = 0; first_column < columns; first_column += piece) {
+                    const size_t piece_columns = std::min(piece, columns - first_column);
+                    readTileFused(tensor, first_row, band_rows, first_column, piece_columns, channel,
+                                  values.data(), piece_columns);
+                    for (size_t row = 0; row < band_rows; row++) {
+                        consumer(first_row + row, channel, first_column, piece_columns,
+                                 values.data() + (row * piece_columns));
+                    }
+                }
+            }
+        }
+    }
+
+    // alpha * (left dot right), handed to consumer a row of a tile at a time, where each tile, and each piece of
+    // left and right we read to make it, fits in tileBytes. For a tile of the result, we walk along the inner
+    // dimension a block at a time: read a block of left and a block of right, multiply them, and add that into
+    // the tile. That reads left once per column of tiles and right once per row of tiles, but only a tile of
+    // either at a time, so both can be far bigger than memory.
+    //
+    // Tiles are square, with room for four of them: the block of left, the block of right, the product of those,
+    // and the running total.
+    template<typename Consumer>
+    void forEachDotRowWithinBudget(const shared_ptr<BaseTensor> &left, const shared_ptr<BaseTensor> &right,
+                                   float alpha, size_t tileBytes, Consumer consumer) {
+        if (left->columnCount() != right->rowCount() || left->channelCount() != right->channelCount()) {
+            throw exception("Dot product operands don't line up.");
+        }
+        const size_t rows = left->rowCount();
+        const size_t columns = right->columnCount();
+        const size_t inner = left->columnCount();
+        const size_t channels = left->channelCount();
+        if (rows == 0 || columns == 0) {
+            return;
+        }
+        const size_t budget = std::max((size_t) 4, tileBytes / sizeof(float));
+        const auto side = std::max((size_t) 1, (size_t) std::sqrt((double) (budget / 4)));
+        const size_t block_rows = std::min(side, rows);
+        const size_t block_columns = std::min(side, columns);
+        const size_t block_inner = std::max((size_t) 1, std::min(side, inner));
+        ArenaBuffer<float> left_block(block_rows * block_inner);
+        ArenaBuffer<float> right_block(block_inner * block_columns);
+        ArenaBuffer<float> product(block_rows * block_columns);
+        ArenaBuffer<float> total(block_rows * block_columns);
+        for (size_t channel = 0; channel < channels; channel++) {
+            for (size_t first_row = 0; first_row < rows; first_row += block_rows) {
+                const size_t tile_rows = std::min(block_rows, rows - first_row);
+                for (size_t first_column = 0; first_column < columns; first_column += block_columns) {
+                    const size_t tile_columns = std::min(block_columns, columns - first_column);
+                    std::fill(total.data(), total.data() + (tile_rows * tile_columns), 0.f);
+                    for (size_t first_inner = 0; first_inner < inner; first_inner += block_inner) {
+                        const size_t tile_inner = std::min(block_inner, inner - first_inner);
+                        readTileFused(left, first_row, tile_rows, first_inner, tile_inner, channel,
+                                      left_block.data(), tile_inner);
+                        readTileFused(right, first_inner, tile_inner, first_column, tile_columns, channel,
+                                      right_block.data(), tile_columns);
+                        gemm(tile_rows, tile_columns, tile_inner, {left_block.data(), tile_inner, 1},
+                             {right_block.data(), tile_columns, 1}, product.data(), tile_columns);
+                        const size_t tile_size = tile_rows * tile_columns;
+                        for (size_t offset = 0; offset < tile_size; offset++) {
+                            total.data()[offset] += product.data()[offset];
+                        }
+                    }
+                    for (size_t row = 0; row < tile_rows; row++) {
+                        float *values = total.data() + (row * tile_columns);
+                        if (alpha != 1.f) {
+                            for (size_t column = 0; column < tile_columns; column++) {
+                                values[column] *= alpha;
+                            }
+                        }
+                        consumer(first_row + row, channel, first_column, tile_columns, values);
+                    }
+                }
+            }
+        }
+    }
+
+    // Works out every value of tensor, a row of a tile at a time, without holding more than tileBytes of it.
+    // A dot product at the root gets the out-of-core dot schedule. Everything else is read in bands of rows.
+    template<typename Consumer>
+    void forEachRowOutOfCore(const shared_ptr<BaseTensor> &tensor, size_t tileBytes, Consumer consumer) {
+        if (auto dot = dynamic_cast<TensorDotTensorView *>(tensor.get())) {
+            forEachDotRowWithinBudget(withoutReadCache(dot->getChild1()), withoutReadCache(dot->getChild2()),
+                                      dot->get_alpha(), tileBytes, consumer);
+            return;
+        }
+        forEachRowWithinBudget(tensor, tileBytes, consumer);
+    }
+
+    // Writes every value of expression into target, a writable mapped tensor of the same shape, a tile at a time.
+    // Unlike assign(), this never copies the expression into memory, so expression can't read target: we'd
+    // overwrite values of target before we were done reading them.
+    template<typename MappedTensor>
+    void assignOutOfCore(const shared_ptr<MappedTensor> &target, const shared_ptr<BaseTensor> &expression,
+                         size_t tileBytes = OUT_OF_CORE_DEFAULT_TILE_BYTES) {
+        if (target->rowCount() != expression->rowCount() || target->columnCount() != expression->columnCount() ||
+            target->channelCount() != expression->channelCount()) {
+            throw exception("Can only assign a tensor of the same shape.");
+        }
+        if (!target->isWritable()) {
+            throw exception("Mapped tensor was opened read-only.");
+        }
+        if (expression->contains(target)) {
+            throw exception("Can't assign a tensor out of core from an expression that reads it.");
+        }
+        forEachRowOutOfCore(expression, tileBytes,
+                            [&target](size_t row, size_t channel, size_t firstColumn, size_t count,
+                                      const float *values) {
+                                target->setRowValues(row, channel, firstColumn, count, values);
+                            });
+    }
+
+    // Works out tensor into a new mapped tensor file at path, a tile at a time, and hands back the mapping
+    // (opened writable.) This is how to materialize, or save, a view that is too big to hold in memory. The bias
+    // is only used for 8-bit (quarter) encoding.
+    inline shared_ptr<BaseTensor> materializeToMappedFile(const shared_ptr<BaseTensor> &tensor, const string &path,
+                                                          MappedTensorEncoding encoding = MappedTensorEncoding::float32,
+                                                          int bias = 0,
+                                                          size_t tileBytes = OUT_OF_CORE_DEFAULT_TILE_BYTES) {
+        createMappedTensorFile(path, tensor->rowCount(), tensor->columnCount(), tensor->channelCount(), encoding,
+                               bias);
+        switch (encoding) {
+            case MappedTensorEncoding::float32: {
+                auto result = make_shared<MappedFullTensor>(path, true, MappedAccess::sequential);
+                assignOutOfCore(result, tensor, tileBytes);
+                result->flush();
+                return result;
+            }
+            case MappedTensorEncoding::half16: {
+                auto result = make_shared<MappedHalfTensor>(path, true, MappedAccess::sequential);
+                assignOutOfCore(result, tensor, tileBytes);
+                result->flush();
+                return result;
+            }
+            case MappedTensorEncoding::quarter8: {
+                auto result = make_shared<MappedQuarterTensor>(path, true, MappedAccess::sequential);
+                assignOutOfCore(result, tensor, tileBytes);
+                result->flush();
+                return result;
+            }
+        }
+        throw exception("Unknown mapped tensor encoding.");
+    }
+
+    // left dot right, written to a new mapped tensor file at path, for when the operands (which are usually
+    // mapped tensors themselves) or the result don't fit in memory.
+    inline shared_ptr<BaseTensor> dotToMappedFile(const shared_ptr<BaseTensor> &left,
+                                                  const shared_ptr<BaseTensor> &right, const string &path,
+                                                  size_t tileBytes = OUT_OF_CORE_DEFAULT_TILE_BYTES) {
+        return materializeToMappedFile(makeView<TensorDotTensorView>(left, right), path,
+                                       MappedTensorEncoding::float32, 0, tileBytes);
+    }
+}
+
+#endif //HAPPYML_TENSOR_OUT_OF_CORE_HPP
@@ -0,0 +1,260 @@
+//
+// Created by Erik Hyrkas on 1/11/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_REDUCTIONS_HPP
+#define HAPPYML_TENSOR_REDUCTIONS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "tensor_views.hpp"
+#include "materialized_tensors.hpp"
+#include "../util/tensor_arena.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    enum class TensorAxis {
+        rows, columns, channels
+    };
+
+    enum class AxisReduction {
+        sum, mean, max
+    };
+
+    // Runs task(0) ... task(tasks - 1), on as many threads as we have when there's enough work to be worth it.
+    // Each task writes its own part of the result, so the answer doesn't depend on how the tasks are scheduled.
+    template<typename Task>
+    void forEachReductionTask(size_t tasks, size_t elements, Task task) {
+        const size_t threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+        if (tasks == 1 || threads == 1 || elements < PARALLEL_REDUCE_THRESHOLD) {
+            for (size_t index = 0; index < tasks; index++) {
+                task(index);
+            }
+            return;
+        }
+        queue<future<void>> futures;
+        for (size_t index = 0; index < tasks; index++) {
+            futures.push(std::async(std::launch::async, task, index));
+            if (futures.size() >= threads) {
+                futures.front().get();
+                futures.pop();
+            }
+        }
+        while (!futures.empty()) {
+            futures.front().get();
+            futures.pop();
+        }
+    }
+
+    // Splits count into about pieces parts of at least minimum each, and returns the size of a part.
+    inline size_t reductionBand(size_t count, size_t pieces, size_t minimum) {
+        const size_t band = (count + pieces - 1) / std::max((size_t) 1, pieces);
+        return std::max((size_t) 1, std::min(count, std::max(band, minimum)));
+    }
+
+    inline float finishReduction(AxisReduction reduction, double value, size_t count) {
+        if (reduction == AxisReduction::mean) {
+            return (float) (value / (double) count);
+        }
+        return (float) value;
+    }
+
+    // Each column of a channel collapses to one value. We read a band of columns a block of rows at a time and
+    // keep one running value per column, so the inner loop walks a row with no dependencies between columns.
+    inline void reduceRows(const shared_ptr<BaseTensor> &tensor, AxisReduction reduction, FullTensor &result) {
+        const size_t rows = tensor->rowCount();
+        const size_t columns = tensor->columnCount();
+        const size_t channels = tensor->channelCount();
+        const size_t threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+        const size_t band_columns = reductionBand(columns, (threads * 4 + channels - 1) / channels, 64);
+        const size_t bands = (columns + band_columns - 1) / band_columns;
+        forEachReductionTask(bands * channels, rows * columns * channels, [&](size_t task) {
+            const size_t channel = task / bands;
+            const size_t first_column = (task % bands) * band_columns;
+            const size_t width = std::min(band_columns, columns - first_column);
+            const size_t block_rows = std::max((size_t) 1, std::min(rows, REDUCE_BLOCK_ELEMENTS / width));
+            ArenaBuffer<float> values(block_rows * width);
+            ArenaBuffer<double> totals(width);
+            double *running = totals.data();
+            const double start = reduction == AxisReduction::max ? -INFINITY : 0.0;
+            std::fill(running, running + width, start);
+            for (size_t first_row = 0; first_row < rows; first_row += block_rows) {
+                const size_t count = std::min(block_rows, rows - first_row);
+                readTileFused(tensor, first_row, count, first_column, width, channel, values.data(), width);
+                for (size_t row = 0; row < count; row++) {
+                    const float *row_values = values.data() + (row * width);
+                    if (reduction == AxisReduction::max) {
+                        for (size_t column = 0; column < width; column++) {
+                            const double val = row_values[column];
+                            running[column] = val > running[column] ? val : running[column];
+                        }
+                    } else {
+                        for (size_t column = 0; column < width; column++) {
+                            running[column] += (double) row_values[column];
+                        }
+                    }
+                }
+            }
+            float *out = result.rowValues(0, channel) + first_column;
+            for (size_t column = 0; column < width; column++) {
+                out[column] = finishReduction(reduction, running[column], rows);
+            }
+        });
+    }
+
+    // Each row collapses to one value, which is the same block reduction we use for the whole tensor.
+    inline void reduceColumns(const shared_ptr<BaseTensor> &tensor, AxisReduction reduction, FullTensor &result) {
+        const size_t rows = tensor->rowCount();
+        const size_t columns = tensor->columnCount();
+        const size_t channels = tensor->channelCount();
+        const size_t total_rows = rows * channels;
+        const size_t threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+        const size_t block_rows = std::max((size_t) 1, REDUCE_BLOCK_ELEMENTS / std::max((size_t) 1, columns));
+        const size_t band_rows = reductionBand(total_rows, threads * 4, block_rows);
+        const size_t bands = (total_rows + band_rows - 1) / band_rows;
+        forEachReductionTask(bands, total_rows * columns, [&](size_t band) {
+            const size_t last = std::min(total_rows, (band + 1) * band_rows);
+            ArenaBuffer<float> values(std::min(block_rows, band_rows) * columns);
+            // like reduceValues(), a band can run from the end of one channel into the next.
+            for (size_t position = band * band_rows; position < last;) {
+                const size_t channel = position / rows;
+                const size_t row = position % rows;
+                const size_t count = std::min(std::min(block_rows, last - position), rows - row);
+                readTileFused(tensor, row, count, 0, columns, channel, values.data(), columns);
+                for (size_t offset = 0; offset < count; offset++) {
+                    const float *row_values = values.data() + (offset * columns);
+                    double value;
+                    if (reduction == AxisReduction::max) {
+                        float min_value = INFINITY;
+                        float max_value = -INFINITY;
+                        minMaxOfBlock(row_values, columns, min_value, max_value);
+                        value = max_value;
+                    } else {
+                        value = sumOfBlock(row_values, columns);
+                    }
+                    result.rowValues(row + offset, channel)[0] = finishReduction(reduction, value, columns);
+                }
+                position += count;
+            }
+        });
+    }
+
+    // Output channel k collapses input channels k, k + groups, k + 2 * groups, ... We read the same rows of each of
+    // them in turn and fold them into one running block.
+    inline void reduceChannels(const shared_ptr<BaseTensor> &tensor, AxisReduction reduction, size_t groups,
+                               FullTensor &result) {
+        const size_t rows = tensor->rowCount();
+        const size_t columns = tensor->columnCount();
+        const size_t channels = tensor->channelCount();
+        const size_t reduced = channels / groups;
+        const size_t threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+        const size_t block_rows = std::max((size_t) 1, REDUCE_BLOCK_ELEMENTS / std::max((size_t) 1, columns));
+        const size_t band_rows = reductionBand(rows, (threads * 4 + groups - 1) / groups, 1);
+        const size_t bands = (rows + band_rows - 1) / band_rows;
+        forEachReductionTask(bands * groups, rows * columns * channels, [&](size_t task) {
+            const size_t group = task / bands;
+            const size_t first_band_row = (task % bands) * band_rows;
+            const size_t last_band_row = std::min(rows, first_band_row + band_rows);
+            const size_t block = std::min(block_rows, band_rows);
+            ArenaBuffer<float> values(block * columns);
+            ArenaBuffer<double> totals(block * columns);
+            double *running = totals.data();
+            for (size_t first_row = first_band_row; first_row < last_band_row; first_row += block) {
+                const size_t count = std::min(block, last_band_row - first_row);
+                const size_t elements = count * columns;
+                const double start = reduction == AxisReduction::max ? -INFINITY : 0.0;
+                std::fill(running, running + elements, start);
+                for (size_t index = 0; index < reduced; index++) {
+                    readTileFused(tensor, first_row, count, 0, columns, group + (index * groups), values.data(),
+                                  columns);
+                    const float *next = values.data();
+                    if (reduction == AxisReduction::max) {
+                        for (size_t offset = 0; offset < elements; offset++) {
+                            const double val = next[offset];
+                            running[offset] = val > running[offset] ? val : running[offset];
+                        }
+                    } else {
+                        for (size_t offset = 0; offset < elements; offset++) {
+                            running[offset] += (double) next[offset];
+                        }
+                    }
+                }
+                float *out = result.rowValues(first_row, group);
+                for (size_t offset = 0; offset < elements; offset++) {
+                    out[offset] = finishReduction(reduction, running[offset], reduced);
+                }
+            }
+        });
+    }
+
+    // Collapses one axis of a tensor to a single value per position, keeping the other two. Reducing rows gives
+    // one row, reducing columns gives one column, and reducing channels gives one channel. Sums and means are
+    // added up in doubles, in the same order no matter how many threads there are.
+    //
+    // When reducing channels, groups splits the channels into that many interleaved sets and reduces each one
+    // on its own: output channel k is made from input channels k, k + groups, k + 2 * groups, and so on.
+    inline shared_ptr<FullTensor> reduceAlongAxis(const shared_ptr<BaseTensor> &tensor, TensorAxis axis,
+                                                  AxisReduction reduction, size_t groups = 1) {
+        const size_t rows = tensor->rowCount();
+        const size_t columns = tensor->columnCount();
+        const size_t channels = tensor->channelCount();
+        if (rows == 0 || columns == 0 || channels == 0) {
+            throw exception("Can't reduce a tensor with no values.");
+        }
+        shared_ptr<FullTensor> result;
+        if (axis == TensorAxis::rows) {
+            result = make_shared<FullTensor>(1, columns, channels);
+            reduceRows(tensor, reduction, *result);
+        } else if (axis == TensorAxis::columns) {
+            result = make_shared<FullTensor>(rows, 1, channels);
+            reduceColumns(tensor, reduction, *result);
+        } else {
+            if (groups == 0 || channels % groups != 0) {
+                throw exception("Channels must divide evenly into groups to be reduced.");
+            }
+            result = make_shared<FullTensor>(rows, columns, groups);
+            reduceChannels(tensor, reduction, groups, *result);
+        }
+        return result;
+    }
+
+    inline shared_ptr<FullTensor> sumAlongAxis(const shared_ptr<BaseTensor> &tensor, TensorAxis axis) {
+        return reduceAlongAxis(tensor, axis, AxisReduction::sum);
+    }
+
+    inline shared_ptr<FullTensor> meanAlongAxis(const shared_ptr<BaseTensor> &tensor, TensorAxis axis) {
+        return reduceAlongAxis(tensor, axis, AxisReduction::mean);
+    }
+
+    inline shared_ptr<FullTensor> maxAlongAxis(const shared_ptr<BaseTensor> &tensor, TensorAxis axis) {
+        return reduceAlongAxis(tensor, axis, AxisReduction::max);
+    }
+
+    // The element by element average of tensors of the same shape, like the inputs of one batch.
+    inline shared_ptr<FullTensor> averageTensors(const vector<shared_ptr<BaseTensor>> &tensors) {
+        if (tensors.empty()) {
+            throw exception("Can't average zero tensors.");
+        }
+        const size_t channels = tensors[0]->channelCount();
+        for (const auto &tensor: tensors) {
+            if (tensor->channelCount() != channels) {
+                throw exception("Only tensors of the same shape can be averaged.");
+            }
+        }
+        // tensor i's channel k is channel (i * channels) + k of the stack, so grouping by channels lines them up.
+        auto stacked = makeView<TensorConcatChannelsView>(tensors);
+        return reduceAlongAxis(stacked, TensorAxis::channels, AxisReduction::mean, channels);
+    }
+}
+
+#endif //HAPPYML_TENSOR_REDUCTIONS_HPP
@@ -0,0 +1,277 @@
+//
+// Created by Erik Hyrkas on 1/10/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_SIMPLIFY_HPP
+#define HAPPYML_TENSOR_SIMPLIFY_HPP
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include "tensor.hpp"
+#include "tensor_cache.hpp"
+#include "tensor_views.hpp"
+
+using namespace std;
+
+namespace happyml {
+
+    struct TensorSimplifierCounters {
+        // graphs we've looked at
+        size_t passes = 0;
+        // views we were able to take out of them
+        size_t removedNodes = 0;
+    };
+
+    // The layers build their math as views and don't check whether any of it is doing nothing. A linear
+    // activation's derivative is a tensor of ones that gets multiplied into the error, the bias starts out as a
+    // tensor of zeros that gets added to the output, there are no-op views, scalars multiplied by scalars, and so on.
+    // Each of these costs a virtual call per value, or worse, a pass over the whole tensor.
+    //
+    // Right before we materialize a graph, we rewrite it:
+    //   x * 1 -> x, x + 0 -> x, x - 0 -> x, 0 - x -> -1 * x, x * c (uniform) -> c * x, x + c (uniform) -> x + c
+    //   (x * a) * b -> x * ab, (x + a) + b -> x + (a + b), and the same with a uniform tensor for x
+    //   no-op(x) -> x, transpose(transpose(x)) -> x
+    //   (a * x) dot (b * y) -> (x dot y) with alpha = ab, and c * (x dot y) -> (x dot y) with alpha = c
+    //
+    // We only look inside the views we know how to rebuild. Anything else we leave as it is, children and all.
+    // The rewritten graph shares every node it didn't change with the original, which stays valid.
+    class TensorSimplifier {
+    public:
+        shared_ptr<BaseTensor> simplify(const shared_ptr<BaseTensor> &tensor) {
+            const size_t removed_before = removed;
+            auto result = rewrite(tensor);
+            totals().passes.fetch_add(1, memory_order_relaxed);
+            totals().removedNodes.fetch_add(removed - removed_before, memory_order_relaxed);
+            return result;
+        }
+
+        // views removed by this simplifier so far
+        [[nodiscard]] size_t removedNodes() const {
+            return removed;
+        }
+
+        // everything removed by every simplifier since the program started
+        static TensorSimplifierCounters getCounters() {
+            TensorSimplifierCounters result;
+            result.passes = totals().passes.load(memory_order_relaxed);
+            result.removedNodes = totals().removedNodes.load(memory_order_relaxed);
+            return result;
+        }
+
+    private:
+        struct AtomicCounters {
+            atomic<size_t> passes{0};
+            atomic<size_t> removedNodes{0};
+        };
+
+        size_t removed = 0;
+        // graphs often share nodes (the loss reads each prediction twice, for instance), so we rewrite each once.
+        unordered_map<BaseTensor *, shared_ptr<BaseTensor>> rewritten;
+
+        static AtomicCounters &totals() {
+            static AtomicCounters counters;
+            return counters;
+        }
+
+        shared_ptr<BaseTensor> rewrite(const shared_ptr<BaseTensor> &tensor) {
+            auto found = rewritten.find(tensor.get());
+            if (found != rewritten.end()) {
+                return found->second;
+            }
+            auto result = rewriteNode(tensor);
+            rewritten[tensor.get()] = result;
+            return result;
+        }
+
+        static bool isUniform(const shared_ptr<BaseTensor> &tensor, float value) {
+            auto uniform = dynamic_cast<UniformTensor *>(tensor.get());
+            return uniform != nullptr && uniform->get_value() == value;
+        }
+
+        static shared_ptr<BaseTensor> uniformLike(const shared_ptr<BaseTensor> &tensor, float value) {
+            return make_shared<UniformTensor>(tensor->rowCount(), tensor->columnCount(), tensor->channelCount(),
+                                              value);
+        }
+
+        shared_ptr<BaseTensor> rewriteNode(const shared_ptr<BaseTensor> &tensor) {
+            BaseTensor *node = tensor.get();
+            if (auto no_op = dynamic_cast<TensorNoOpView *>(node)) {
+                removed++;
+                return rewrite(no_op->getChild());
+            }
+            if (auto scale = dynamic_cast<TensorMultiplyByScalarView *>(node)) {
+                return rewriteScale(tensor, rewrite(scale->getChild()), scale->get_scale());
+            }
+            if (auto add = dynamic_cast<TensorAddScalarView *>(node)) {
+                return rewriteAddScalar(tensor, rewrite(add->getChild()), add->get_adjustment());
+            }
+            if (auto transpose = dynamic_cast<TensorTransposeView *>(node)) {
+                auto child = rewrite(transpose->getChild());
+                if (auto inner = dynamic_cast<TensorTransposeView *>(child.get())) {
+                    removed += 2;
+                    return inner->getChild();
+                }
+                return child == transpose->getChild() ? tensor : makeView<TensorTransposeView>(child);
+            }
+            if (auto transform = dynamic_cast<TensorValueTransformView *>(node)) {
+                auto child = rewrite(transform->getChild());
+                return child == transform->getChild() ? tensor : makeView<TensorValueTransformView>(
+                        child, transform->get_transform_function());
+            }
+            if (auto activation = dynamic_cast<BaseTensorActivationView *>(node)) {
+                auto child = rewrite(activation->getChild());
+                return child == activation->getChild() ? tensor : activation->withChild(child);
+            }
+            if (auto dot = dynamic_cast<TensorDotTensorView *>(node)) {
+                return rewriteDot(tensor, *dot, 1.f);
+            }
+            if (auto multiply = dynamic_cast<TensorMultiplyTensorView *>(node)) {
+                return rewriteMultiply(tensor, rewrite(multiply->getChild1()), rewrite(multiply->getChild2()));
+            }
+            if (auto add = dynamic_cast<TensorAddTensorView *>(node)) {
+                return rewriteAdd(tensor, rewrite(add->getChild1()), rewrite(add->getChild2()));
+            }
+            if (auto minus = dynamic_cast<TensorMinusTensorView *>(node)) {
+                return rewriteMinus(tensor, rewrite(minus->getChild1()), rewrite(minus->getChild2()));
+            }
+            return tensor;
+        }
+
+        shared_ptr<BaseTensor> rewriteScale(const shared_ptr<BaseTensor> &original,
+                                            const shared_ptr<BaseTensor> &child, float scale) {
+            if (scale == 1.f) {
+                removed++;
+                return child;
+            }
+            if (auto inner = dynamic_cast<TensorMultiplyByScalarView *>(child.get())) {
+                removed++;
+                return rewriteScale(original, inner->getChild(), inner->get_scale() * scale);
+            }
+            if (auto uniform = dynamic_cast<UniformTensor *>(child.get())) {
+                removed++;
+                return uniformLike(child, uniform->get_value() * scale);
+            }
+            if (auto dot = dynamic_cast<TensorDotTensorView *>(child.get())) {
+                removed++;
+                return rewriteDot(child, *dot, scale);
+            }
+            auto scale_view = dynamic_cast<TensorMultiplyByScalarView *>(original.get());
+            if (scale_view != nullptr && scale_view->getChild() == child && scale_view->get_scale() == scale) {
+                return original;
+            }
+            return makeView<TensorMultiplyByScalarView>(child, scale);
+        }
+
+        shared_ptr<BaseTensor> rewriteAddScalar(const shared_ptr<BaseTensor> &original,
+                                                const shared_ptr<BaseTensor> &child, float adjustment) {
+            if (adjustment == 0.f) {
+                removed++;
+                return child;
+            }
+            if (auto inner = dynamic_cast<TensorAddScalarView *>(child.get())) {
+                removed++;
+                return rewriteAddScalar(original, inner->getChild(), inner->get_adjustment() + adjustment);
+            }
+            if (auto uniform = dynamic_cast<UniformTensor *>(child.get())) {
+                removed++;
+                return uniformLike(child, uniform->get_value() + adjustment);
+            }
+            auto add_view = dynamic_cast<TensorAddScalarView *>(original.get());
+            if (add_view != nullptr && add_view->getChild() == child && add_view->get_adjustment() == adjustment) {
+                return original;
+            }
+            return makeView<TensorAddScalarView>(child, adjustment);
+        }
+
+        // The dot product put caches in front of its children when it was built. We look past them, since the
+        // new dot product will put back whatever it still needs.
+        static shared_ptr<BaseTensor> uncached(const shared_ptr<BaseTensor> &tensor) {
+            if (auto cached = dynamic_cast<TensorCachedView *>(tensor.get())) {
+                return cached->getChild();
+            }
+            return tensor;
+        }
+
+        shared_ptr<BaseTensor> rewriteDot(const shared_ptr<BaseTensor> &original, TensorDotTensorView &dot,
+                                          float scale) {
+            auto left = rewrite(uncached(dot.getChild1()));
+            auto right = rewrite(uncached(dot.getChild2()));
+            float alpha = dot.get_alpha() * scale;
+            while (auto left_scale = dynamic_cast<TensorMultiplyByScalarView *>(left.get())) {
+                alpha *= left_scale->get_scale();
+                left = left_scale->getChild();
+                removed++;
+            }
+            while (auto right_scale = dynamic_cast<TensorMultiplyByScalarView *>(right.get())) {
+                alpha *= right_scale->get_scale();
+                right = right_scale->getChild();
+                removed++;
+            }
+            if (alpha == dot.get_alpha() && left == uncached(dot.getChild1()) && right == uncached(dot.getChild2())) {
+                return original;
+            }
+            return makeView<TensorDotTensorView>(left, right, alpha);
+        }
+
+        shared_ptr<BaseTensor> rewriteMultiply(const shared_ptr<BaseTensor> &original,
+                                               const shared_ptr<BaseTensor> &left,
+                                               const shared_ptr<BaseTensor> &right) {
+            if (auto uniform = dynamic_cast<UniformTensor *>(left.get())) {
+                removed++;
+                return rewriteScale(original, right, uniform->get_value());
+            }
+            if (auto uniform = dynamic_cast<UniformTensor *>(right.get())) {
+                removed++;
+                return rewriteScale(original, left, uniform->get_value());
+            }
+            auto multiply = dynamic_cast<TensorMultiplyTensorView *>(original.get());
+            if (multiply->getChild1() == left && multiply->getChild2() == right) {
+                return original;
+            }
+            return makeView<TensorMultiplyTensorView>(left, right);
+        }
+
+        shared_ptr<BaseTensor> rewriteAdd(const shared_ptr<BaseTensor> &original, const shared_ptr<BaseTensor> &left,
+                                          const shared_ptr<BaseTensor> &right) {
+            if (auto uniform = dynamic_cast<UniformTensor *>(left.get())) {
+                removed++;
+                return rewriteAddScalar(original, right, uniform->get_value());
+            }
+            if (auto uniform = dynamic_cast<UniformTensor *>(right.get())) {
+                removed++;
+                return rewriteAddScalar(original, left, uniform->get_value());
+            }
+            auto add = dynamic_cast<TensorAddTensorView *>(original.get());
+            if (add->getChild1() == left && add->getChild2() == right) {
+                return original;
+            }
+            return makeView<TensorAddTensorView>(left, right);
+        }
+
+        shared_ptr<BaseTensor> rewriteMinus(const shared_ptr<BaseTensor> &original, const shared_ptr<BaseTensor> &left,
+                                            const shared_ptr<BaseTensor> &right) {
+            if (auto uniform = dynamic_cast<UniformTensor *>(right.get())) {
+                removed++;
+                return rewriteAddScalar(original, left, -uniform->get_value());
+            }
+            if (isUniform(left, 0.f)) {
+                removed++;
+                return rewriteScale(original, right, -1.f);
+            }
+            auto minus = dynamic_cast<TensorMinusTensorView *>(original.get());
+            if (minus->getChild1() == left && minus->getChild2() == right) {
+                return original;
+            }
+            return makeView<TensorMinusTensorView>(left, right);
+        }
+    };
+
+    inline shared_ptr<BaseTensor> simplifyTensor(const shared_ptr<BaseTensor> &tensor) {
+        TensorSimplifier simplifier;
+        return simplifier.simplify(tensor);
+    }
+}
+
+#endif //HAPPYML_TENSOR_SIMPLIFY_HPP
@@ -6,6 +6,7 @@
 #ifndef HAPPYML_TENSOR_VIEWS_HPP
 #define HAPPYML_TENSOR_VIEWS_HPP
 
+#include <algorithm>
 #include <execution>
 #include <future>
 #include <iterator>
@@ -14,16 +15,24 @@
 #include <iomanip>
 #include <sstream>
 #include "tensor.hpp"
+#include "tensor_fusion.hpp"
+#include "tensor_cache.hpp"
+#include "packed_tensors.hpp"
+#include "bit_tensors.hpp"
+#include "sparse_tensors.hpp"
+#include "channel_last_tensors.hpp"
+#include "../util/fast_math.hpp"
+#include "../util/gemm.hpp"
 
 using namespace std;
 
 namespace happyml {
 
 // Adds a constant to every value of a matrix through a view
-    class TensorAddScalarView : public BaseTensorUnaryOperatorView {
+    class TensorAddScalarView : public BaseTensorElementwiseUnaryView {
     public:
         TensorAddScalarView(const shared_ptr<BaseTensor> &tensor, float adjustment)
-                : BaseTensorUnaryOperatorView(tensor) {
+                : BaseTensorElementwiseUnaryView(tensor) {
             this->adjustment = adjustment;
         }
 
@@ -36,6 +45,12 @@ namespace happyml {
             return child->getValue(row, column, channel) + adjustment;
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] += adjustment;
+            }
+        }
+
         [[nodiscard]] float get_adjustment() const {
             return adjustment;
         }
@@ -45,10 +60,10 @@ namespace happyml {
     };
 
 // Multiply each element of the tensor by a constant.
-    class TensorMultiplyByScalarView : public BaseTensorUnaryOperatorView {
+    class TensorMultiplyByScalarView : public BaseTensorElementwiseUnaryView {
     public:
-        TensorMultiplyByScalarView(const shared_ptr<BaseTensor> &tensor, float scale) : BaseTensorUnaryOperatorView(
-                tensor) {
+        TensorMultiplyByScalarView(const shared_ptr<BaseTensor> &tensor, float scale)
+                : BaseTensorElementwiseUnaryView(tensor) {
             this->scale = scale;
         }
 
@@ -62,6 +77,12 @@ namespace happyml {
             return scale * child->getValue(row, column, channel);
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] *= scale;
+            }
+        }
+
         [[nodiscard]] float get_scale() const {
             return scale;
         }
@@ -70,10 +91,10 @@ namespace happyml {
         float scale;
     };
 
-    class TensorValueTransformView : public BaseTensorUnaryOperatorView {
+    class TensorValueTransformView : public BaseTensorElementwiseUnaryView {
     public:
         TensorValueTransformView(const shared_ptr<BaseTensor> &tensor, function<float(float)> transformFunction)
-                : BaseTensorUnaryOperatorView(
+                : BaseTensorElementwiseUnaryView(
                 tensor) {
             this->transformFunction = std::move(transformFunction);
         }
@@ -87,15 +108,27 @@ namespace happyml {
             return transformFunction(child->getValue(row, column, channel));
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = transformFunction(values[offset]);
+            }
+        }
+
+        [[nodiscard]] const function<float(float)> &get_transform_function() const {
+            return transformFunction;
+        }
+
     private:
         function<float(float)> transformFunction;
     };
 
-    class TensorValueTransform2View : public BaseTensorUnaryOperatorView {
+    class TensorValueTransform2View : public BaseTensorElementwiseUnaryView {
     public:
+        // the constants are handed to transformFunction by reference, so take them by reference in the function,
+        // too, or every value copies them.
         TensorValueTransform2View(const shared_ptr<BaseTensor> &tensor,
-                                  function<float(float, vector<double>)> transformFunction,
-                                  vector<double> constants) : BaseTensorUnaryOperatorView(
+                                  function<float(float, const vector<double> &)> transformFunction,
+                                  vector<double> constants) : BaseTensorElementwiseUnaryView(
                 tensor) {
             this->transformFunction = std::move(transformFunction);
             this->constants = std::move(constants);
@@ -111,23 +144,83 @@ namespace happyml {
             return transformFunction(child->getValue(row, column, channel), constants);
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = transformFunction(values[offset], constants);
+            }
+        }
+
     private:
-        function<float(float, vector<double>)> transformFunction;
+        function<float(float, const vector<double> &)> transformFunction;
         vector<double> constants;
     };
 
+    // The shared part of the TensorActivationViews, so that code that needs to rebuild one on top of a different
+    // child (like the simplifier) can do it without knowing which function it applies.
+    class BaseTensorActivationView : public BaseTensorElementwiseUnaryView {
+    public:
+        explicit BaseTensorActivationView(const shared_ptr<BaseTensor> &tensor)
+                : BaseTensorElementwiseUnaryView(tensor) {
+        }
+
+        // the same function, applied to tensor instead.
+        virtual shared_ptr<BaseTensor> withChild(const shared_ptr<BaseTensor> &tensor) = 0;
+    };
+
+    // Applies Op to every value. It does what a TensorValueTransformView does, but the function is known when
+    // we compile, rather than hidden behind a std::function, so it can be inlined into the loop over a row.
+    // Op provides:
+    //   * a static constexpr const char *name, for printing
+    //   * float operator()(float) const, for one value
+    //   * void transform(float *values, size_t count) const, for a row of them, in place
+    // An Op may hold constants (the shift and scale of softmax, for instance.) See ActivationOp in
+    // ml/activation.hpp for the activation functions.
+    template<typename Op>
+    class TensorActivationView : public BaseTensorActivationView {
+    public:
+        explicit TensorActivationView(const shared_ptr<BaseTensor> &tensor, const Op &op = Op())
+                : BaseTensorActivationView(tensor), op(op) {
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorActivationView<" << Op::name << ">{" << rowCount() << "," << columnCount() << ","
+                 << channelCount() << "}->";
+            child->printMaterializationPlan();
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            return op(child->getValue(row, column, channel));
+        }
+
+        void transformValues(float *values, size_t count) override {
+            op.transform(values, count);
+        }
+
+        shared_ptr<BaseTensor> withChild(const shared_ptr<BaseTensor> &tensor) override {
+            return makeView<TensorActivationView<Op>>(tensor, op);
+        }
+
+        [[nodiscard]] const Op &getOp() const {
+            return op;
+        }
+
+    private:
+        Op op;
+    };
+
 // Change the number of rows and columns, but maintain the same number of elements per channel.
 // You cannot change the number of channels in the current implementation.
-    class TensorReshapeView : public BaseTensorUnaryOperatorView {
+    class TensorReshapeView : public BaseTensorStridedView {
     public:
         TensorReshapeView(const shared_ptr<BaseTensor> &tensor, const size_t rows,
-                          const size_t columns) : BaseTensorUnaryOperatorView(tensor) {
+                          const size_t columns) : BaseTensorStridedView(tensor) {
             this->rows = rows;
             this->columns = columns;
             this->elements_per_channel = (unsigned long) rows * (unsigned long) columns;
             if (tensor->elementsPerChannel() != elements_per_channel) {
                 throw exception("A matrix view must be put over a matrix with the same number of elements.");
             }
+            initializeLayout();
         }
 
         void printMaterializationPlan() override {
@@ -144,6 +237,9 @@ namespace happyml {
         }
 
         float getValue(size_t row, size_t column, size_t channel) override {
+            if (strided) {
+                return layout.at(row, column, channel);
+            }
             const unsigned long position_offset = (row * columns) + column;
             const size_t child_col_count = child->columnCount();
             const size_t new_row = position_offset / child_col_count;
@@ -151,6 +247,35 @@ namespace happyml {
             return child->getValue(new_row, new_col, channel);
         }
 
+        // A reshaped row is a run of consecutive elements in the child, which may wrap across several child rows.
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            if (strided) {
+                layout.readRow(row, channel, firstColumn, count, out);
+                return;
+            }
+            const size_t child_col_count = child->columnCount();
+            const unsigned long position_offset = (row * columns) + firstColumn;
+            size_t child_row = position_offset / child_col_count;
+            size_t child_col = position_offset % child_col_count;
+            while (count > 0) {
+                const size_t span = std::min(count, child_col_count - child_col);
+                child->readRow(child_row, channel, child_col, span, out);
+                out += span;
+                count -= span;
+                child_row++;
+                child_col = 0;
+            }
+        }
+
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            size_t step;
+            if (!linearStep(childLayout, child->rowCount(), child->columnCount(), step)) {
+                return false;
+            }
+            viewLayout = {childLayout.data, columns * step, step, childLayout.channelStride};
+            return true;
+        }
 
     private:
         size_t rows;
@@ -159,10 +284,11 @@ namespace happyml {
     };
 
 // Converts a 3d tensor into a row vector
-    class TensorFlattenToRowView : public BaseTensorUnaryOperatorView {
+    class TensorFlattenToRowView : public BaseTensorStridedView {
     public:
-        explicit TensorFlattenToRowView(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(tensor) {
+        explicit TensorFlattenToRowView(const shared_ptr<BaseTensor> &tensor) : BaseTensorStridedView(tensor) {
             this->columns = tensor->size();
+            initializeLayout();
         }
 
         void printMaterializationPlan() override {
@@ -190,20 +316,61 @@ namespace happyml {
             if (row != 0 || channel != 0) {
                 throw exception("Row Vector has only a single row and channel.");
             }
+            if (strided) {
+                return layout.at(0, column, 0);
+            }
             return child->getValue(column);
         }
 
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            if (row != 0 || channel != 0) {
+                throw exception("Row Vector has only a single row and channel.");
+            }
+            if (strided) {
+                layout.readRow(0, 0, firstColumn, count, out);
+                return;
+            }
+            const size_t child_col_count = child->columnCount();
+            const unsigned long matrix_size = child_col_count * child->rowCount();
+            size_t child_channel = firstColumn / matrix_size;
+            const unsigned long matrix_elements = firstColumn % matrix_size;
+            size_t child_row = matrix_elements / child_col_count;
+            size_t child_col = matrix_elements % child_col_count;
+            const size_t child_row_count = child->rowCount();
+            while (count > 0) {
+                const size_t span = std::min(count, child_col_count - child_col);
+                child->readRow(child_row, child_channel, child_col, span, out);
+                out += span;
+                count -= span;
+                child_col = 0;
+                child_row++;
+                if (child_row >= child_row_count) {
+                    child_row = 0;
+                    child_channel++;
+                }
+            }
+        }
+
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            size_t step;
+            if (!flattenStep(childLayout, child->rowCount(), child->columnCount(), child->channelCount(), step)) {
+                return false;
+            }
+            viewLayout = {childLayout.data, columns * step, step, columns * step};
+            return true;
+        }
 
     private:
         size_t columns;
     };
 
 // Converts a 3d tensor into a column vector
-    class TensorFlattenToColumnView : public BaseTensorUnaryOperatorView {
+    class TensorFlattenToColumnView : public BaseTensorStridedView {
     public:
-        explicit TensorFlattenToColumnView(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(
-                tensor) {
+        explicit TensorFlattenToColumnView(const shared_ptr<BaseTensor> &tensor) : BaseTensorStridedView(tensor) {
             this->rows = tensor->size();
+            initializeLayout();
         }
 
         void printMaterializationPlan() override {
@@ -232,17 +399,30 @@ namespace happyml {
             if (column != 0 || channel != 0) {
                 throw exception("Column Vector has only a single column and channel.");
             }
+            if (strided) {
+                return layout.at(row, 0, 0);
+            }
             return child->getValue(row);
         }
 
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            size_t step;
+            if (!flattenStep(childLayout, child->rowCount(), child->columnCount(), child->channelCount(), step)) {
+                return false;
+            }
+            viewLayout = {childLayout.data, step, rows * step, rows * step};
+            return true;
+        }
 
     private:
         size_t rows;
     };
 
-    class TensorTransposeView : public BaseTensorUnaryOperatorView {
+    class TensorTransposeView : public BaseTensorStridedView {
     public:
-        explicit TensorTransposeView(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(tensor) {
+        explicit TensorTransposeView(const shared_ptr<BaseTensor> &tensor) : BaseTensorStridedView(tensor) {
+            initializeLayout();
         }
 
         void printMaterializationPlan() override {
@@ -267,11 +447,44 @@ namespace happyml {
         }
 
         float getValue(size_t row, size_t column, size_t channel) override {
+            if (strided) {
+                return layout.at(row, column, channel);
+            }
             // making it obvious that we intend to swap column and row. Compiler will optimize this out.
             const size_t swapped_row = column;
             const size_t swapped_col = row;
             return child->getValue(swapped_row, swapped_col, channel);
         }
+
+        // A transposed row is a child column, which is the worst case for reading row by row. When somebody asks
+        // for a tile, we read the matching child tile a block at a time and swap it in a small local buffer.
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            constexpr size_t block = 32;
+            float local[block * block];
+            for (size_t column_block = 0; column_block < columns; column_block += block) {
+                const size_t block_columns = std::min(block, columns - column_block);
+                for (size_t row_block = 0; row_block < rows; row_block += block) {
+                    const size_t block_rows = std::min(block, rows - row_block);
+                    // child rows are our columns, child columns are our rows
+                    child->readTile(firstColumn + column_block, block_columns, firstRow + row_block, block_rows,
+                                    channel, local, block);
+                    for (size_t row = 0; row < block_rows; row++) {
+                        float *out_row = out + ((row_block + row) * outRowStride) + column_block;
+                        for (size_t column = 0; column < block_columns; column++) {
+                            out_row[column] = local[(column * block) + row];
+                        }
+                    }
+                }
+            }
+        }
+
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            viewLayout = childLayout;
+            std::swap(viewLayout.rowStride, viewLayout.columnStride);
+            return true;
+        }
     };
 
 // In the current implementation, a tensor is a vector of matrices, and our math is frequently
@@ -358,6 +571,19 @@ namespace happyml {
             return child->getValue(row, column, channel);
         }
 
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            child->readRow(row, channel, firstColumn, count, out);
+        }
+
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            child->readTile(firstRow, rows, firstColumn, columns, channel, out, outRowStride);
+        }
+
+        bool bufferLayout(TensorBufferLayout &layout) override {
+            return child->bufferLayout(layout);
+        }
+
         void printMaterializationPlan() override {
             cout << "TensorNoOpView{" << rowCount() << "," << columnCount() << "," << channelCount() << "}->";
             child->printMaterializationPlan();
@@ -368,8 +594,10 @@ namespace happyml {
 
     class TensorDotTensorView : public BaseTensorBinaryOperatorView {
     public:
-        TensorDotTensorView(const shared_ptr<BaseTensor> &tensor1,
-                            const shared_ptr<BaseTensor> &tensor2) : BaseTensorBinaryOperatorView(tensor1, tensor2) {
+        // alpha scales the result, so a scalar multiply on either side (or on the result) can be done for free.
+        TensorDotTensorView(const shared_ptr<BaseTensor> &tensor1, const shared_ptr<BaseTensor> &tensor2,
+                            float alpha = 1.f) : BaseTensorBinaryOperatorView(tensor1, tensor2) {
+            this->alpha = alpha;
             if (tensor1->columnCount() != tensor2->rowCount()) {
                 cout << "[" << tensor1->rowCount() << ", " << tensor1->columnCount() << ", " << tensor1->channelCount()
                      << "] dot [";
@@ -380,6 +608,9 @@ namespace happyml {
             if (tensor1->channelCount() != tensor2->channelCount()) {
                 throw exception("Dot product tensor1.channels must match tensor2.channels in length");
             }
+            // each row of child1 is read once per output column, and each column of child2 once per output row.
+            child1 = cacheForRepeatedReads(child1);
+            child2 = cacheForRepeatedReads(child2);
         }
 
         void printMaterializationPlan() override {
@@ -401,36 +632,116 @@ namespace happyml {
         float getValue(size_t row, size_t column, size_t channel) override {
             float val = 0;
             const auto childColumnCount = child1->columnCount();
-#pragma omp for
             for (size_t t1_col = 0; t1_col < childColumnCount; t1_col++) {
                 val += child1->getValue(row, t1_col, channel) * child2->getValue(t1_col, column, channel);
             }
-            return val;
+            return alpha * val;
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            readTile(row, 1, firstColumn, count, channel, out, count);
+        }
+
+        // This is where the real work of a dense layer happens, so we hand it to the gemm kernel. A child that is
+        // already in memory (a FullTensor, or a transpose of one) is read in place. Anything else is read into
+        // a temporary buffer first, which is still far cheaper than asking for each value k times. Weights that
+        // were packed ahead of time (PackedGemmTensor) go to the kernel as they are. Ones and zeros on the left
+        // (a BitTensor) don't need multiplying at all, and zeros on the left (a SparseTensor, or a transpose of
+        // one) don't need reading, so those skip the kernel too.
+        void readTile(size_t firstRow, size_t rows, size_t firstColumn, size_t columns, size_t channel,
+                      float *out, size_t outRowStride) override {
+            if (auto sparse = dynamic_cast<SparseTensor *>(child1.get())) {
+                ArenaBuffer<float> right_values;
+                const StridedMatrix right = rightMatrix(firstColumn, columns, channel, right_values);
+                sparseDotValues(*sparse, right, channel, firstRow, rows, columns, out, outRowStride);
+                scaleByAlpha(rows, columns, out, outRowStride);
+                return;
+            }
+            if (auto transpose = dynamic_cast<TensorTransposeView *>(child1.get())) {
+                if (auto sparse = dynamic_cast<SparseTensor *>(transpose->getChild().get())) {
+                    ArenaBuffer<float> right_values;
+                    const StridedMatrix right = rightMatrix(firstColumn, columns, channel, right_values);
+                    sparseTransposeDotValues(*sparse, sparse->rowCount(), right, channel, firstRow, rows, columns,
+                                             out, outRowStride);
+                    scaleByAlpha(rows, columns, out, outRowStride);
+                    return;
+                }
+            }
+            if (auto left_bits = dynamic_cast<BitTensor *>(child1.get())) {
+                if (auto right_bits = dynamic_cast<BitTensor *>(child2.get())) {
+                    bitDotBits(*left_bits, *right_bits, channel, firstRow, rows, firstColumn, columns, out,
+                               outRowStride);
+                } else {
+                    ArenaBuffer<float> right_values;
+                    const StridedMatrix right = rightMatrix(firstColumn, columns, channel, right_values);
+                    bitDotValues(*left_bits, right, channel, firstRow, rows, columns, out, outRowStride);
+                }
+                scaleByAlpha(rows, columns, out, outRowStride);
+                return;
+            }
+            const size_t inner = child1->columnCount();
+            TensorBufferLayout layout;
+            ArenaBuffer<float> left_values;
+            StridedMatrix left{};
+            if (child1->bufferLayout(layout)) {
+                left = {layout.data + (channel * layout.channelStride) + (firstRow * layout.rowStride),
+                        layout.rowStride, layout.columnStride};
+            } else {
+                left_values.resize(rows * inner);
+                readTileFused(child1, firstRow, rows, 0, inner, channel, left_values.data(), inner);
+                left = {left_values.data(), inner, 1};
+            }
+            if (auto packed = dynamic_cast<PackedGemmTensor *>(child2.get())) {
+                gemmPacked(rows, columns, left, packed->packedChannel(channel), firstColumn, out, outRowStride);
+                scaleByAlpha(rows, columns, out, outRowStride);
+                return;
+            }
+            ArenaBuffer<float> right_values;
+            const StridedMatrix right = rightMatrix(firstColumn, columns, channel, right_values);
+            gemm(rows, columns, inner, left, right, out, outRowStride);
+            scaleByAlpha(rows, columns, out, outRowStride);
+        }
+
+        [[nodiscard]] float get_alpha() const {
+            return alpha;
+        }
+
+    private:
+        float alpha;
+
+        // columns firstColumn through firstColumn + columns - 1 of child2, in place if it's in memory, otherwise
+        // read into values.
+        StridedMatrix rightMatrix(size_t firstColumn, size_t columns, size_t channel, ArenaBuffer<float> &values) {
+            TensorBufferLayout layout;
+            if (child2->bufferLayout(layout)) {
+                return {layout.data + (channel * layout.channelStride) + (firstColumn * layout.columnStride),
+                        layout.rowStride, layout.columnStride};
+            }
+            const size_t inner = child2->rowCount();
+            values.resize(inner * columns);
+            readTileFused(child2, 0, inner, firstColumn, columns, channel, values.data(), columns);
+            return {values.data(), columns, 1};
+        }
+
+        void scaleByAlpha(size_t rows, size_t columns, float *out, size_t outRowStride) const {
+            if (alpha == 1.f) {
+                return;
+            }
+            for (size_t row = 0; row < rows; row++) {
+                float *out_row = out + (row * outRowStride);
+                for (size_t column = 0; column < columns; column++) {
+                    out_row[column] *= alpha;
+                }
+            }
         }
     };
 
-    class TensorMultiplyTensorView : public BaseTensorBinaryOperatorView {
+    class TensorMultiplyTensorView : public BaseTensorElementwiseBinaryView {
     public:
         TensorMultiplyTensorView(const shared_ptr<BaseTensor> &tensor1,
-                                 const shared_ptr<BaseTensor> &tensor2) : BaseTensorBinaryOperatorView(tensor1,
+                                 const shared_ptr<BaseTensor> &tensor2) : BaseTensorElementwiseBinaryView(tensor1,
                                                                                                        tensor2) {
-            if (tensor1->columnCount() != tensor2->columnCount() || tensor1->rowCount() != tensor2->rowCount()) {
-                stringstream ss;
-                ss << "Multiply cols and rows much match in length. Attempted: " << "[" << tensor1->rowCount() << ", "
-                   << tensor1->columnCount() << ", " << tensor1->channelCount() << "] * [";
-                ss << tensor2->rowCount() << ", " << tensor2->columnCount() << ", " << tensor2->channelCount() << "]"
-                   << endl;
-                throw exception(ss.str().c_str());
-            }
-            if (tensor1->channelCount() != tensor2->channelCount()) {
-                stringstream ss;
-                ss << "Multiply product channels must match in length. Attempted: " << "[" << tensor1->rowCount()
-                   << ", " << tensor1->columnCount() << ", " << tensor1->channelCount() << "] * [";
-                ss << tensor2->rowCount() << ", " << tensor2->columnCount() << ", " << tensor2->channelCount() << "]"
-                   << endl;
-                throw exception(ss.str().c_str());
-
-            }
+            broadcastChildren("*");
         }
 
         void printMaterializationPlan() override {
@@ -454,20 +765,19 @@ namespace happyml {
 //        cout << "getting val: " << row << ", " << column << endl;
             return child1->getValue(row, column, channel) * child2->getValue(row, column, channel);
         }
+
+        void combineValues(float *values, const float *otherValues, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] *= otherValues[offset];
+            }
+        }
     };
 
-    class TensorAddTensorView : public BaseTensorBinaryOperatorView {
+    class TensorAddTensorView : public BaseTensorElementwiseBinaryView {
     public:
         TensorAddTensorView(const shared_ptr<BaseTensor> &tensor1,
-                            const shared_ptr<BaseTensor> &tensor2) : BaseTensorBinaryOperatorView(tensor1, tensor2) {
-            if (tensor1->channelCount() != tensor2->channelCount() || tensor1->rowCount() != tensor2->rowCount() ||
-                tensor1->columnCount() != tensor2->columnCount()) {
-                cout << "[" << tensor1->rowCount() << ", " << tensor1->columnCount() << ", " << tensor1->channelCount()
-                     << "] + [";
-                cout << tensor2->rowCount() << ", " << tensor2->columnCount() << ", " << tensor2->channelCount() << "]"
-                     << endl;
-                throw exception("You can only add two tensors of the same dimensions together.");
-            }
+                            const shared_ptr<BaseTensor> &tensor2) : BaseTensorElementwiseBinaryView(tensor1, tensor2) {
+            broadcastChildren("+");
         }
 
         void printMaterializationPlan() override {
@@ -489,20 +799,19 @@ namespace happyml {
         float getValue(size_t row, size_t column, size_t channel) override {
             return child1->getValue(row, column, channel) + child2->getValue(row, column, channel);
         }
+
+        void combineValues(float *values, const float *otherValues, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] += otherValues[offset];
+            }
+        }
     };
 
-    class TensorMinusTensorView : public BaseTensorBinaryOperatorView {
+    class TensorMinusTensorView : public BaseTensorElementwiseBinaryView {
     public:
         TensorMinusTensorView(const shared_ptr<BaseTensor> &tensor1,
-                              const shared_ptr<BaseTensor> &tensor2) : BaseTensorBinaryOperatorView(tensor1, tensor2) {
-            if (tensor1->channelCount() != tensor2->channelCount() || tensor1->rowCount() != tensor2->rowCount() ||
-                tensor1->columnCount() != tensor2->columnCount()) {
-                cout << "[" << tensor1->rowCount() << ", " << tensor1->columnCount() << ", " << tensor1->channelCount()
-                     << "] - [";
-                cout << tensor2->rowCount() << ", " << tensor2->columnCount() << ", " << tensor2->channelCount() << "]"
-                     << endl;
-                throw exception("You can only subtract two tensors of the same dimensions together.");
-            }
+                              const shared_ptr<BaseTensor> &tensor2) : BaseTensorElementwiseBinaryView(tensor1, tensor2) {
+            broadcastChildren("-");
         }
 
         void printMaterializationPlan() override {
@@ -524,11 +833,17 @@ namespace happyml {
         float getValue(size_t row, size_t column, size_t channel) override {
             return child1->getValue(row, column, channel) - child2->getValue(row, column, channel);
         }
+
+        void combineValues(float *values, const float *otherValues, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] -= otherValues[offset];
+            }
+        }
     };
 
-    class TensorPowerView : public BaseTensorUnaryOperatorView {
+    class TensorPowerView : public BaseTensorElementwiseUnaryView {
     public:
-        TensorPowerView(const shared_ptr<BaseTensor> &tensor, const float power) : BaseTensorUnaryOperatorView(
+        TensorPowerView(const shared_ptr<BaseTensor> &tensor, const float power) : BaseTensorElementwiseUnaryView(
                 tensor) {
             this->power = power;
         }
@@ -538,6 +853,12 @@ namespace happyml {
             return powf(val, power);
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = powf(values[offset], power);
+            }
+        }
+
         void printMaterializationPlan() override {
             cout << "TensorMinusTensorView{" << rowCount() << "," << columnCount() << "," << channelCount() << "}->";
             child->printMaterializationPlan();
@@ -547,9 +868,9 @@ namespace happyml {
         float power;
     };
 
-    class TensorLogView : public BaseTensorUnaryOperatorView {
+    class TensorLogView : public BaseTensorElementwiseUnaryView {
     public:
-        explicit TensorLogView(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(tensor) {
+        explicit TensorLogView(const shared_ptr<BaseTensor> &tensor) : BaseTensorElementwiseUnaryView(tensor) {
         }
 
         void printMaterializationPlan() override {
@@ -559,15 +880,19 @@ namespace happyml {
 
         float getValue(size_t row, size_t column, size_t channel) override {
             const float val = child->getValue(row, column, channel);
-            return log(val);
+            return fastLog(val);
+        }
+
+        void transformValues(float *values, size_t count) override {
+            fastLogValues(values, values, count);
         }
 
     private:
     };
 
-    class TensorLog2View : public BaseTensorUnaryOperatorView {
+    class TensorLog2View : public BaseTensorElementwiseUnaryView {
     public:
-        explicit TensorLog2View(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(tensor) {
+        explicit TensorLog2View(const shared_ptr<BaseTensor> &tensor) : BaseTensorElementwiseUnaryView(tensor) {
         }
 
         void printMaterializationPlan() override {
@@ -580,6 +905,12 @@ namespace happyml {
             return log2(val);
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = log2(values[offset]);
+            }
+        }
+
     private:
     };
 
@@ -600,14 +931,24 @@ namespace happyml {
             return val;
         }
 
+        // The child's row is read in its natural order and then mirrored in place.
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            if (count == 0) {
+                return;
+            }
+            const size_t child_first_column = column_base_value - (firstColumn + count - 1);
+            child->readRow(row_base_value - row, channel, child_first_column, count, out);
+            std::reverse(out, out + count);
+        }
+
     private:
         size_t row_base_value;
         size_t column_base_value;
     };
 
-    class TensorRoundedView : public BaseTensorUnaryOperatorView {
+    class TensorRoundedView : public BaseTensorElementwiseUnaryView {
     public:
-        explicit TensorRoundedView(const shared_ptr<BaseTensor> &tensor) : BaseTensorUnaryOperatorView(tensor) {
+        explicit TensorRoundedView(const shared_ptr<BaseTensor> &tensor) : BaseTensorElementwiseUnaryView(tensor) {
         }
 
         void printMaterializationPlan() override {
@@ -620,6 +961,12 @@ namespace happyml {
             return round(val);
         }
 
+        void transformValues(float *values, size_t count) override {
+            for (size_t offset = 0; offset < count; offset++) {
+                values[offset] = round(values[offset]);
+            }
+        }
+
     private:
     };
 
@@ -656,6 +1003,27 @@ namespace happyml {
             return result;
         }
 
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            if (channel != data_channel_index) {
+                std::fill(out, out + count, 0.f);
+                return;
+            }
+            const size_t channels = child->channelCount();
+            if (channels == 0) {
+                std::fill(out, out + count, 0.f);
+                return;
+            }
+            child->readRow(row, 0, firstColumn, count, out);
+            RowScratch next(count);
+            const float *next_values = next.data();
+            for (size_t next_channel = 1; next_channel < channels; next_channel++) {
+                child->readRow(row, next_channel, firstColumn, count, next.data());
+                for (size_t offset = 0; offset < count; offset++) {
+                    out[offset] += next_values[offset];
+                }
+            }
+        }
+
     private:
         size_t data_channel_index;
         size_t number_of_channels;
@@ -674,11 +1042,12 @@ namespace happyml {
 
     // Creates a tensor from a single channel of another tensor, ignoring other channels
     // all data is at channel 0, and channel count is 1.
-    class TensorChannelToTensorView : public BaseTensorUnaryOperatorView {
+    class TensorChannelToTensorView : public BaseTensorStridedView {
     public:
         explicit TensorChannelToTensorView(const shared_ptr<BaseTensor> &tensor, size_t channel_offset)
-                : BaseTensorUnaryOperatorView(tensor) {
+                : BaseTensorStridedView(tensor) {
             this->channel_offset = channel_offset;
+            initializeLayout();
         }
 
         void printMaterializationPlan() override {
@@ -694,15 +1063,295 @@ namespace happyml {
             if (channel != 0) {
                 return 0.f;
             }
-
+            if (strided) {
+                return layout.at(row, column, 0);
+            }
             const float val = child->getValue(row, column, channel + channel_offset);
             return val;
         }
 
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            if (channel != 0) {
+                std::fill(out, out + count, 0.f);
+                return;
+            }
+            if (strided) {
+                layout.readRow(row, 0, firstColumn, count, out);
+                return;
+            }
+            child->readRow(row, channel_offset, firstColumn, count, out);
+        }
+
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            viewLayout = childLayout;
+            viewLayout.data += channel_offset * childLayout.channelStride;
+            return true;
+        }
+
     private:
         size_t channel_offset;
     };
 
+    // A rectangular piece of another tensor: rows [firstRow, firstRow + rows), and the same for columns and
+    // channels. Over a tensor in memory, this is just a new starting point with the same strides.
+    class TensorSliceView : public BaseTensorStridedView {
+    public:
+        TensorSliceView(const shared_ptr<BaseTensor> &tensor, size_t firstRow, size_t rows, size_t firstColumn,
+                        size_t columns, size_t firstChannel, size_t channels) : BaseTensorStridedView(tensor) {
+            if (firstRow + rows > tensor->rowCount() || firstColumn + columns > tensor->columnCount() ||
+                firstChannel + channels > tensor->channelCount()) {
+                throw exception("A slice must fit inside the tensor it is taken from.");
+            }
+            this->firstRow = firstRow;
+            this->rows = rows;
+            this->firstColumn = firstColumn;
+            this->columns = columns;
+            this->firstChannel = firstChannel;
+            this->channels = channels;
+            initializeLayout();
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorSliceView{" << rowCount() << "," << columnCount() << "," << channelCount() << "}->";
+            child->printMaterializationPlan();
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            if (strided) {
+                return layout.at(row, column, channel);
+            }
+            return child->getValue(row + firstRow, column + firstColumn, channel + firstChannel);
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumnToRead, size_t count, float *out) override {
+            if (strided) {
+                layout.readRow(row, channel, firstColumnToRead, count, out);
+                return;
+            }
+            child->readRow(row + firstRow, channel + firstChannel, firstColumnToRead + firstColumn, count, out);
+        }
+
+        void readTile(size_t firstRowToRead, size_t rowsToRead, size_t firstColumnToRead, size_t columnsToRead,
+                      size_t channel, float *out, size_t outRowStride) override {
+            if (strided) {
+                for (size_t row = 0; row < rowsToRead; row++) {
+                    layout.readRow(firstRowToRead + row, channel, firstColumnToRead, columnsToRead,
+                                   out + (row * outRowStride));
+                }
+                return;
+            }
+            child->readTile(firstRowToRead + firstRow, rowsToRead, firstColumnToRead + firstColumn, columnsToRead,
+                            channel + firstChannel, out, outRowStride);
+        }
+
+    protected:
+        bool composeLayout(const TensorBufferLayout &childLayout, TensorBufferLayout &viewLayout) override {
+            viewLayout = childLayout;
+            viewLayout.data += (firstChannel * childLayout.channelStride) + (firstRow * childLayout.rowStride) +
+                               (firstColumn * childLayout.columnStride);
+            return true;
+        }
+
+    private:
+        size_t firstRow;
+        size_t rows;
+        size_t firstColumn;
+        size_t columns;
+        size_t firstChannel;
+        size_t channels;
+    };
+
+    // Stacks tensors of the same rows and columns one after another by channel. Each channel belongs to exactly one
+    // child, so a read goes straight to that child. Adding channels together with TensorSumToChannelView
+    // would instead add a zero from every other child.
+    class TensorConcatChannelsView : public BaseTensor {
+    public:
+        explicit TensorConcatChannelsView(const vector<shared_ptr<BaseTensor>> &tensors) {
+            if (tensors.empty()) {
+                throw exception("Concatenating channels needs at least one tensor.");
+            }
+            rows = tensors[0]->rowCount();
+            columns = tensors[0]->columnCount();
+            for (size_t index = 0; index < tensors.size(); index++) {
+                const auto &tensor = tensors[index];
+                if (tensor->rowCount() != rows || tensor->columnCount() != columns) {
+                    throw exception("Concatenated channels must have the same rows and columns.");
+                }
+                for (size_t channel = 0; channel < tensor->channelCount(); channel++) {
+                    owners.emplace_back(index, channel);
+                }
+            }
+            children = tensors;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorConcatChannelsView{" << rowCount() << "," << columnCount() << "," << channelCount()
+                 << "}->(";
+            for (size_t index = 0; index < children.size(); index++) {
+                if (index > 0) {
+                    cout << ") + (";
+                }
+                children[index]->printMaterializationPlan();
+            }
+            cout << ")";
+        }
+
+        bool contains(const shared_ptr<BaseTensor> &other) override {
+            if (other == shared_from_this()) {
+                return true;
+            }
+            return std::any_of(children.begin(), children.end(), [&other](const shared_ptr<BaseTensor> &child) {
+                return child->contains(other);
+            });
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return columns;
+        }
+
+        size_t channelCount() override {
+            return owners.size();
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const auto &owner = owners[channel];
+            return children[owner.first]->getValue(row, column, owner.second);
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const auto &owner = owners[channel];
+            children[owner.first]->readRow(row, owner.second, firstColumn, count, out);
+        }
+
+        void readTile(size_t firstRow, size_t rowsToRead, size_t firstColumn, size_t columnsToRead, size_t channel,
+                      float *out, size_t outRowStride) override {
+            const auto &owner = owners[channel];
+            children[owner.first]->readTile(firstRow, rowsToRead, firstColumn, columnsToRead, owner.second, out,
+                                            outRowStride);
+        }
+
+        [[nodiscard]] const vector<shared_ptr<BaseTensor>> &getChildren() const {
+            return children;
+        }
+
+    private:
+        size_t rows;
+        size_t columns;
+        vector<shared_ptr<BaseTensor>> children;
+        // for each of our channels: which child it comes from, and which channel of that child
+        vector<pair<size_t, size_t>> owners;
+    };
+
+    // Puts tensors with the same rows and channels side by side, left to right.
+    class TensorConcatColumnsView : public BaseTensor {
+    public:
+        explicit TensorConcatColumnsView(const vector<shared_ptr<BaseTensor>> &tensors) {
+            if (tensors.empty()) {
+                throw exception("Concatenating columns needs at least one tensor.");
+            }
+            rows = tensors[0]->rowCount();
+            channels = tensors[0]->channelCount();
+            for (size_t index = 0; index < tensors.size(); index++) {
+                const auto &tensor = tensors[index];
+                if (tensor->rowCount() != rows || tensor->channelCount() != channels) {
+                    throw exception("Concatenated columns must have the same rows and channels.");
+                }
+                firstColumns.push_back(owners.size());
+                for (size_t column = 0; column < tensor->columnCount(); column++) {
+                    owners.push_back(index);
+                }
+            }
+            children = tensors;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorConcatColumnsView{" << rowCount() << "," << columnCount() << "," << channelCount()
+                 << "}->(";
+            for (size_t index = 0; index < children.size(); index++) {
+                if (index > 0) {
+                    cout << ") + (";
+                }
+                children[index]->printMaterializationPlan();
+            }
+            cout << ")";
+        }
+
+        bool contains(const shared_ptr<BaseTensor> &other) override {
+            if (other == shared_from_this()) {
+                return true;
+            }
+            return std::any_of(children.begin(), children.end(), [&other](const shared_ptr<BaseTensor> &child) {
+                return child->contains(other);
+            });
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return owners.size();
+        }
+
+        size_t channelCount() override {
+            return channels;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const size_t owner = owners[column];
+            return children[owner]->getValue(row, column - firstColumns[owner], channel);
+        }
+
+        // A row may cross several children. Each one fills in its own part of it.
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            readTile(row, 1, firstColumn, count, channel, out, count);
+        }
+
+        void readTile(size_t firstRow, size_t rowsToRead, size_t firstColumn, size_t columnsToRead, size_t channel,
+                      float *out, size_t outRowStride) override {
+            size_t column = firstColumn;
+            const size_t last_column = firstColumn + columnsToRead;
+            while (column < last_column) {
+                const size_t owner = owners[column];
+                const size_t child_first = firstColumns[owner];
+                const size_t span = std::min(last_column, child_first + children[owner]->columnCount()) - column;
+                children[owner]->readTile(firstRow, rowsToRead, column - child_first, span, channel,
+                                          out + (column - firstColumn), outRowStride);
+                column += span;
+            }
+        }
+
+        [[nodiscard]] const vector<shared_ptr<BaseTensor>> &getChildren() const {
+            return children;
+        }
+
+    private:
+        size_t rows;
+        size_t channels;
+        vector<shared_ptr<BaseTensor>> children;
+        // the column each child starts at
+        vector<size_t> firstColumns;
+        // for each of our columns, the child it comes from
+        vector<size_t> owners;
+    };
+
     // padding is the amount of extra cells on a given "side" of the matrix
     // so a col_padding of 2 would mean 2 cells to the left that are 0 and 2 cells to the right that are zero.
     // for a total of 4 extra cells in the row.
@@ -733,6 +1382,27 @@ namespace happyml {
             return val;
         }
 
+        // Fills the padding with zeros and reads whatever part of the request overlaps the child in one call.
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const size_t child_rows = child->rowCount();
+            const size_t child_columns = child->columnCount();
+            if (row < topPadding || row - topPadding >= child_rows) {
+                std::fill(out, out + count, 0.f);
+                return;
+            }
+            const size_t last_column = firstColumn + count;
+            const size_t overlap_start = std::max(firstColumn, leftPadding);
+            const size_t overlap_end = std::min(last_column, leftPadding + child_columns);
+            if (overlap_start >= overlap_end) {
+                std::fill(out, out + count, 0.f);
+                return;
+            }
+            std::fill(out, out + (overlap_start - firstColumn), 0.f);
+            child->readRow(row - topPadding, channel, overlap_start - leftPadding, overlap_end - overlap_start,
+                           out + (overlap_start - firstColumn));
+            std::fill(out + (overlap_end - firstColumn), out + count, 0.f);
+        }
+
         size_t rowCount() override {
             const size_t padding = bottomPadding + topPadding;
             return child->rowCount() + padding;
@@ -756,6 +1426,9 @@ namespace happyml {
                 : BaseTensorBinaryOperatorView(tensor, kernel) {
             rows = child1->rowCount() - child2->rowCount() + 1;
             cols = child1->columnCount() - child2->columnCount() + 1;
+            // every input value is read once for each kernel value that passes over it.
+            child1 = cacheForRepeatedReads(child1);
+            child2 = cacheForRepeatedReads(child2);
         }
 
         void printMaterializationPlan() override {
@@ -783,6 +1456,30 @@ namespace happyml {
             return result;
         }
 
+        // For each kernel row, we read the kernel row and the matching (wider) input row once, then slide the
+        // kernel across the input in a plain loop.
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            const auto kernel_rows = child2->rowCount();
+            const auto kernel_cols = child2->columnCount();
+            const size_t input_span = count + kernel_cols - 1;
+            RowScratch kernel(kernel_cols);
+            RowScratch input(input_span);
+            const float *kernel_values = kernel.data();
+            const float *input_values = input.data();
+            std::fill(out, out + count, 0.f);
+            for (size_t kernel_row = 0; kernel_row < kernel_rows; kernel_row++) {
+                child2->readRow(kernel_row, channel, 0, kernel_cols, kernel.data());
+                child1->readRow(row + kernel_row, channel, firstColumn, input_span, input.data());
+                for (size_t offset = 0; offset < count; offset++) {
+                    float sum = 0.f;
+                    for (size_t kernel_col = 0; kernel_col < kernel_cols; kernel_col++) {
+                        sum += kernel_values[kernel_col] * input_values[offset + kernel_col];
+                    }
+                    out[offset] += sum;
+                }
+            }
+        }
+
         size_t rowCount() override {
             return rows;
         }
@@ -811,15 +1508,15 @@ namespace happyml {
     public:
         TensorFullCrossCorrelation2dView(const shared_ptr<BaseTensor> &tensor, const shared_ptr<BaseTensor> &kernel)
                 : TensorValidCrossCorrelation2dView(
-                make_shared<TensorZeroPaddedView>(tensor,
-                                                  (kernel->rowCount() > 1) *
-                                                  (size_t) round(((double) kernel->rowCount()) / 2.0),
-                                                  (kernel->rowCount() > 1) *
-                                                  (size_t) round(((double) kernel->rowCount()) / 2.0),
-                                                  (kernel->columnCount() > 1) *
-                                                  (size_t) round(((double) kernel->columnCount()) / 2.0),
-                                                  (kernel->columnCount() > 1) *
-                                                  (size_t) round(((double) kernel->columnCount()) / 2.0)),
+                makeView<TensorZeroPaddedView>(tensor,
+                                               (kernel->rowCount() > 1) *
+                                               (size_t) round(((double) kernel->rowCount()) / 2.0),
+                                               (kernel->rowCount() > 1) *
+                                               (size_t) round(((double) kernel->rowCount()) / 2.0),
+                                               (kernel->columnCount() > 1) *
+                                               (size_t) round(((double) kernel->columnCount()) / 2.0),
+                                               (kernel->columnCount() > 1) *
+                                               (size_t) round(((double) kernel->columnCount()) / 2.0)),
                 kernel) {
         }
 
@@ -840,7 +1537,7 @@ namespace happyml {
     class TensorFullConvolve2dView : public TensorFullCrossCorrelation2dView {
     public:
         TensorFullConvolve2dView(const shared_ptr<BaseTensor> &tensor, const shared_ptr<BaseTensor> &kernel)
-                : TensorFullCrossCorrelation2dView(tensor, make_shared<TensorRotate180View>(kernel)) {
+                : TensorFullCrossCorrelation2dView(tensor, makeView<TensorRotate180View>(kernel)) {
 
         }
 
@@ -853,5 +1550,103 @@ namespace happyml {
             cout << ")";
         }
     };
+
+    // The valid cross correlation of each channel of tensor with the same channel of kernel, summed across the
+    // channels into one. That's what a convolution layer's filter works out, and what it used to build out of a
+    // TensorChannelToTensorView, a TensorValidCrossCorrelation2dView and a TensorAddTensorView for every channel.
+    //
+    // Here every output value is one pass over the kernel, and each kernel row lines up with the values of every
+    // channel across kernel-width locations. When tensor and kernel are channel-last (ChannelLastTensor), that is a
+    // contiguous run of memory in both, read in place. Anything else gets copied into that order a tile at a time.
+    class TensorChannelSumCrossCorrelation2dView : public BaseTensorBinaryOperatorView {
+    public:
+        TensorChannelSumCrossCorrelation2dView(const shared_ptr<BaseTensor> &tensor,
+                                               const shared_ptr<BaseTensor> &kernel)
+                : BaseTensorBinaryOperatorView(tensor, kernel) {
+            if (tensor->channelCount() != kernel->channelCount()) {
+                throw exception("Kernel must have a channel for each channel of the tensor.");
+            }
+            rows = child1->rowCount() - child2->rowCount() + 1;
+            cols = child1->columnCount() - child2->columnCount() + 1;
+        }
+
+        void printMaterializationPlan() override {
+            cout << "TensorChannelSumCrossCorrelation2dView{" << rowCount() << "," << columnCount() << ","
+                 << channelCount() << "}->(";
+            child1->printMaterializationPlan();
+            cout << ") + (";
+            child2->printMaterializationPlan();
+            cout << ")";
+        }
+
+        size_t rowCount() override {
+            return rows;
+        }
+
+        size_t columnCount() override {
+            return cols;
+        }
+
+        size_t channelCount() override {
+            return 1;
+        }
+
+        float getValue(size_t row, size_t column, size_t channel) override {
+            const size_t kernel_rows = child2->rowCount();
+            const size_t kernel_cols = child2->columnCount();
+            const size_t channels = child2->channelCount();
+            float result = 0.f;
+            for (size_t kernel_row = 0; kernel_row < kernel_rows; kernel_row++) {
+                for (size_t kernel_col = 0; kernel_col < kernel_cols; kernel_col++) {
+                    for (size_t next_channel = 0; next_channel < channels; next_channel++) {
+                        result += child2->getValue(kernel_row, kernel_col, next_channel) *
+                                  child1->getValue(row + kernel_row, column + kernel_col, next_channel);
+                    }
+                }
+            }
+            return result;
+        }
+
+        void readRow(size_t row, size_t channel, size_t firstColumn, size_t count, float *out) override {
+            readTile(row, 1, firstColumn, count, channel, out, count);
+        }
+
+        void readTile(size_t firstRow, size_t rowsToRead, size_t firstColumn, size_t columnsToRead, size_t channel,
+                      float *out, size_t outRowStride) override {
+            const size_t kernel_rows = child2->rowCount();
+            const size_t kernel_cols = child2->columnCount();
+            // a kernel row covers this many values of a row of either of them
+            const size_t span = kernel_cols * child2->channelCount();
+            const size_t channels = child1->channelCount();
+            ArenaBuffer<float> kernel_buffer;
+            ArenaBuffer<float> input_buffer;
+            size_t kernel_row_stride;
+            size_t input_row_stride;
+            const float *kernel = readChannelLastWindow(child2, 0, kernel_rows, 0, kernel_cols, kernel_buffer,
+                                                        kernel_row_stride);
+            const float *input = readChannelLastWindow(child1, firstRow, rowsToRead + kernel_rows - 1, firstColumn,
+                                                       columnsToRead + kernel_cols - 1, input_buffer,
+                                                       input_row_stride);
+            for (size_t row = 0; row < rowsToRead; row++) {
+                float *out_row = out + (row * outRowStride);
+                for (size_t column = 0; column < columnsToRead; column++) {
+                    float sum = 0.f;
+                    for (size_t kernel_row = 0; kernel_row < kernel_rows; kernel_row++) {
+                        const float *input_values = input + ((row + kernel_row) * input_row_stride) +
+                                                    (column * channels);
+                        const float *kernel_values = kernel + (kernel_row * kernel_row_stride);
+                        for (size_t offset = 0; offset < span; offset++) {
+                            sum += kernel_values[offset] * input_values[offset];
+                        }
+                    }
+                    out_row[column] = sum;
+                }
+            }
+        }
+
+    private:
+        size_t rows;
+        size_t cols;
+    };
 }
 #endif //HAPPYML_TENSOR_VIEWS_HPP
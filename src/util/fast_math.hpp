@@ -0,0 +1,283 @@
+//
+// Created by Erik Hyrkas on 1/15/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_FAST_MATH_HPP
+#define HAPPYML_FAST_MATH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define HAPPYML_FAST_MATH_AVX2
+
+#include <immintrin.h>
+
+#endif
+
+using namespace std;
+
+// exp, log, tanh and sigmoid for whole rows of floats at a time.
+//
+// Activation functions call exp (or tanh) once per value, and the standard library's versions can't be
+// vectorized: each call works out one float, with branches for all the cases a general purpose library has to
+// care about. Here, we do what the vector math libraries do:
+//   * exp: split x into n * ln(2) + r, where r is small, work out e^r with a polynomial, and put n straight
+//     into the exponent bits of the result.
+//   * log: the reverse. Pull the exponent out of the bits, and use a polynomial for the log of what's left.
+//   * tanh and sigmoid: built out of exp.
+// With AVX2, eight values go through each step at once. Without it, the same steps run one value at a time,
+// which are still cheaper than the standard library's. The polynomials are the ones from Cephes (Stephen
+// Moshier's math library), which is where most of the fast float math out there started.
+//
+// The functions that take a row read from values and write to out, which may be the same buffer.
+namespace happyml {
+
+    // How close exp (and so tanh and sigmoid) get to the right answer.
+    enum class MathAccuracy {
+        // within a couple of units in the last place, about as close as the standard library.
+        full,
+        // within a few parts in a million (3.5 at most), with two fewer multiplies per value. Plenty for
+        // activations, where the values are going to be nudged by a learning rate anyway.
+        fast
+    };
+
+    // e^r for |r| <= ln(2) / 2 is 1 + r + r^2 * p(r), where p is one of these, highest power first.
+    template<MathAccuracy accuracy>
+    struct ExpPolynomial;
+
+    template<>
+    struct ExpPolynomial<MathAccuracy::full> {
+        static constexpr size_t size = 6;
+        static constexpr float coefficients[size] = {1.9875691500E-4f, 1.3981999507E-3f, 8.3334519073E-3f,
+                                                     4.1665795894E-2f, 1.6666665459E-1f, 5.0000001201E-1f};
+    };
+
+    // the first terms of the Taylor series, which is off by at most e^r * r^6 / 720.
+    template<>
+    struct ExpPolynomial<MathAccuracy::fast> {
+        static constexpr size_t size = 4;
+        static constexpr float coefficients[size] = {1.f / 120.f, 1.f / 24.f, 1.f / 6.f, 0.5f};
+    };
+
+    // log(1 + m) for m in [sqrt(0.5) - 1, sqrt(2) - 1] is m - m^2 / 2 + m^3 * p(m).
+    constexpr size_t LOG_POLYNOMIAL_SIZE = 9;
+    constexpr float LOG_POLYNOMIAL[LOG_POLYNOMIAL_SIZE] = {7.0376836292E-2f, -1.1514610310E-1f, 1.1676998740E-1f,
+                                                           -1.2420140846E-1f, 1.4249322787E-1f, -1.6668057665E-1f,
+                                                           2.0000714765E-1f, -2.4999993993E-1f, 3.3333331174E-1f};
+
+    // Past these, e^x isn't a normal float. We overflow to infinity a little early (a float goes up to e^88.72),
+    // so that 2^n always fits in a float's exponent.
+    constexpr float FAST_EXP_MAX = 88.376f;
+    constexpr float FAST_EXP_MIN = -87.33654f;
+    constexpr float FAST_MATH_LOG2E = 1.44269504088896341f;
+    // ln(2) split in two, so that n * FAST_MATH_LN2_HIGH is exact for any n we'll see.
+    constexpr float FAST_MATH_LN2_HIGH = 0.693359375f;
+    constexpr float FAST_MATH_LN2_LOW = -2.12194440E-4f;
+    constexpr float FAST_MATH_SQRT_HALF = 0.707106781186547524f;
+
+    inline float floatFromBits(int32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    inline int32_t bitsFromFloat(float value) {
+        int32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    template<MathAccuracy accuracy = MathAccuracy::full>
+    inline float fastExp(float x) {
+        if (x > FAST_EXP_MAX) {
+            return numeric_limits<float>::infinity();
+        }
+        if (x < FAST_EXP_MIN) {
+            return 0.f;
+        }
+        if (std::isnan(x)) {
+            return x;
+        }
+        const float n = std::nearbyint(x * FAST_MATH_LOG2E);
+        const float r = (x - (n * FAST_MATH_LN2_HIGH)) - (n * FAST_MATH_LN2_LOW);
+        using Polynomial = ExpPolynomial<accuracy>;
+        float p = Polynomial::coefficients[0];
+        for (size_t term = 1; term < Polynomial::size; term++) {
+            p = (p * r) + Polynomial::coefficients[term];
+        }
+        return (1.f + r + ((r * r) * p)) * floatFromBits(((int32_t) n + 127) << 23);
+    }
+
+    // log(x), within a couple of units in the last place. Like std::log, log(0) is -infinity, and anything below
+    // zero is NaN.
+    inline float fastLog(float x) {
+        if (!(x > 0.f) || x == numeric_limits<float>::infinity()) {
+            if (x == 0.f) {
+                return -numeric_limits<float>::infinity();
+            }
+            return x > 0.f ? x : numeric_limits<float>::quiet_NaN();
+        }
+        int32_t exponent = 0;
+        if (x < numeric_limits<float>::min()) {
+            // denormals don't keep their exponent where we look for it.
+            x *= 8388608.f;
+            exponent = -23;
+        }
+        const int32_t bits = bitsFromFloat(x);
+        exponent += ((bits >> 23) & 0xff) - 126;
+        // m is in [0.5, 1)
+        float m = floatFromBits((bits & 0x807fffff) | 0x3f000000);
+        if (m < FAST_MATH_SQRT_HALF) {
+            exponent--;
+            m = m + m - 1.f;
+        } else {
+            m = m - 1.f;
+        }
+        const float e = (float) exponent;
+        const float m2 = m * m;
+        float p = LOG_POLYNOMIAL[0];
+        for (size_t term = 1; term < LOG_POLYNOMIAL_SIZE; term++) {
+            p = (p * m) + LOG_POLYNOMIAL[term];
+        }
+        float y = (m * m2) * p;
+        y += e * FAST_MATH_LN2_LOW;
+        y -= 0.5f * m2;
+        return m + y + (e * FAST_MATH_LN2_HIGH);
+    }
+
+    // tanh(x) = (1 - e^-2|x|) / (1 + e^-2|x|), with the sign of x. e^-2|x| is never more than one, so nothing
+    // overflows. Close to zero, the error is a few parts in a hundred million of 1, rather than of tanh(x).
+    template<MathAccuracy accuracy = MathAccuracy::full>
+    inline float fastTanh(float x) {
+        const float e = fastExp<accuracy>(-2.f * std::fabs(x));
+        return std::copysign((1.f - e) / (1.f + e), x);
+    }
+
+    // 1 / (1 + e^-x), worked out from e^-|x| so that it never overflows, and keeps its precision as it
+    // gets close to zero.
+    template<MathAccuracy accuracy = MathAccuracy::full>
+    inline float fastSigmoid(float x) {
+        const float e = fastExp<accuracy>(-std::fabs(x));
+        const float positive = 1.f / (1.f + e);
+        return x < 0.f ? e * positive : positive;
+    }
+
+#if defined(HAPPYML_FAST_MATH_AVX2)
+
+    template<MathAccuracy accuracy>
+    inline __m256 fastExpAvx2(__m256 x) {
+        const __m256 too_big = _mm256_cmp_ps(x, _mm256_set1_ps(FAST_EXP_MAX), _CMP_GT_OQ);
+        const __m256 too_small = _mm256_cmp_ps(x, _mm256_set1_ps(FAST_EXP_MIN), _CMP_LT_OQ);
+        const __m256 not_a_number = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(FAST_EXP_MIN)),
+                                             _mm256_set1_ps(FAST_EXP_MAX));
+        const __m256 n = _mm256_round_ps(_mm256_mul_ps(clamped, _mm256_set1_ps(FAST_MATH_LOG2E)),
+                                         _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(FAST_MATH_LN2_HIGH), clamped);
+        r = _mm256_fnmadd_ps(n, _mm256_set1_ps(FAST_MATH_LN2_LOW), r);
+        using Polynomial = ExpPolynomial<accuracy>;
+        __m256 p = _mm256_set1_ps(Polynomial::coefficients[0]);
+        for (size_t term = 1; term < Polynomial::size; term++) {
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(Polynomial::coefficients[term]));
+        }
+        p = _mm256_fmadd_ps(_mm256_mul_ps(r, r), p, _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+        const __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)),
+                                                23);
+        __m256 result = _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+        result = _mm256_blendv_ps(result, _mm256_setzero_ps(), too_small);
+        result = _mm256_blendv_ps(result, _mm256_set1_ps(numeric_limits<float>::infinity()), too_big);
+        return _mm256_blendv_ps(result, x, not_a_number);
+    }
+
+    inline __m256 fastLogAvx2(__m256 x) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 is_zero = _mm256_cmp_ps(x, zero, _CMP_EQ_OQ);
+        const __m256 is_invalid = _mm256_cmp_ps(x, zero, _CMP_NGE_UQ);
+        const __m256 is_infinite = _mm256_cmp_ps(x, _mm256_set1_ps(numeric_limits<float>::infinity()), _CMP_EQ_OQ);
+        const __m256 is_denormal = _mm256_cmp_ps(x, _mm256_set1_ps(numeric_limits<float>::min()), _CMP_LT_OQ);
+        x = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(8388608.f)), is_denormal);
+        const __m256i bits = _mm256_castps_si256(x);
+        __m256 exponent = _mm256_cvtepi32_ps(
+                _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)),
+                                 _mm256_set1_epi32(126)));
+        exponent = _mm256_sub_ps(exponent, _mm256_and_ps(is_denormal, _mm256_set1_ps(23.f)));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32((int) 0x807fffff)),
+                                                       _mm256_set1_epi32(0x3f000000)));
+        const __m256 is_small = _mm256_cmp_ps(m, _mm256_set1_ps(FAST_MATH_SQRT_HALF), _CMP_LT_OQ);
+        exponent = _mm256_sub_ps(exponent, _mm256_and_ps(is_small, _mm256_set1_ps(1.f)));
+        m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(is_small, m)), _mm256_set1_ps(1.f));
+        const __m256 m2 = _mm256_mul_ps(m, m);
+        __m256 p = _mm256_set1_ps(LOG_POLYNOMIAL[0]);
+        for (size_t term = 1; term < LOG_POLYNOMIAL_SIZE; term++) {
+            p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_POLYNOMIAL[term]));
+        }
+        __m256 y = _mm256_mul_ps(_mm256_mul_ps(m, m2), p);
+        y = _mm256_fmadd_ps(exponent, _mm256_set1_ps(FAST_MATH_LN2_LOW), y);
+        y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), m2, y);
+        __m256 result = _mm256_fmadd_ps(exponent, _mm256_set1_ps(FAST_MATH_LN2_HIGH), _mm256_add_ps(m, y));
+        result = _mm256_blendv_ps(result, _mm256_set1_ps(numeric_limits<float>::quiet_NaN()), is_invalid);
+        result = _mm256_blendv_ps(result, _mm256_set1_ps(-numeric_limits<float>::infinity()), is_zero);
+        return _mm256_blendv_ps(result, x, is_infinite);
+    }
+
+    template<MathAccuracy accuracy>
+    inline __m256 fastTanhAvx2(__m256 x) {
+        const __m256 sign_bit = _mm256_set1_ps(-0.f);
+        const __m256 magnitude = _mm256_andnot_ps(sign_bit, x);
+        const __m256 e = fastExpAvx2<accuracy>(_mm256_mul_ps(magnitude, _mm256_set1_ps(-2.f)));
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 result = _mm256_div_ps(_mm256_sub_ps(one, e), _mm256_add_ps(one, e));
+        return _mm256_or_ps(result, _mm256_and_ps(sign_bit, x));
+    }
+
+    template<MathAccuracy accuracy>
+    inline __m256 fastSigmoidAvx2(__m256 x) {
+        const __m256 magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+        const __m256 e = fastExpAvx2<accuracy>(_mm256_sub_ps(_mm256_setzero_ps(), magnitude));
+        const __m256 positive = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(_mm256_set1_ps(1.f), e));
+        const __m256 negative = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+        return _mm256_blendv_ps(positive, _mm256_mul_ps(e, positive), negative);
+    }
+
+#define HAPPYML_FAST_MATH_ROW(vectorFunction, scalarFunction) \
+        size_t offset = 0; \
+        for (; offset + 8 <= count; offset += 8) { \
+            _mm256_storeu_ps(out + offset, vectorFunction(_mm256_loadu_ps(values + offset))); \
+        } \
+        for (; offset < count; offset++) { \
+            out[offset] = scalarFunction(values[offset]); \
+        }
+#else
+#define HAPPYML_FAST_MATH_ROW(vectorFunction, scalarFunction) \
+        for (size_t offset = 0; offset < count; offset++) { \
+            out[offset] = scalarFunction(values[offset]); \
+        }
+#endif
+
+    template<MathAccuracy accuracy = MathAccuracy::full>
+    inline void fastExpValues(const float *values, float *out, size_t count) {
+        HAPPYML_FAST_MATH_ROW(fastExpAvx2<accuracy>, fastExp<accuracy>)
+    }
+
+    inline void fastLogValues(const float *values, float *out, size_t count) {
+        HAPPYML_FAST_MATH_ROW(fastLogAvx2, fastLog)
+    }
+
+    template<MathAccuracy accuracy = MathAccuracy::full>
+    inline void fastTanhValues(const float *values, float *out, size_t count) {
+        HAPPYML_FAST_MATH_ROW(fastTanhAvx2<accuracy>, fastTanh<accuracy>)
+    }
+
+    template<MathAccuracy accuracy = MathAccuracy::full>
+    inline void fastSigmoidValues(const float *values, float *out, size_t count) {
+        HAPPYML_FAST_MATH_ROW(fastSigmoidAvx2<accuracy>, fastSigmoid<accuracy>)
+    }
+
+#undef HAPPYML_FAST_MATH_ROW
+}
+
+#endif //HAPPYML_FAST_MATH_HPP
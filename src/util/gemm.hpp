@@ -0,0 +1,482 @@
+//
+// Created by Erik Hyrkas on 1/2/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_GEMM_HPP
+#define HAPPYML_GEMM_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+#include "tensor_arena.hpp"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+#include <immintrin.h>
+
+#endif
+
+using namespace std;
+
+namespace happyml {
+
+    // This is a small matrix multiply engine in the style of the well-known BLAS implementations (GotoBLAS,
+    // BLIS, OpenBLAS). The idea is simple, even if the code isn't:
+    //   * Split the matrices into blocks that fit in the caches. A block of b (kc x nc) stays in L3/L2 while
+    //     we sweep over blocks of a (mc x kc), which stay in L2.
+    //   * Copy ("pack") each block into the exact order the innermost loop will read it, so every load
+    //     is sequential, no matter how the original matrix was laid out (row major, transposed, whatever.)
+    //   * The innermost loop (micro-kernel) computes a tiny GEMM_MR x GEMM_NR tile of c entirely in
+    //     registers, using SIMD when we were compiled with AVX2 or AVX-512.
+    //   * Big enough problems split blocks of rows across threads.
+    // See "Anatomy of High-Performance Matrix Multiplication" (Goto, van de Geijn) if you want the full story.
+
+    // A matrix somewhere in memory: element (row, column) is at data[row * rowStride + column * columnStride].
+    // A row major matrix has a columnStride of 1, and its transpose is the same buffer with the strides swapped.
+    struct StridedMatrix {
+        const float *data;
+        size_t rowStride;
+        size_t columnStride;
+    };
+
+#if defined(__AVX512F__)
+#define HAPPYML_GEMM_AVX512
+    constexpr size_t GEMM_MR = 6;
+    constexpr size_t GEMM_NR = 32;
+#elif defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define HAPPYML_GEMM_AVX2
+    constexpr size_t GEMM_MR = 6;
+    constexpr size_t GEMM_NR = 16;
+#else
+    constexpr size_t GEMM_MR = 4;
+    constexpr size_t GEMM_NR = 16;
+#endif
+
+    // Block sizes. These are reasonable for the desktop chips I have access to: a packed block of a is
+    // GEMM_MC * GEMM_KC * 4 bytes (~120kb) and a packed block of b is GEMM_KC * GEMM_NC * 4 bytes (~2mb).
+    constexpr size_t GEMM_MC = 120;
+    constexpr size_t GEMM_KC = 256;
+    constexpr size_t GEMM_NC = 2048;
+
+    // Below this many multiply-adds, starting threads costs more than it saves.
+    constexpr size_t GEMM_PARALLEL_THRESHOLD = 1 << 22;
+
+    // Below this many rows, packing b costs about as much as the multiply itself, so we stream over b instead.
+    constexpr size_t GEMM_SMALL_ROWS = 4;
+
+    // Copies an mc x kc block of a into panels of GEMM_MR rows. Within a panel, the GEMM_MR values for each k
+    // are adjacent, which is the order the micro-kernel consumes them in. Short panels are padded with zeros.
+    inline void packGemmA(const StridedMatrix &a, size_t firstRow, size_t mc, size_t firstK, size_t kc,
+                          float *packed) {
+        for (size_t panel = 0; panel < mc; panel += GEMM_MR) {
+            const size_t panel_rows = std::min(GEMM_MR, mc - panel);
+            const float *source = a.data + ((firstRow + panel) * a.rowStride) + (firstK * a.columnStride);
+            for (size_t k = 0; k < kc; k++) {
+                const float *column = source + (k * a.columnStride);
+                for (size_t i = 0; i < panel_rows; i++) {
+                    packed[i] = column[i * a.rowStride];
+                }
+                for (size_t i = panel_rows; i < GEMM_MR; i++) {
+                    packed[i] = 0.f;
+                }
+                packed += GEMM_MR;
+            }
+        }
+    }
+
+    // Copies a kc x nc block of b into panels of GEMM_NR columns, with the GEMM_NR values for each k adjacent.
+    inline void packGemmB(const StridedMatrix &b, size_t firstK, size_t kc, size_t firstColumn, size_t nc,
+                          float *packed) {
+        for (size_t panel = 0; panel < nc; panel += GEMM_NR) {
+            const size_t panel_columns = std::min(GEMM_NR, nc - panel);
+            const float *source = b.data + (firstK * b.rowStride) + ((firstColumn + panel) * b.columnStride);
+            for (size_t k = 0; k < kc; k++) {
+                const float *row = source + (k * b.rowStride);
+                if (b.columnStride == 1) {
+                    std::memcpy(packed, row, panel_columns * sizeof(float));
+                } else {
+                    for (size_t j = 0; j < panel_columns; j++) {
+                        packed[j] = row[j * b.columnStride];
+                    }
+                }
+                for (size_t j = panel_columns; j < GEMM_NR; j++) {
+                    packed[j] = 0.f;
+                }
+                packed += GEMM_NR;
+            }
+        }
+    }
+
+    // Adds a GEMM_MR x GEMM_NR tile to c, but only the part of it that is actually inside of c.
+    inline void addGemmTile(const float *tile, float *c, size_t ldc, size_t rows, size_t columns) {
+        for (size_t i = 0; i < rows; i++) {
+            float *c_row = c + (i * ldc);
+            const float *tile_row = tile + (i * GEMM_NR);
+            for (size_t j = 0; j < columns; j++) {
+                c_row[j] += tile_row[j];
+            }
+        }
+    }
+
+    // c += packed a panel * packed b panel, for a rows x columns corner of a GEMM_MR x GEMM_NR tile.
+#if defined(HAPPYML_GEMM_AVX512)
+
+    inline void gemmMicroKernel(size_t kc, const float *a, const float *b, float *c, size_t ldc,
+                                size_t rows, size_t columns) {
+        __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+        __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+        __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+        __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+        __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+        __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+        for (size_t p = 0; p < kc; p++) {
+            const __m512 b0 = _mm512_loadu_ps(b);
+            const __m512 b1 = _mm512_loadu_ps(b + 16);
+            __m512 a_value = _mm512_set1_ps(a[0]);
+            c00 = _mm512_fmadd_ps(a_value, b0, c00);
+            c01 = _mm512_fmadd_ps(a_value, b1, c01);
+            a_value = _mm512_set1_ps(a[1]);
+            c10 = _mm512_fmadd_ps(a_value, b0, c10);
+            c11 = _mm512_fmadd_ps(a_value, b1, c11);
+            a_value = _mm512_set1_ps(a[2]);
+            c20 = _mm512_fmadd_ps(a_value, b0, c20);
+            c21 = _mm512_fmadd_ps(a_value, b1, c21);
+            a_value = _mm512_set1_ps(a[3]);
+            c30 = _mm512_fmadd_ps(a_value, b0, c30);
+            c31 = _mm512_fmadd_ps(a_value, b1, c31);
+            a_value = _mm512_set1_ps(a[4]);
+            c40 = _mm512_fmadd_ps(a_value, b0, c40);
+            c41 = _mm512_fmadd_ps(a_value, b1, c41);
+            a_value = _mm512_set1_ps(a[5]);
+            c50 = _mm512_fmadd_ps(a_value, b0, c50);
+            c51 = _mm512_fmadd_ps(a_value, b1, c51);
+            a += GEMM_MR;
+            b += GEMM_NR;
+        }
+        alignas(64) float tile[GEMM_MR * GEMM_NR];
+        _mm512_store_ps(tile, c00);
+        _mm512_store_ps(tile + 16, c01);
+        _mm512_store_ps(tile + 32, c10);
+        _mm512_store_ps(tile + 48, c11);
+        _mm512_store_ps(tile + 64, c20);
+        _mm512_store_ps(tile + 80, c21);
+        _mm512_store_ps(tile + 96, c30);
+        _mm512_store_ps(tile + 112, c31);
+        _mm512_store_ps(tile + 128, c40);
+        _mm512_store_ps(tile + 144, c41);
+        _mm512_store_ps(tile + 160, c50);
+        _mm512_store_ps(tile + 176, c51);
+        addGemmTile(tile, c, ldc, rows, columns);
+    }
+
+#elif defined(HAPPYML_GEMM_AVX2)
+
+    inline void gemmMicroKernel(size_t kc, const float *a, const float *b, float *c, size_t ldc,
+                                size_t rows, size_t columns) {
+        __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+        __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+        __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+        __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+        __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+        __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+        for (size_t p = 0; p < kc; p++) {
+            const __m256 b0 = _mm256_loadu_ps(b);
+            const __m256 b1 = _mm256_loadu_ps(b + 8);
+            __m256 a_value = _mm256_broadcast_ss(a);
+            c00 = _mm256_fmadd_ps(a_value, b0, c00);
+            c01 = _mm256_fmadd_ps(a_value, b1, c01);
+            a_value = _mm256_broadcast_ss(a + 1);
+            c10 = _mm256_fmadd_ps(a_value, b0, c10);
+            c11 = _mm256_fmadd_ps(a_value, b1, c11);
+            a_value = _mm256_broadcast_ss(a + 2);
+            c20 = _mm256_fmadd_ps(a_value, b0, c20);
+            c21 = _mm256_fmadd_ps(a_value, b1, c21);
+            a_value = _mm256_broadcast_ss(a + 3);
+            c30 = _mm256_fmadd_ps(a_value, b0, c30);
+            c31 = _mm256_fmadd_ps(a_value, b1, c31);
+            a_value = _mm256_broadcast_ss(a + 4);
+            c40 = _mm256_fmadd_ps(a_value, b0, c40);
+            c41 = _mm256_fmadd_ps(a_value, b1, c41);
+            a_value = _mm256_broadcast_ss(a + 5);
+            c50 = _mm256_fmadd_ps(a_value, b0, c50);
+            c51 = _mm256_fmadd_ps(a_value, b1, c51);
+            a += GEMM_MR;
+            b += GEMM_NR;
+        }
+        alignas(32) float tile[GEMM_MR * GEMM_NR];
+        _mm256_store_ps(tile, c00);
+        _mm256_store_ps(tile + 8, c01);
+        _mm256_store_ps(tile + 16, c10);
+        _mm256_store_ps(tile + 24, c11);
+        _mm256_store_ps(tile + 32, c20);
+        _mm256_store_ps(tile + 40, c21);
+        _mm256_store_ps(tile + 48, c30);
+        _mm256_store_ps(tile + 56, c31);
+        _mm256_store_ps(tile + 64, c40);
+        _mm256_store_ps(tile + 72, c41);
+        _mm256_store_ps(tile + 80, c50);
+        _mm256_store_ps(tile + 88, c51);
+        addGemmTile(tile, c, ldc, rows, columns);
+    }
+
+#else
+
+    // Without SIMD intrinsics, we still get the benefit of blocking and packing. The inner loop over j
+    // is simple enough that most compilers will vectorize it on their own at higher optimization levels.
+    inline void gemmMicroKernel(size_t kc, const float *a, const float *b, float *c, size_t ldc,
+                                size_t rows, size_t columns) {
+        float tile[GEMM_MR * GEMM_NR] = {};
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t i = 0; i < GEMM_MR; i++) {
+                const float a_value = a[i];
+                float *tile_row = tile + (i * GEMM_NR);
+                for (size_t j = 0; j < GEMM_NR; j++) {
+                    tile_row[j] += a_value * b[j];
+                }
+            }
+            a += GEMM_MR;
+            b += GEMM_NR;
+        }
+        addGemmTile(tile, c, ldc, rows, columns);
+    }
+
+#endif
+
+    // Splits [0, count) into contiguous ranges of whole steps and runs them on separate threads,
+    // but only when there is enough work to justify it.
+    inline void gemmParallelFor(size_t count, size_t step, size_t work,
+                                const function<void(size_t, size_t)> &task) {
+        const size_t steps = (count + step - 1) / step;
+        const size_t hardware_threads = std::max((size_t) 1, (size_t) thread::hardware_concurrency());
+        const size_t threads = std::min(hardware_threads, steps);
+        if (work < GEMM_PARALLEL_THRESHOLD || threads < 2) {
+            task(0, count);
+            return;
+        }
+        const size_t steps_per_thread = (steps + threads - 1) / threads;
+        vector<future<void>> futures;
+        for (size_t begin = 0; begin < count; begin += steps_per_thread * step) {
+            const size_t end = std::min(count, begin + (steps_per_thread * step));
+            futures.push_back(std::async(std::launch::async, task, begin, end));
+        }
+        for (auto &next: futures) {
+            next.get();
+        }
+    }
+
+    // c = a * b for a small number of rows. Each row of c is either a sum of scaled rows of b (when b is row major)
+    // or a series of dot products against columns of b (when b is column major, like a transposed weight matrix.)
+    inline void gemmSmall(size_t m, size_t n, size_t k, const StridedMatrix &a, const StridedMatrix &b,
+                          float *c, size_t ldc, size_t firstColumn, size_t lastColumn) {
+        for (size_t i = 0; i < m; i++) {
+            const float *a_row = a.data + (i * a.rowStride);
+            float *c_row = c + (i * ldc);
+            if (b.columnStride == 1) {
+                std::fill(c_row + firstColumn, c_row + lastColumn, 0.f);
+                for (size_t p = 0; p < k; p++) {
+                    const float a_value = a_row[p * a.columnStride];
+                    const float *b_row = b.data + (p * b.rowStride);
+                    for (size_t j = firstColumn; j < lastColumn; j++) {
+                        c_row[j] += a_value * b_row[j];
+                    }
+                }
+            } else {
+                for (size_t j = firstColumn; j < lastColumn; j++) {
+                    const float *b_column = b.data + (j * b.columnStride);
+                    // a few independent sums let the compiler (and the cpu) overlap the additions.
+                    float sums[8] = {};
+                    size_t p = 0;
+                    for (; p + 8 <= k; p += 8) {
+                        for (size_t lane = 0; lane < 8; lane++) {
+                            sums[lane] += a_row[(p + lane) * a.columnStride] * b_column[(p + lane) * b.rowStride];
+                        }
+                    }
+                    float sum = ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+                    for (; p < k; p++) {
+                        sum += a_row[p * a.columnStride] * b_column[p * b.rowStride];
+                    }
+                    c_row[j] = sum;
+                }
+            }
+        }
+    }
+
+    // c = a * b, where a is m x k, b is k x n, and c is m x n with ldc floats between the start of each row.
+    // c is overwritten, not accumulated into.
+    inline void gemm(size_t m, size_t n, size_t k, const StridedMatrix &a, const StridedMatrix &b,
+                     float *c, size_t ldc) {
+        if (m == 0 || n == 0) {
+            return;
+        }
+        const size_t work = m * n * k;
+        if (m < GEMM_SMALL_ROWS || k == 0) {
+            gemmParallelFor(n, GEMM_NR, work, [&](size_t begin, size_t end) {
+                gemmSmall(m, n, k, a, b, c, ldc, begin, end);
+            });
+            return;
+        }
+
+        for (size_t i = 0; i < m; i++) {
+            std::fill(c + (i * ldc), c + (i * ldc) + n, 0.f);
+        }
+        ArenaBuffer<float> packed_b(std::min(GEMM_KC, k) * (std::min(GEMM_NC, n) + GEMM_NR));
+        for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+            const size_t nc = std::min(GEMM_NC, n - jc);
+            for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                const size_t kc = std::min(GEMM_KC, k - pc);
+                packGemmB(b, pc, kc, jc, nc, packed_b.data());
+                gemmParallelFor(m, GEMM_MC, work, [&](size_t begin, size_t end) {
+                    ArenaBuffer<float> packed_a((GEMM_MC + GEMM_MR) * kc);
+                    for (size_t ic = begin; ic < end; ic += GEMM_MC) {
+                        const size_t mc = std::min(GEMM_MC, end - ic);
+                        packGemmA(a, ic, mc, pc, kc, packed_a.data());
+                        for (size_t jr = 0; jr < nc; jr += GEMM_NR) {
+                            const float *b_panel = packed_b.data() + (jr * kc);
+                            for (size_t ir = 0; ir < mc; ir += GEMM_MR) {
+                                gemmMicroKernel(kc, packed_a.data() + (ir * kc), b_panel,
+                                                c + ((ic + ir) * ldc) + jc + jr, ldc,
+                                                std::min(GEMM_MR, mc - ir), std::min(GEMM_NR, nc - jr));
+                            }
+                        }
+                    }
+                });
+            }
+        }
+    }
+    // b packed once, in the order gemm() would otherwise pack it on every call: blocks of GEMM_KC rows by GEMM_NC
+    // columns, each one laid out by packGemmB(). Weights are read many times between changes (and never change
+    // at all when we're only predicting), so they only pay for packing once.
+    //
+    // Column blocks come one after another, and within one, its row blocks. Every column block but the last is
+    // GEMM_NC wide, which is a multiple of GEMM_NR, so none of them is padded.
+    struct PackedGemmMatrix {
+        size_t rows = 0;
+        size_t columns = 0;
+        vector<float> values;
+
+        // columns of the column block starting at firstColumn, padded out to whole panels
+        [[nodiscard]] inline size_t paddedBlockColumns(size_t firstColumn) const {
+            const size_t nc = std::min(GEMM_NC, columns - firstColumn);
+            return ((nc + GEMM_NR - 1) / GEMM_NR) * GEMM_NR;
+        }
+
+        // the block holding rows [firstRow, firstRow + GEMM_KC) and columns [firstColumn, firstColumn + GEMM_NC)
+        [[nodiscard]] inline const float *block(size_t firstRow, size_t firstColumn) const {
+            return values.data() + (firstColumn * rows) + (firstRow * paddedBlockColumns(firstColumn));
+        }
+
+        [[nodiscard]] inline size_t offsetOf(size_t row, size_t column) const {
+            const size_t first_row = row - (row % GEMM_KC);
+            const size_t first_column = column - (column % GEMM_NC);
+            const size_t kc = std::min(GEMM_KC, rows - first_row);
+            const size_t in_block = column - first_column;
+            return (first_column * rows) + (first_row * paddedBlockColumns(first_column)) +
+                   ((in_block / GEMM_NR) * kc * GEMM_NR) + ((row - first_row) * GEMM_NR) + (in_block % GEMM_NR);
+        }
+    };
+
+    inline void packGemmMatrix(const StridedMatrix &b, size_t k, size_t n, PackedGemmMatrix &packed) {
+        packed.rows = k;
+        packed.columns = n;
+        size_t total = 0;
+        for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+            total += k * packed.paddedBlockColumns(jc);
+        }
+        packed.values.resize(total);
+        for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+            for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                packGemmB(b, pc, std::min(GEMM_KC, k - pc), jc, std::min(GEMM_NC, n - jc),
+                          packed.values.data() + (jc * k) + (pc * packed.paddedBlockColumns(jc)));
+            }
+        }
+    }
+
+    // Adds the columns [firstColumn, lastColumn) of a GEMM_MR x GEMM_NR tile into c, whose first column is
+    // firstColumn.
+    inline void addGemmTileColumns(const float *tile, float *c, size_t ldc, size_t rows, size_t firstColumn,
+                                   size_t lastColumn) {
+        for (size_t i = 0; i < rows; i++) {
+            float *c_row = c + (i * ldc);
+            const float *tile_row = tile + (i * GEMM_NR);
+            for (size_t j = firstColumn; j < lastColumn; j++) {
+                c_row[j - firstColumn] += tile_row[j];
+            }
+        }
+    }
+
+    // c = a * b for the columns [firstColumn, firstColumn + n) of a packed b, where a is m x b.rows. The same
+    // loops as gemm(), minus packing b. With only a row or two of a (predicting one sample at a time), each
+    // panel's GEMM_NR sums stay in registers while we walk straight down the panel.
+    inline void gemmPacked(size_t m, size_t n, const StridedMatrix &a, const PackedGemmMatrix &b,
+                           size_t firstColumn, float *c, size_t ldc) {
+        if (m == 0 || n == 0) {
+            return;
+        }
+        const size_t k = b.rows;
+        const size_t last_column = firstColumn + n;
+        for (size_t i = 0; i < m; i++) {
+            std::fill(c + (i * ldc), c + (i * ldc) + n, 0.f);
+        }
+        const size_t work = m * n * k;
+        for (size_t jc = firstColumn - (firstColumn % GEMM_NC); jc < last_column; jc += GEMM_NC) {
+            const size_t nc = std::min(GEMM_NC, b.columns - jc);
+            // the panels of this block that overlap [firstColumn, last_column)
+            const size_t first_panel = (std::max(firstColumn, jc) - jc) / GEMM_NR;
+            const size_t last_panel = (std::min(last_column, jc + nc) - jc + GEMM_NR - 1) / GEMM_NR;
+            for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                const size_t kc = std::min(GEMM_KC, k - pc);
+                const float *packed_b = b.block(pc, jc);
+                auto add_panel = [&](const float *tile, size_t panel, float *c_rows, size_t rows) {
+                    const size_t panel_first = jc + (panel * GEMM_NR);
+                    const size_t from = std::max(firstColumn, panel_first);
+                    const size_t to = std::min(last_column, panel_first + GEMM_NR);
+                    addGemmTileColumns(tile, c_rows + (from - firstColumn), ldc, rows, from - panel_first,
+                                       to - panel_first);
+                };
+                if (m < GEMM_SMALL_ROWS) {
+                    gemmParallelFor(last_panel - first_panel, 1, work, [&](size_t begin, size_t end) {
+                        for (size_t i = 0; i < m; i++) {
+                            const float *a_row = a.data + (i * a.rowStride) + (pc * a.columnStride);
+                            for (size_t panel = first_panel + begin; panel < first_panel + end; panel++) {
+                                const float *b_panel = packed_b + (panel * kc * GEMM_NR);
+                                float sums[GEMM_NR] = {};
+                                for (size_t p = 0; p < kc; p++) {
+                                    const float a_value = a_row[p * a.columnStride];
+                                    const float *b_row = b_panel + (p * GEMM_NR);
+                                    for (size_t j = 0; j < GEMM_NR; j++) {
+                                        sums[j] += a_value * b_row[j];
+                                    }
+                                }
+                                add_panel(sums, panel, c + (i * ldc), 1);
+                            }
+                        }
+                    });
+                    continue;
+                }
+                gemmParallelFor(m, GEMM_MC, work, [&](size_t begin, size_t end) {
+                    ArenaBuffer<float> packed_a((GEMM_MC + GEMM_MR) * kc);
+                    alignas(64) float tile[GEMM_MR * GEMM_NR];
+                    for (size_t ic = begin; ic < end; ic += GEMM_MC) {
+                        const size_t mc = std::min(GEMM_MC, end - ic);
+                        packGemmA(a, ic, mc, pc, kc, packed_a.data());
+                        for (size_t panel = first_panel; panel < last_panel; panel++) {
+                            const float *b_panel = packed_b + (panel * kc * GEMM_NR);
+                            for (size_t ir = 0; ir < mc; ir += GEMM_MR) {
+                                std::fill(tile, tile + (GEMM_MR * GEMM_NR), 0.f);
+                                gemmMicroKernel(kc, packed_a.data() + (ir * kc), b_panel, tile, GEMM_NR,
+                                                GEMM_MR, GEMM_NR);
+                                add_panel(tile, panel, c + ((ic + ir) * ldc), std::min(GEMM_MR, mc - ir));
+                            }
+                        }
+                    }
+                });
+            }
+        }
+    }
+}
+
+#endif //HAPPYML_GEMM_HPP
@@ -0,0 +1,183 @@
+//
+// Created by Erik Hyrkas on 1/5/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_MEMORY_MAPPED_FILE_HPP
+#define HAPPYML_MEMORY_MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+using namespace std;
+
+namespace happyml {
+
+    // How we expect to walk through a mapped file. The operating system uses this to decide how much to read
+    // ahead and how eagerly to drop pages we've already looked at.
+    enum class MappedAccess {
+        normal, sequential, random
+    };
+
+    // Maps a whole file into our address space. Nothing is actually read until we touch a page, and the operating
+    // system is free to drop pages we aren't using, so the file can be much bigger than the memory we have.
+    // This is the one place we deal with OS-specific calls for memory mapping: POSIX (mmap) and Windows.
+    class MemoryMappedFile {
+    public:
+        MemoryMappedFile(const string &path, bool writable, MappedAccess access) {
+            this->writable = writable;
+            this->mappedSize = 0;
+            this->mapped = nullptr;
+#ifdef _WIN32
+            DWORD flags = FILE_ATTRIBUTE_NORMAL;
+            if (access == MappedAccess::sequential) {
+                flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+            } else if (access == MappedAccess::random) {
+                flags |= FILE_FLAG_RANDOM_ACCESS;
+            }
+            fileHandle = CreateFileA(path.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ,
+                                     nullptr, OPEN_EXISTING, flags, nullptr);
+            if (fileHandle == INVALID_HANDLE_VALUE) {
+                throw exception("Unable to open file to map.");
+            }
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(fileHandle, &fileSize)) {
+                CloseHandle(fileHandle);
+                throw exception("Unable to find the size of the file to map.");
+            }
+            mappedSize = (size_t) fileSize.QuadPart;
+            mappingHandle = nullptr;
+            if (mappedSize > 0) {
+                mappingHandle = CreateFileMappingA(fileHandle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                                   0, 0, nullptr);
+                if (mappingHandle == nullptr) {
+                    CloseHandle(fileHandle);
+                    throw exception("Unable to map file.");
+                }
+                mapped = (uint8_t *) MapViewOfFile(mappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+                if (mapped == nullptr) {
+                    CloseHandle(mappingHandle);
+                    CloseHandle(fileHandle);
+                    throw exception("Unable to map a view of the file.");
+                }
+            }
+#else
+            fileDescriptor = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+            if (fileDescriptor < 0) {
+                throw exception("Unable to open file to map.");
+            }
+            struct stat fileStats{};
+            if (fstat(fileDescriptor, &fileStats) != 0) {
+                close(fileDescriptor);
+                throw exception("Unable to find the size of the file to map.");
+            }
+            mappedSize = (size_t) fileStats.st_size;
+            if (mappedSize > 0) {
+                void *address = mmap(nullptr, mappedSize, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED,
+                                     fileDescriptor, 0);
+                if (address == MAP_FAILED) {
+                    close(fileDescriptor);
+                    throw exception("Unable to map file.");
+                }
+                mapped = (uint8_t *) address;
+            }
+#endif
+            advise(access);
+        }
+
+        ~MemoryMappedFile() {
+#ifdef _WIN32
+            if (mapped != nullptr) {
+                UnmapViewOfFile(mapped);
+                CloseHandle(mappingHandle);
+            }
+            CloseHandle(fileHandle);
+#else
+            if (mapped != nullptr) {
+                munmap(mapped, mappedSize);
+            }
+            close(fileDescriptor);
+#endif
+        }
+
+        MemoryMappedFile(const MemoryMappedFile &) = delete;
+
+        MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+
+        inline uint8_t *data() {
+            return mapped;
+        }
+
+        [[nodiscard]] inline size_t size() const {
+            return mappedSize;
+        }
+
+        [[nodiscard]] inline bool isWritable() const {
+            return writable;
+        }
+
+        // Tell the operating system how we're about to use the mapping. On Windows, the hint can only be given
+        // when the file is opened, so this does nothing there.
+        void advise(MappedAccess access) {
+#ifndef _WIN32
+            if (mapped == nullptr) {
+                return;
+            }
+            int advice = MADV_NORMAL;
+            if (access == MappedAccess::sequential) {
+                advice = MADV_SEQUENTIAL;
+            } else if (access == MappedAccess::random) {
+                advice = MADV_RANDOM;
+            }
+            // this is only a hint, so there's nothing useful to do if it fails.
+            madvise(mapped, mappedSize, advice);
+#endif
+        }
+
+        // Writes any changes we've made through the mapping back to the file before returning.
+        void flush() {
+            if (mapped == nullptr || !writable) {
+                return;
+            }
+#ifdef _WIN32
+            if (!FlushViewOfFile(mapped, 0) || !FlushFileBuffers(fileHandle)) {
+                throw exception("Unable to flush mapped file.");
+            }
+#else
+            if (msync(mapped, mappedSize, MS_SYNC) != 0) {
+                throw exception("Unable to flush mapped file.");
+            }
+#endif
+        }
+
+    private:
+        uint8_t *mapped;
+        size_t mappedSize;
+        bool writable;
+#ifdef _WIN32
+        HANDLE fileHandle;
+        HANDLE mappingHandle;
+#else
+        int fileDescriptor;
+#endif
+    };
+}
+
+#endif //HAPPYML_MEMORY_MAPPED_FILE_HPP
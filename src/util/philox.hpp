@@ -0,0 +1,157 @@
+//
+// Created by Erik Hyrkas on 1/16/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_PHILOX_HPP
+#define HAPPYML_PHILOX_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#endif
+
+using namespace std;
+
+// Philox 4x32-10, the counter-based random number generator from "Parallel Random Numbers: As Easy as 1, 2, 3"
+// (Salmon, Moraes, Dror, Shaw.) It's what I was after when I gave up on xorshift for TensorFromRandom: rather than
+// stepping a state forward, it scrambles a counter with a key (our seed) through ten rounds of multiplies and
+// xors. So the n-th random number costs the same as the first, any thread can work out any part of the stream
+// without talking to the others, and the same seed always gives the same numbers, no matter who asks or in
+// what order. It also passes the usual statistical test suites (BigCrush), which my fmod trick never would.
+//
+// Each block (a counter) gives four 32-bit words, and word n of the stream is word n % 4 of block n / 4.
+// With AVX2, we scramble eight blocks at once.
+namespace happyml {
+
+    constexpr uint32_t PHILOX_MULTIPLIER_0 = 0xD2511F53;
+    constexpr uint32_t PHILOX_MULTIPLIER_1 = 0xCD9E8D57;
+    // added to the key after each round (the golden ratio and sqrt(3) - 1, as fractions of 2^32.)
+    constexpr uint32_t PHILOX_KEY_STEP_0 = 0x9E3779B9;
+    constexpr uint32_t PHILOX_KEY_STEP_1 = 0xBB67AE85;
+    constexpr size_t PHILOX_ROUNDS = 10;
+    // 2^-24: a float has 24 bits of precision, so that's as many random bits as a value between 0 and 1 can use.
+    constexpr float PHILOX_UNIT = 1.f / 16777216.f;
+
+    inline array<uint32_t, 4> philox4x32(array<uint32_t, 4> counter, array<uint32_t, 2> key) {
+        for (size_t round = 0; round < PHILOX_ROUNDS; round++) {
+            if (round > 0) {
+                key[0] += PHILOX_KEY_STEP_0;
+                key[1] += PHILOX_KEY_STEP_1;
+            }
+            const uint64_t product0 = (uint64_t) PHILOX_MULTIPLIER_0 * counter[0];
+            const uint64_t product1 = (uint64_t) PHILOX_MULTIPLIER_1 * counter[2];
+            counter = {(uint32_t) (product1 >> 32) ^ counter[1] ^ key[0], (uint32_t) product1,
+                       (uint32_t) (product0 >> 32) ^ counter[3] ^ key[1], (uint32_t) product0};
+        }
+        return counter;
+    }
+
+    inline array<uint32_t, 2> philoxKey(uint64_t seed) {
+        return {(uint32_t) seed, (uint32_t) (seed >> 32)};
+    }
+
+    // word index of the stream for seed.
+    inline uint32_t philoxWord(uint64_t seed, uint64_t index) {
+        const uint64_t block = index / 4;
+        return philox4x32({(uint32_t) block, (uint32_t) (block >> 32), 0, 0}, philoxKey(seed))[index % 4];
+    }
+
+#if defined(__AVX2__)
+
+    // high and low halves of a * multiplier, for each of the eight 32-bit lanes.
+    inline void philoxMultiplyAvx2(__m256i a, __m256i multiplier, __m256i &high, __m256i &low) {
+        // _mm256_mul_epu32 only multiplies the even lanes, so the odd ones get shifted down and done separately.
+        const __m256i even = _mm256_mul_epu32(a, multiplier);
+        const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), multiplier);
+        low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+
+    // blocks firstBlock through firstBlock + 7, word by word: words[w][lane] is word w of block firstBlock + lane.
+    inline void philoxBlocksAvx2(uint64_t seed, uint64_t firstBlock, uint32_t words[4][8]) {
+        alignas(32) uint32_t low[8];
+        alignas(32) uint32_t high[8];
+        for (size_t lane = 0; lane < 8; lane++) {
+            low[lane] = (uint32_t) (firstBlock + lane);
+            high[lane] = (uint32_t) ((firstBlock + lane) >> 32);
+        }
+        __m256i c0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(low));
+        __m256i c1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(high));
+        __m256i c2 = _mm256_setzero_si256();
+        __m256i c3 = _mm256_setzero_si256();
+        const auto key = philoxKey(seed);
+        __m256i k0 = _mm256_set1_epi32((int) key[0]);
+        __m256i k1 = _mm256_set1_epi32((int) key[1]);
+        const __m256i multiplier0 = _mm256_set1_epi32((int) PHILOX_MULTIPLIER_0);
+        const __m256i multiplier1 = _mm256_set1_epi32((int) PHILOX_MULTIPLIER_1);
+        for (size_t round = 0; round < PHILOX_ROUNDS; round++) {
+            if (round > 0) {
+                k0 = _mm256_add_epi32(k0, _mm256_set1_epi32((int) PHILOX_KEY_STEP_0));
+                k1 = _mm256_add_epi32(k1, _mm256_set1_epi32((int) PHILOX_KEY_STEP_1));
+            }
+            __m256i high0, low0, high1, low1;
+            philoxMultiplyAvx2(c0, multiplier0, high0, low0);
+            philoxMultiplyAvx2(c2, multiplier1, high1, low1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(high1, c1), k0);
+            c1 = low1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(high0, c3), k1);
+            c3 = low0;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[0]), c0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[1]), c1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[2]), c2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[3]), c3);
+    }
+
+#endif
+
+    // words firstIndex through firstIndex + count - 1 of the stream for seed. The same as calling philoxWord()
+    // for each, but a block at a time (eight blocks at a time with AVX2.)
+    inline void philoxWords(uint64_t seed, uint64_t firstIndex, size_t count, uint32_t *out) {
+        uint64_t index = firstIndex;
+        const uint64_t end = firstIndex + count;
+#if defined(__AVX2__)
+        uint32_t words[4][8];
+        while (index < end) {
+            const uint64_t first_block = index / 4;
+            philoxBlocksAvx2(seed, first_block, words);
+            const uint64_t batch_end = std::min(end, (first_block + 8) * 4);
+            for (; index < batch_end; index++) {
+                *out++ = words[index % 4][index / 4 - first_block];
+            }
+        }
+#else
+        const auto key = philoxKey(seed);
+        while (index < end) {
+            const uint64_t block = index / 4;
+            const auto words = philox4x32({(uint32_t) block, (uint32_t) (block >> 32), 0, 0}, key);
+            const uint64_t block_end = std::min(end, (block + 1) * 4);
+            for (; index < block_end; index++) {
+                *out++ = words[index % 4];
+            }
+        }
+#endif
+    }
+
+    // [0, 1)
+    inline float philoxUnitFloat(uint32_t word) {
+        return (float) (word >> 8) * PHILOX_UNIT;
+    }
+
+    // Box-Muller: two uniform words make one value from the standard normal distribution (mean 0, standard
+    // deviation 1.) The first one is moved to (0, 1], so we never take the log of zero.
+    inline float philoxStandardNormal(uint32_t first, uint32_t second) {
+        const float above_zero = (float) ((first >> 8) + 1) * PHILOX_UNIT;
+        const float angle = philoxUnitFloat(second) * 6.283185307179586f;
+        return std::sqrt(-2.f * std::log(above_zero)) * std::cos(angle);
+    }
+}
+
+#endif //HAPPYML_PHILOX_HPP
@@ -0,0 +1,159 @@
+//
+// Created by Erik Hyrkas on 1/7/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_POOLED_ALLOCATOR_HPP
+#define HAPPYML_POOLED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+
+using namespace std;
+
+namespace happyml {
+
+    // Views are tiny objects, and we build and throw away thousands of them for every sample we train on. A
+    // convolution layer alone builds filters x input depth x 3 of them on the way forward, and more on the way
+    // back. Each one used to be its own trip to the heap.
+    //
+    // This keeps freed blocks of each small size on a per-thread free list and hands them out again. Since the
+    // lists belong to one thread, there is no locking at all. A block freed on a different thread than the one
+    // that allocated it simply joins that thread's list, which is fine: a block is just memory.
+    class ThreadLocalBlockPool {
+    public:
+        static void *allocate(const size_t bytes) {
+            if (bytes > MAX_POOLED_BYTES) {
+                return ::operator new(bytes);
+            }
+            const size_t size_class = sizeClassOf(bytes);
+            ThreadLocalBlockPool *pool = current();
+            if (pool != nullptr) {
+                FreeBlock *block = pool->heads[size_class];
+                if (block != nullptr) {
+                    pool->heads[size_class] = block->next;
+                    pool->counts[size_class]--;
+                    pool->reused++;
+                    return block;
+                }
+                pool->fresh++;
+            }
+            // always ask for the full class size, since the block may end up on a free list later.
+            return ::operator new((size_class + 1) * GRANULE);
+        }
+
+        static void release(void *pointer, const size_t bytes) {
+            if (pointer == nullptr) {
+                return;
+            }
+            if (bytes <= MAX_POOLED_BYTES) {
+                const size_t size_class = sizeClassOf(bytes);
+                ThreadLocalBlockPool *pool = current();
+                if (pool != nullptr && pool->counts[size_class] < MAX_BLOCKS_PER_CLASS) {
+                    auto *block = static_cast<FreeBlock *>(pointer);
+                    block->next = pool->heads[size_class];
+                    pool->heads[size_class] = block;
+                    pool->counts[size_class]++;
+                    return;
+                }
+            }
+            ::operator delete(pointer);
+        }
+
+        // blocks this thread has had to get from the heap since it started
+        static size_t freshAllocations() {
+            ThreadLocalBlockPool *pool = current();
+            return pool == nullptr ? 0 : pool->fresh;
+        }
+
+        // blocks this thread has handed out again from its free lists
+        static size_t reusedAllocations() {
+            ThreadLocalBlockPool *pool = current();
+            return pool == nullptr ? 0 : pool->reused;
+        }
+
+        ThreadLocalBlockPool(const ThreadLocalBlockPool &) = delete;
+
+        ThreadLocalBlockPool &operator=(const ThreadLocalBlockPool &) = delete;
+
+    private:
+        static constexpr size_t GRANULE = 16;
+        static constexpr size_t MAX_POOLED_BYTES = 512;
+        static constexpr size_t SIZE_CLASSES = MAX_POOLED_BYTES / GRANULE;
+        // enough for the biggest graphs we build per sample, without hoarding memory after a spike.
+        static constexpr size_t MAX_BLOCKS_PER_CLASS = 8192;
+
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        FreeBlock *heads[SIZE_CLASSES]{};
+        size_t counts[SIZE_CLASSES]{};
+        size_t fresh = 0;
+        size_t reused = 0;
+
+        ThreadLocalBlockPool() {
+            alive() = true;
+        }
+
+        ~ThreadLocalBlockPool() {
+            alive() = false;
+            for (auto &head: heads) {
+                while (head != nullptr) {
+                    FreeBlock *next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+
+        static inline size_t sizeClassOf(const size_t bytes) {
+            return bytes == 0 ? 0 : (bytes - 1) / GRANULE;
+        }
+
+        // Shared pointers can be released while a thread is shutting down, after its pool is already gone.
+        // The flag is a plain bool, so it is still safe to read then, and we fall back to the heap.
+        static bool &alive() {
+            thread_local bool value = false;
+            return value;
+        }
+
+        static ThreadLocalBlockPool *current() {
+            thread_local ThreadLocalBlockPool pool;
+            return alive() ? &pool : nullptr;
+        }
+    };
+
+    // A standard allocator over ThreadLocalBlockPool. Hand it to allocate_shared() and the object and its
+    // reference counts land in one pooled block.
+    template<typename T>
+    struct PooledAllocator {
+        using value_type = T;
+
+        PooledAllocator() noexcept = default;
+
+        template<typename U>
+        PooledAllocator(const PooledAllocator<U> &) noexcept {
+        }
+
+        T *allocate(const size_t count) {
+            return static_cast<T *>(ThreadLocalBlockPool::allocate(count * sizeof(T)));
+        }
+
+        void deallocate(T *pointer, const size_t count) noexcept {
+            ThreadLocalBlockPool::release(pointer, count * sizeof(T));
+        }
+
+        template<typename U>
+        bool operator==(const PooledAllocator<U> &) const noexcept {
+            return true;
+        }
+
+        template<typename U>
+        bool operator!=(const PooledAllocator<U> &) const noexcept {
+            return false;
+        }
+    };
+}
+
+#endif //HAPPYML_POOLED_ALLOCATOR_HPP
@@ -0,0 +1,259 @@
+//
+// Created by Erik Hyrkas on 1/6/2023.
+// Copyright 2023. Usable under MIT license.
+//
+
+#ifndef HAPPYML_TENSOR_ARENA_HPP
+#define HAPPYML_TENSOR_ARENA_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace happyml {
+
+    // Tensor values are aligned to a cache line (64 bytes), which is also wide enough for AVX-512 loads.
+    constexpr size_t TENSOR_DATA_ALIGNMENT = 64;
+
+    struct TensorArenaCounters {
+        // blocks we had to ask the operating system for
+        size_t systemAllocations = 0;
+        // blocks we handed out again from our free lists
+        size_t reusedAllocations = 0;
+        // blocks we asked the operating system for during the last finished batch. Once training warms up, this
+        // should be zero.
+        size_t lastBatchSystemAllocations = 0;
+        size_t liveBytes = 0;
+        size_t peakLiveBytes = 0;
+        size_t cachedBytes = 0;
+    };
+
+    // Every training step builds and throws away the same handful of tensors: the loss error, the averaged
+    // inputs, the input errors, the new weights, and the scratch buffers used while reading them. They are the
+    // same sizes every step, so rather than handing each of them back to the heap and asking for it again a
+    // moment later, we keep the freed blocks on a free list per size and hand them out again.
+    //
+    // Sizes are rounded up to one of four classes per power of two, so a block is never more than a quarter
+    // bigger than what was asked for, and tensors that are nearly the same size can share blocks.
+    //
+    // Call endBatch() at batch boundaries. Anything we haven't needed for a couple of batches (say, the sizes
+    // that only show up while testing) goes back to the operating system, as does anything over the cache limit.
+    class TensorArena {
+    public:
+        static TensorArena &instance() {
+            static TensorArena arena;
+            return arena;
+        }
+
+        TensorArena(const TensorArena &) = delete;
+
+        TensorArena &operator=(const TensorArena &) = delete;
+
+        ~TensorArena() {
+            trim();
+        }
+
+        void *allocate(const size_t bytes) {
+            const size_t block_size = sizeClass(bytes);
+            {
+                lock_guard<mutex> guard(lock);
+                live += block_size;
+                counters.peakLiveBytes = std::max(counters.peakLiveBytes, live);
+                auto &free_list = freeLists[block_size];
+                free_list.lastUsedBatch = batch;
+                if (!free_list.blocks.empty()) {
+                    void *block = free_list.blocks.back();
+                    free_list.blocks.pop_back();
+                    cached -= block_size;
+                    counters.reusedAllocations++;
+                    return block;
+                }
+                counters.systemAllocations++;
+                batchSystemAllocations++;
+            }
+            // we don't hold the lock while the operating system finds us memory.
+            return ::operator new(block_size, align_val_t(TENSOR_DATA_ALIGNMENT));
+        }
+
+        // bytes must be what was passed to allocate()
+        void release(void *block, const size_t bytes) {
+            if (block == nullptr) {
+                return;
+            }
+            const size_t block_size = sizeClass(bytes);
+            {
+                lock_guard<mutex> guard(lock);
+                live -= block_size;
+                if (cached + block_size <= cacheLimit) {
+                    freeLists[block_size].blocks.push_back(block);
+                    cached += block_size;
+                    return;
+                }
+            }
+            ::operator delete(block, align_val_t(TENSOR_DATA_ALIGNMENT));
+        }
+
+        void endBatch() {
+            vector<pair<void *, size_t>> stale;
+            {
+                lock_guard<mutex> guard(lock);
+                counters.lastBatchSystemAllocations = batchSystemAllocations;
+                batchSystemAllocations = 0;
+                for (auto &next: freeLists) {
+                    if (batch - next.second.lastUsedBatch >= STALE_BATCHES) {
+                        takeBlocks(next.first, next.second, stale);
+                    }
+                }
+                batch++;
+            }
+            freeBlocks(stale);
+        }
+
+        // Gives every cached block back to the operating system.
+        void trim() {
+            vector<pair<void *, size_t>> blocks;
+            {
+                lock_guard<mutex> guard(lock);
+                for (auto &next: freeLists) {
+                    takeBlocks(next.first, next.second, blocks);
+                }
+            }
+            freeBlocks(blocks);
+        }
+
+        // Most memory we'll keep around in free lists. Freed blocks beyond this go straight back to the heap.
+        void setCacheLimit(const size_t bytes) {
+            {
+                lock_guard<mutex> guard(lock);
+                cacheLimit = bytes;
+            }
+            if (cachedBytes() > bytes) {
+                trim();
+            }
+        }
+
+        TensorArenaCounters getCounters() {
+            lock_guard<mutex> guard(lock);
+            TensorArenaCounters result = counters;
+            result.liveBytes = live;
+            result.cachedBytes = cached;
+            return result;
+        }
+
+        size_t cachedBytes() {
+            lock_guard<mutex> guard(lock);
+            return cached;
+        }
+
+        static size_t sizeClass(const size_t bytes) {
+            if (bytes <= TENSOR_DATA_ALIGNMENT) {
+                return TENSOR_DATA_ALIGNMENT;
+            }
+            size_t power = TENSOR_DATA_ALIGNMENT;
+            while ((power << 1) <= bytes) {
+                power <<= 1;
+            }
+            const size_t step = power >> 2;
+            return ((bytes + step - 1) / step) * step;
+        }
+
+    private:
+        // a size we haven't asked for in this many batches is probably not coming back.
+        static constexpr size_t STALE_BATCHES = 2;
+
+        struct FreeList {
+            vector<void *> blocks;
+            size_t lastUsedBatch = 0;
+        };
+
+        mutex lock;
+        unordered_map<size_t, FreeList> freeLists;
+        TensorArenaCounters counters;
+        size_t batch = 0;
+        size_t batchSystemAllocations = 0;
+        size_t live = 0;
+        size_t cached = 0;
+        size_t cacheLimit = (size_t) 1 << 30;
+
+        TensorArena() = default;
+
+        void takeBlocks(size_t blockSize, FreeList &freeList, vector<pair<void *, size_t>> &taken) {
+            for (void *block: freeList.blocks) {
+                taken.emplace_back(block, blockSize);
+            }
+            cached -= blockSize * freeList.blocks.size();
+            freeList.blocks.clear();
+        }
+
+        static void freeBlocks(const vector<pair<void *, size_t>> &blocks) {
+            for (const auto &block: blocks) {
+                ::operator delete(block.first, align_val_t(TENSOR_DATA_ALIGNMENT));
+            }
+        }
+    };
+
+    // A scratch buffer drawn from the arena. Use it in place of a vector for temporary values that are
+    // overwritten before they are read, since it doesn't zero anything and doesn't go to the heap once warm.
+    template<typename T>
+    class ArenaBuffer {
+    public:
+        ArenaBuffer() : values(nullptr), count(0) {
+        }
+
+        explicit ArenaBuffer(const size_t count) : ArenaBuffer() {
+            resize(count);
+        }
+
+        ArenaBuffer(ArenaBuffer &&other) noexcept: values(other.values), count(other.count) {
+            other.values = nullptr;
+            other.count = 0;
+        }
+
+        ArenaBuffer(const ArenaBuffer &) = delete;
+
+        ArenaBuffer &operator=(const ArenaBuffer &) = delete;
+
+        ~ArenaBuffer() {
+            release();
+        }
+
+        // Existing values are not kept.
+        void resize(const size_t newCount) {
+            if (newCount == count) {
+                return;
+            }
+            release();
+            if (newCount > 0) {
+                values = static_cast<T *>(TensorArena::instance().allocate(newCount * sizeof(T)));
+                count = newCount;
+            }
+        }
+
+        void release() {
+            if (values != nullptr) {
+                TensorArena::instance().release(values, count * sizeof(T));
+                values = nullptr;
+                count = 0;
+            }
+        }
+
+        inline T *data() {
+            return values;
+        }
+
+        [[nodiscard]] inline size_t size() const {
+            return count;
+        }
+
+    private:
+        T *values;
+        size_t count;
+    };
+}
+
+#endif //HAPPYML_TENSOR_ARENA_HPP
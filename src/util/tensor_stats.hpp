@@ -60,10 +60,13 @@ namespace happyml {
 //        cout << "elements_per_channel: " << source.elementsPerChannel() << endl;
             if (source.elementsPerChannel() < 100000000) {
 //            cout << "single thread" << endl;
+                RowScratch rowValues(cols);
+                const float *values = rowValues.data();
                 for (size_t channel = 0; channel < channels; channel++) {
                     for (size_t row = 0; row < rows; row++) {
+                        source.readRow(row, channel, 0, cols, rowValues.data());
                         for (size_t col = 0; col < cols; col++) {
-                            populateBags(&source, row, col, channel, bagCounts);
+                            populateBags(values[col], bagCounts);
                         }
                     }
                 }
@@ -277,12 +280,7 @@ namespace happyml {
             bagCounts[q][1] += 1.0;
         }
 
-        static void populateBags(BaseTensor *source,
-                                 const size_t row,
-                                 const size_t col,
-                                 const size_t channel,
-                                 const shared_ptr<BagCounts> &bagCounts) {
-            float f = source->getValue(row, col, channel);
+        static void populateBags(const float f, const shared_ptr<BagCounts> &bagCounts) {
             if (isinf(f) || isnan(f)) {
                 return;
             }
@@ -299,8 +297,11 @@ namespace happyml {
                                       size_t channel,
                                       const shared_ptr<BagCounts> &bagCounts) {
             auto local = make_shared<BagCounts>();
+            RowScratch rowValues(maxCols);
+            const float *values = rowValues.data();
+            source->readRow(row, channel, 0, maxCols, rowValues.data());
             for (size_t col = 0; col < maxCols; col++) {
-                populateBags(source, row, col, channel, local);
+                populateBags(values[col], local);
             }
             const lock_guard<mutex> lock(bagCounts->bagMutex);
             size_t index = 0;
@@ -357,7 +358,7 @@ namespace happyml {
                                       const shared_ptr<BagCounts> &bagCounts) {
             auto local = make_shared<BagCounts>();
             for (size_t row = 0; row < maxRows; row++) {
-                populateBags(source, row, col, channel, local);
+                populateBags(source->getValue(row, col, channel), local);
             }
             const lock_guard<mutex> lock(bagCounts->bagMutex);
             size_t index = 0;
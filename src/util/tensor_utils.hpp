@@ -11,6 +11,8 @@
 #include "../types/tensor.hpp"
 #include "../types/tensor_views.hpp"
 #include "../types/materialized_tensors.hpp"
+#include "../types/mapped_tensors.hpp"
+#include "../types/tensor_simplify.hpp"
 #include <iomanip>
 #include <vector>
 #include <utility>
@@ -43,7 +45,23 @@ namespace happyml {
     }
 
     shared_ptr<BaseTensor> round(const shared_ptr<BaseTensor> &tensor) {
-        return make_shared<TensorRoundedView>(tensor);
+        return makeView<TensorRoundedView>(tensor);
+    }
+
+    // rows [firstRow, firstRow + rows), all columns and channels
+    shared_ptr<BaseTensor> sliceRows(const shared_ptr<BaseTensor> &tensor, size_t firstRow, size_t rows) {
+        return makeView<TensorSliceView>(tensor, firstRow, rows, 0, tensor->columnCount(), 0,
+                                         tensor->channelCount());
+    }
+
+    shared_ptr<BaseTensor> sliceColumns(const shared_ptr<BaseTensor> &tensor, size_t firstColumn, size_t columns) {
+        return makeView<TensorSliceView>(tensor, 0, tensor->rowCount(), firstColumn, columns, 0,
+                                         tensor->channelCount());
+    }
+
+    shared_ptr<BaseTensor> sliceChannels(const shared_ptr<BaseTensor> &tensor, size_t firstChannel, size_t channels) {
+        return makeView<TensorSliceView>(tensor, 0, tensor->rowCount(), 0, tensor->columnCount(), firstChannel,
+                                         channels);
     }
 
     size_t maxIndex(const shared_ptr<BaseTensor> &tensor) {
@@ -63,9 +81,16 @@ namespace happyml {
         return quarter_bias;
     }
 
-    shared_ptr<BaseTensor> materializeTensor(const shared_ptr<BaseTensor> &tensor, uint8_t bits) {
+    // A tensor of one repeated value is cheaper to read than any copy of it, so once simplifying a graph has boiled
+    // it down to one, we keep it as it is.
+    inline bool isWorthMaterializing(const shared_ptr<BaseTensor> &tensor) {
+        return !tensor->isMaterialized() && dynamic_cast<UniformTensor *>(tensor.get()) == nullptr;
+    }
+
+    shared_ptr<BaseTensor> materializeTensor(const shared_ptr<BaseTensor> &original, uint8_t bits) {
+        const auto tensor = simplifyTensor(original);
         if (bits == 32) {
-            if (tensor->isMaterialized()) {
+            if (!isWorthMaterializing(tensor)) {
                 // there is no advantage to materializing an already materialized tensor to 32 bits.
                 // whether other bit options may reduce memory footprint.
                 return tensor;
@@ -84,7 +109,26 @@ namespace happyml {
         if (other->isMaterialized()) {
             return other;
         }
-        return make_shared<FullTensor>(other);
+        const auto simplified = simplifyTensor(other);
+        if (!isWorthMaterializing(simplified)) {
+            return simplified;
+        }
+        return make_shared<FullTensor>(simplified);
+    }
+
+    // Like materializeTensor(), except that when target already stores its values the way bits asks for, the
+    // result is written over target's values and target is returned, so nothing is allocated. An 8-bit tensor picks
+    // its bias from the range of its values, and that range moves as they change, so those are always rebuilt.
+    shared_ptr<BaseTensor> updateTensor(const shared_ptr<BaseTensor> &target, const shared_ptr<BaseTensor> &expression,
+                                        uint8_t bits) {
+        const bool same_precision = (bits == 32 && (dynamic_cast<FullTensor *>(target.get()) != nullptr ||
+                                                    dynamic_cast<PackedGemmTensor *>(target.get()) != nullptr)) ||
+                                    (bits == 16 && dynamic_cast<HalfTensor *>(target.get()) != nullptr);
+        if (!same_precision) {
+            return materializeTensor(expression, bits);
+        }
+        dynamic_pointer_cast<BaseAssignableTensor>(target)->assign(simplifyTensor(expression));
+        return target;
     }
 
     shared_ptr<FullTensor> tensor(const vector<vector<vector<float>>> &t) {
@@ -92,6 +136,17 @@ namespace happyml {
     }
 
     shared_ptr<BaseTensor> loadTensor(const string &path, uint8_t bits) {
+        if (isMappedTensorFile(path)) {
+            // Mapping the file is nearly free, no matter how big it is. If the file holds a different
+            // precision than the caller asked for, we still have to convert it.
+            auto mapped = loadMappedTensor(path, false, MappedAccess::sequential);
+            const auto encoding = dynamic_pointer_cast<MappedFullTensor>(mapped) ? 32
+                                  : dynamic_pointer_cast<MappedHalfTensor>(mapped) ? 16 : 8;
+            if (encoding == bits) {
+                return mapped;
+            }
+            return bits == 32 ? make_shared<FullTensor>(mapped) : materializeTensor(mapped, bits);
+        }
         if (bits == 16) {
             return make_shared<HalfTensor>(path);
         } else if (bits == 8) {